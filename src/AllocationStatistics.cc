@@ -0,0 +1,116 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file AllocationStatistics.cc Replacement global operator new/delete and class AllocationMeter.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <cstdlib>
+#include <new>
+#include "debug.h"
+#endif
+
+#include "AllocationStatistics.h"
+
+#ifdef ALLOCATION_STATISTICS
+
+namespace {
+
+// Process wide totals. Updated with atomic builtins because operator new can be called from any thread.
+AllocationCounters totals;
+unsigned long long live_bytes;
+
+// Every block is prefixed with its size, padded to keep the user part maximally aligned.
+size_t const header_size = 16;
+
+inline void* counted_malloc(size_t size)
+{
+  char* block = static_cast<char*>(std::malloc(size + header_size));
+  if (!block)
+    return NULL;
+  *reinterpret_cast<size_t*>(block) = size;
+  __sync_add_and_fetch(&totals.M_allocations, 1);
+  __sync_add_and_fetch(&totals.M_allocated_bytes, size);
+  unsigned long long live = __sync_add_and_fetch(&live_bytes, size);
+  unsigned long long peak = totals.M_peak_live_bytes;
+  while (live > peak && !__sync_bool_compare_and_swap(&totals.M_peak_live_bytes, peak, live))
+    peak = totals.M_peak_live_bytes;
+  return block + header_size;
+}
+
+inline void counted_free(void* ptr)
+{
+  if (!ptr)
+    return;
+  char* block = static_cast<char*>(ptr) - header_size;
+  size_t size = *reinterpret_cast<size_t*>(block);
+  __sync_add_and_fetch(&totals.M_deallocations, 1);
+  __sync_add_and_fetch(&totals.M_freed_bytes, size);
+  __sync_sub_and_fetch(&live_bytes, size);
+  std::free(block);
+}
+
+void* counted_new(size_t size) throw(std::bad_alloc)
+{
+  for (;;)
+  {
+    void* ptr = counted_malloc(size);
+    if (ptr)
+      return ptr;
+    std::new_handler handler = std::set_new_handler(0);
+    std::set_new_handler(handler);
+    if (!handler)
+      throw std::bad_alloc();
+    handler();
+  }
+}
+
+} // namespace
+
+void* operator new(size_t size) throw(std::bad_alloc) { return counted_new(size); }
+void* operator new[](size_t size) throw(std::bad_alloc) { return counted_new(size); }
+void* operator new(size_t size, std::nothrow_t const&) throw() { return counted_malloc(size); }
+void* operator new[](size_t size, std::nothrow_t const&) throw() { return counted_malloc(size); }
+void operator delete(void* ptr) throw() { counted_free(ptr); }
+void operator delete[](void* ptr) throw() { counted_free(ptr); }
+void operator delete(void* ptr, std::nothrow_t const&) throw() { counted_free(ptr); }
+void operator delete[](void* ptr, std::nothrow_t const&) throw() { counted_free(ptr); }
+
+void AllocationMeter::start(void)
+{
+  M_start = totals;
+  // Measure the peak of this scope from the current number of live bytes.
+  unsigned long long live = live_bytes;
+  M_outer_peak = __sync_lock_test_and_set(&totals.M_peak_live_bytes, live);
+}
+
+void AllocationMeter::stop(AllocationCounters& counters)
+{
+  AllocationCounters now = totals;
+  counters.M_allocations += now.M_allocations - M_start.M_allocations;
+  counters.M_deallocations += now.M_deallocations - M_start.M_deallocations;
+  counters.M_allocated_bytes += now.M_allocated_bytes - M_start.M_allocated_bytes;
+  counters.M_freed_bytes += now.M_freed_bytes - M_start.M_freed_bytes;
+  if (now.M_peak_live_bytes > counters.M_peak_live_bytes)
+    counters.M_peak_live_bytes = now.M_peak_live_bytes;
+  // Restore the enclosing peak, if that was higher.
+  unsigned long long peak = totals.M_peak_live_bytes;
+  while (M_outer_peak > peak && !__sync_bool_compare_and_swap(&totals.M_peak_live_bytes, peak, M_outer_peak))
+    peak = totals.M_peak_live_bytes;
+}
+
+#endif // ALLOCATION_STATISTICS
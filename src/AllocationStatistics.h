@@ -0,0 +1,80 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file AllocationStatistics.h Declaration of class AllocationMeter.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ALLOCATIONSTATISTICS_H
+#define ALLOCATIONSTATISTICS_H
+
+// Allocation accounting, only compiled in when ALLOCATION_STATISTICS is defined
+// (configure --enable-allocation-statistics or cmake -DENABLE_ALLOCATION_STATISTICS=ON).
+// The global operator new and delete are then replaced by versions that keep count.
+
+struct AllocationCounters
+{
+  unsigned long long M_allocations;
+  unsigned long long M_deallocations;
+  unsigned long long M_allocated_bytes;
+  unsigned long long M_freed_bytes;
+  unsigned long long M_peak_live_bytes;		// Highest number of bytes in use by the whole process at the same time.
+
+  AllocationCounters(void) : M_allocations(0), M_deallocations(0), M_allocated_bytes(0), M_freed_bytes(0), M_peak_live_bytes(0) { }
+};
+
+#ifdef ALLOCATION_STATISTICS
+
+// Measures the allocations done between start() and stop().
+class AllocationMeter
+{
+  private:
+    AllocationCounters M_start;			// Process totals at start().
+    unsigned long long M_outer_peak;		// Peak live bytes before start().
+
+  public:
+    static bool const enabled = true;
+
+    void start(void);
+    // Add the allocations since start() to counters.
+    void stop(AllocationCounters& counters);
+};
+
+#else // ALLOCATION_STATISTICS
+
+class AllocationMeter
+{
+  public:
+    static bool const enabled = false;
+
+    void start(void) { }
+    void stop(AllocationCounters&) { }
+};
+
+#endif // ALLOCATION_STATISTICS
+
+// Adds the allocations done during the lifetime of this object to counters, unless that is NULL.
+class AllocationScope
+{
+  private:
+    AllocationMeter M_meter;
+    AllocationCounters* M_counters;
+
+  public:
+    AllocationScope(AllocationCounters* counters) : M_counters(counters) { if (AllocationMeter::enabled && M_counters) M_meter.start(); }
+    ~AllocationScope() { if (AllocationMeter::enabled && M_counters) M_meter.stop(*M_counters); }
+};
+
+#endif // ALLOCATIONSTATISTICS_H
@@ -0,0 +1,44 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Arena.h Implementation of class Arena.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <cstddef>
+#include <boost/container/pmr/monotonic_buffer_resource.hpp>
+#include <boost/container/pmr/polymorphic_allocator.hpp>
+#include <boost/container/pmr/string.hpp>
+
+// The allocator used by all strings and containers of the document model.
+typedef boost::container::pmr::polymorphic_allocator<char> ArenaAllocator;
+typedef boost::container::pmr::string ArenaString;
+
+// Monotonic memory resource for the objects of one document (ContributionsTxt).
+//
+// Allocating is a pointer bump and deallocating does nothing; all memory is given
+// back at once by release() or the destructor. After release() the arena can be
+// used for the next document, which makes it suitable to keep around in a
+// long-running process.
+class Arena : public boost::container::pmr::monotonic_buffer_resource
+{
+  public:
+    Arena(std::size_t initial_size = 16384) : boost::container::pmr::monotonic_buffer_resource(initial_size) { }
+};
+
+#endif // ARENA_H
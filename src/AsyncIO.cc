@@ -0,0 +1,519 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file AsyncIO.cc Implementation of class AsyncReader and write_file.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <unistd.h>
+#include "debug.h"
+#endif
+
+#include "AsyncIO.h"
+#include "Trace.h"
+#include <boost/bind.hpp>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+
+#ifdef __linux__
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/io_uring.h>
+#endif
+
+// A minimal io_uring, using the system calls directly.
+class IoRing
+{
+#ifdef __linux__
+  private:
+    int M_fd;
+    void* M_sq_ring;
+    size_t M_sq_ring_size;
+    void* M_cq_ring;					// Equal to M_sq_ring with IORING_FEAT_SINGLE_MMAP.
+    size_t M_cq_ring_size;
+    struct io_uring_sqe* M_sqes;
+    size_t M_sqes_size;
+    unsigned* M_sq_head;
+    unsigned* M_sq_tail;
+    unsigned* M_sq_array;
+    unsigned M_sq_mask;
+    unsigned M_sq_entries;
+    unsigned M_sqe_tail;				// Tail of the entries handed out by get_sqe, but not yet submitted.
+    unsigned* M_cq_head;
+    unsigned* M_cq_tail;
+    unsigned M_cq_mask;
+    struct io_uring_cqe* M_cqes;
+
+  public:
+    IoRing(unsigned entries);
+    ~IoRing();
+
+    bool valid(void) const { return M_fd != -1; }
+
+    // Return a cleared submission queue entry, or NULL if the queue is full.
+    struct io_uring_sqe* get_sqe(void);
+
+    // Submit all new entries and wait until at least wait_nr have completed. Returns false on failure.
+    bool submit(unsigned wait_nr);
+
+    // Pop a completion, if any.
+    bool pop(uint64_t& user_data, int& res);
+
+  private:
+    void release(void);
+#else
+  public:
+    IoRing(unsigned) { }
+    bool valid(void) const { return false; }
+#endif
+
+  private:
+    IoRing(IoRing const&);
+    IoRing& operator=(IoRing const&);
+};
+
+#ifdef __linux__
+IoRing::IoRing(unsigned entries) : M_sq_ring(MAP_FAILED), M_cq_ring(MAP_FAILED), M_sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED))
+{
+  struct io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  M_fd = syscall(__NR_io_uring_setup, entries, &params);
+  if (M_fd == -1)
+    return;
+  M_sq_ring_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  M_cq_ring_size = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+  bool const single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP);
+  if (single_mmap)
+    M_sq_ring_size = M_cq_ring_size = std::max(M_sq_ring_size, M_cq_ring_size);
+  M_sq_ring = mmap(NULL, M_sq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, M_fd, IORING_OFF_SQ_RING);
+  M_cq_ring = single_mmap ? M_sq_ring : mmap(NULL, M_cq_ring_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, M_fd, IORING_OFF_CQ_RING);
+  M_sqes_size = params.sq_entries * sizeof(struct io_uring_sqe);
+  M_sqes = static_cast<struct io_uring_sqe*>(mmap(NULL, M_sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, M_fd, IORING_OFF_SQES));
+  if (M_sq_ring == MAP_FAILED || M_cq_ring == MAP_FAILED || M_sqes == MAP_FAILED)
+  {
+    release();
+    return;
+  }
+  char* sq = static_cast<char*>(M_sq_ring);
+  M_sq_head = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  M_sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  M_sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  M_sq_mask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  M_sq_entries = params.sq_entries;
+  M_sqe_tail = *M_sq_tail;
+  char* cq = static_cast<char*>(M_cq_ring);
+  M_cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  M_cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  M_cq_mask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  M_cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+}
+
+IoRing::~IoRing()
+{
+  release();
+}
+
+void IoRing::release(void)
+{
+  if (M_sqes != MAP_FAILED)
+    munmap(M_sqes, M_sqes_size);
+  if (M_cq_ring != MAP_FAILED && M_cq_ring != M_sq_ring)
+    munmap(M_cq_ring, M_cq_ring_size);
+  if (M_sq_ring != MAP_FAILED)
+    munmap(M_sq_ring, M_sq_ring_size);
+  if (M_fd != -1)
+    close(M_fd);
+  M_sqes = static_cast<struct io_uring_sqe*>(MAP_FAILED);
+  M_cq_ring = M_sq_ring = MAP_FAILED;
+  M_fd = -1;
+}
+
+struct io_uring_sqe* IoRing::get_sqe(void)
+{
+  if (M_sqe_tail - __atomic_load_n(M_sq_head, __ATOMIC_ACQUIRE) >= M_sq_entries)
+    return NULL;
+  unsigned const index = M_sqe_tail++ & M_sq_mask;
+  M_sq_array[index] = index;
+  struct io_uring_sqe* sqe = &M_sqes[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  return sqe;
+}
+
+bool IoRing::submit(unsigned wait_nr)
+{
+  unsigned const to_submit = M_sqe_tail - *M_sq_tail;
+  __atomic_store_n(M_sq_tail, M_sqe_tail, __ATOMIC_RELEASE);
+  if (to_submit == 0 && wait_nr == 0)
+    return true;
+  for (;;)
+  {
+    if (syscall(__NR_io_uring_enter, M_fd, to_submit, wait_nr, wait_nr ? IORING_ENTER_GETEVENTS : 0, NULL, 0) != -1)
+      return true;
+    if (errno != EINTR)
+      return false;
+  }
+}
+
+bool IoRing::pop(uint64_t& user_data, int& res)
+{
+  unsigned const head = *M_cq_head;
+  if (head == __atomic_load_n(M_cq_tail, __ATOMIC_ACQUIRE))
+    return false;
+  struct io_uring_cqe const& cqe(M_cqes[head & M_cq_mask]);
+  user_data = cqe.user_data;
+  res = cqe.res;
+  __atomic_store_n(M_cq_head, head + 1, __ATOMIC_RELEASE);
+  return true;
+}
+#endif // __linux__
+
+namespace {
+
+// The largest single read or write, well below the limit of a 32-bit length.
+size_t const max_transfer = 1 << 30;
+
+} // namespace
+
+AsyncReader::AsyncReader(std::string const* filenames, size_t number_of_files) : M_inputs(number_of_files), M_ring(NULL), M_in_flight(0)
+{
+  for (size_t index = 0; index < number_of_files; ++index)
+  {
+    TraceSpan span("open", filenames[index].c_str());
+    Input& input(M_inputs[index]);
+    input.M_filename = filenames[index];
+    input.M_offset = 0;
+    input.M_error = 0;
+    input.M_fd = open(filenames[index].c_str(), O_RDONLY | O_CLOEXEC);
+    struct stat buf;
+    if (input.M_fd == -1 || fstat(input.M_fd, &buf) == -1)
+      input.M_error = errno;
+    else if (S_ISDIR(buf.st_mode))
+      input.M_error = EISDIR;
+    else
+      input.M_buffer.resize(buf.st_size);
+    input.M_start_us = Trace::enabled() ? Trace::now_us() : -1.0;
+  }
+#ifdef __linux__
+  M_ring = new IoRing(number_of_files);
+  if (!M_ring->valid())
+  {
+    delete M_ring;
+    M_ring = NULL;
+  }
+#endif
+  for (size_t index = 0; index < number_of_files; ++index)
+  {
+    if (M_inputs[index].M_error || M_inputs[index].M_buffer.empty())
+      complete(index);
+    else if (M_ring)
+      submit_read(index);
+    else
+      M_threads.create_thread(boost::bind(&AsyncReader::thread_read, this, index));
+  }
+#ifdef __linux__
+  if (M_ring && !M_ring->submit(0))
+    read_with_threads();
+#endif
+}
+
+AsyncReader::~AsyncReader()
+{
+#ifdef __linux__
+  // The kernel may still write into the buffers until every read completed.
+  uint64_t user_data;
+  int res;
+  while (M_in_flight > 0 && M_ring->submit(1))
+    while (M_ring->pop(user_data, res))
+      --M_in_flight;
+#endif
+  M_threads.join_all();
+  for (std::vector<Input>::iterator input = M_inputs.begin(); input != M_inputs.end(); ++input)
+    if (input->M_fd != -1)
+      close(input->M_fd);
+  delete M_ring;
+}
+
+void AsyncReader::submit_read(size_t index)
+{
+#ifdef __linux__
+  Input& input(M_inputs[index]);
+  struct io_uring_sqe* sqe = M_ring->get_sqe();		// There is room: at most one read per file is in flight.
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = input.M_fd;
+  sqe->addr = reinterpret_cast<uintptr_t>(&input.M_buffer[input.M_offset]);
+  sqe->len = std::min(input.M_buffer.size() - input.M_offset, max_transfer);
+  sqe->off = input.M_offset;
+  sqe->user_data = index;
+  ++M_in_flight;
+#endif
+}
+
+// Stop using the ring and read every file that is still being read again, with a thread each.
+// The kernel might still write into the buffers of reads that are in flight, so those are kept
+// until the AsyncReader is destroyed.
+void AsyncReader::read_with_threads(void)
+{
+  delete M_ring;
+  M_ring = NULL;
+  M_in_flight = 0;
+  for (size_t index = 0; index < M_inputs.size(); ++index)
+  {
+    Input& input(M_inputs[index]);
+    if (input.M_fd == -1)
+      continue;
+    M_abandoned.push_back(std::string());
+    M_abandoned.back().swap(input.M_buffer);
+    input.M_buffer.resize(M_abandoned.back().size());
+    input.M_offset = 0;
+    M_threads.create_thread(boost::bind(&AsyncReader::thread_read, this, index));
+  }
+}
+
+void AsyncReader::complete(size_t index)
+{
+  Input& input(M_inputs[index]);
+  if (input.M_fd != -1)
+  {
+    close(input.M_fd);
+    input.M_fd = -1;
+  }
+  // The reads overlap, so each one is a span of its own, from submission until the last byte arrived.
+  Trace::add("read", input.M_filename, input.M_start_us);
+  boost::mutex::scoped_lock lock(M_mutex);
+  M_done.push_back(index);
+  M_read.notify_one();
+}
+
+void AsyncReader::thread_read(size_t index)
+{
+  Input& input(M_inputs[index]);
+  while (input.M_offset < input.M_buffer.size())
+  {
+    ssize_t len = pread(input.M_fd, &input.M_buffer[input.M_offset], input.M_buffer.size() - input.M_offset, input.M_offset);
+    if (len == -1 && errno == EINTR)
+      continue;
+    if (len == -1)
+      input.M_error = errno;
+    else if (len == 0)
+      input.M_buffer.resize(input.M_offset);		// The file shrunk.
+    else
+    {
+      input.M_offset += len;
+      continue;
+    }
+    break;
+  }
+  complete(index);
+}
+
+size_t AsyncReader::next(void) throw(ReadError)
+{
+  TraceSpan span("wait for read");
+#ifdef __linux__
+  if (M_ring)
+  {
+    while (M_done.empty())
+    {
+      if (!M_ring->submit(1))
+      {
+	read_with_threads();
+	break;
+      }
+      uint64_t user_data;
+      int res;
+      while (M_ring->pop(user_data, res))
+      {
+	--M_in_flight;
+	Input& input(M_inputs[user_data]);
+	if (res == -EINTR || res == -EAGAIN)
+	  submit_read(user_data);
+	else if (res < 0)
+	{
+	  input.M_error = -res;
+	  complete(user_data);
+	}
+	else if (res == 0)
+	{
+	  input.M_buffer.resize(input.M_offset);	// The file shrunk.
+	  complete(user_data);
+	}
+	else if ((input.M_offset += res) < input.M_buffer.size())
+	  submit_read(user_data);
+	else
+	  complete(user_data);
+      }
+    }
+  }
+#endif
+  boost::mutex::scoped_lock lock(M_mutex);
+  while (M_done.empty())
+    M_read.wait(lock);
+  size_t index = M_done.front();
+  M_done.pop_front();
+  lock.unlock();
+  Input const& input(M_inputs[index]);
+  if (input.M_error)
+    throw ReadError("Cannot read \"" + input.M_filename + "\": " + std::strerror(input.M_error));
+  return index;
+}
+
+// Return true if filename is a regular file with exactly the contents data.
+// Reads it in blocks and stops at the first difference.
+static bool file_equals(std::string const& filename, std::string const& data)
+{
+  int fd = open(filename.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd == -1)
+    return false;
+  struct stat buf;
+  bool equal = fstat(fd, &buf) == 0 && S_ISREG(buf.st_mode) && static_cast<unsigned long long>(buf.st_size) == data.size();
+  if (equal)
+  {
+    char block[65536];
+    size_t compared = 0;
+    while (compared < data.size())
+    {
+      ssize_t len = read(fd, block, std::min(data.size() - compared, sizeof(block)));
+      if (len == -1 && errno == EINTR)
+	continue;
+      if (len <= 0 || std::memcmp(block, data.data() + compared, len) != 0)
+      {
+	equal = false;
+	break;
+      }
+      compared += len;
+    }
+  }
+  close(fd);
+  return equal;
+}
+
+// Return the file that filename refers to after following symbolic links, which need not exist.
+static std::string resolve_links(std::string filename)
+{
+  char target[PATH_MAX];
+  for (int links = 0; links < 40; ++links)		// Give up on loops, like the kernel does (ELOOP).
+  {
+    ssize_t len = readlink(filename.c_str(), target, sizeof(target));
+    if (len <= 0 || len == sizeof(target))
+      break;
+    std::string::size_type slash = filename.rfind('/');
+    if (target[0] == '/' || slash == std::string::npos)
+      filename.assign(target, len);
+    else
+      filename.replace(slash + 1, std::string::npos, target, len);	// Relative to the directory of the link.
+  }
+  return filename;
+}
+
+bool write_file(std::string const& name, std::string const& data, bool sync)
+{
+  TraceSpan span("write file", name.c_str());
+  std::string const filename(resolve_links(name));
+  if (file_equals(filename, data))
+    return true;
+  char pid[16];
+  std::sprintf(pid, ".%d", (int)getpid());
+  std::string const tmpname(filename + pid);
+  int fd = open(tmpname.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+  if (fd == -1)
+    return false;
+  struct stat buf;
+  if (stat(filename.c_str(), &buf) == 0)
+    fchmod(fd, buf.st_mode & 07777);
+
+  size_t written = 0;
+  bool synced = !sync;
+  bool renamed = false;
+#ifdef __linux__
+  IoRing ring(4);
+  if (ring.valid() && data.size() <= max_transfer)
+  {
+    // write -> fsync -> rename; a failing (or short) write cancels the rest of the chain.
+    struct io_uring_sqe* sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_WRITE;
+    sqe->fd = fd;
+    sqe->addr = reinterpret_cast<uintptr_t>(data.data());
+    sqe->len = data.size();
+    sqe->flags = IOSQE_IO_LINK;
+    sqe->user_data = 0;
+    if (sync)
+    {
+      sqe = ring.get_sqe();
+      sqe->opcode = IORING_OP_FSYNC;
+      sqe->fd = fd;
+      sqe->flags = IOSQE_IO_LINK;
+      sqe->user_data = 1;
+    }
+    sqe = ring.get_sqe();
+    sqe->opcode = IORING_OP_RENAMEAT;			// Since Linux 5.11; older kernels fail it with -EINVAL.
+    sqe->fd = AT_FDCWD;
+    sqe->addr = reinterpret_cast<uintptr_t>(tmpname.c_str());
+    sqe->len = AT_FDCWD;
+    sqe->addr2 = reinterpret_cast<uintptr_t>(filename.c_str());
+    sqe->user_data = 2;
+    unsigned const chain = sync ? 3 : 2;
+    if (ring.submit(chain))
+    {
+      uint64_t user_data;
+      int res;
+      for (unsigned completed = 0; completed < chain;)
+      {
+	if (!ring.pop(user_data, res))
+	{
+	  if (!ring.submit(1))
+	    break;
+	  continue;
+	}
+	++completed;
+	if (user_data == 0 && res > 0)
+	  written = res;
+	else if (user_data == 1)
+	  synced = res == 0;
+	else if (user_data == 2)
+	  renamed = res == 0;
+      }
+    }
+  }
+#endif
+  // Do whatever the ring didn't.
+  while (written < data.size())
+  {
+    ssize_t len = write(fd, data.data() + written, std::min(data.size() - written, max_transfer));
+    if (len == -1 && errno == EINTR)
+      continue;
+    if (len == -1)
+      break;
+    written += len;
+  }
+  bool success = written == data.size() && (synced || fsync(fd) == 0);
+  if (close(fd) != 0)
+    success = false;
+  if (!renamed && (!success || std::rename(tmpname.c_str(), filename.c_str()) != 0))
+  {
+    unlink(tmpname.c_str());
+    return false;
+  }
+  return success;
+}
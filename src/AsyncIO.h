@@ -0,0 +1,89 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file AsyncIO.h Declaration of class AsyncReader and write_file.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef ASYNCIO_H
+#define ASYNCIO_H
+
+#include <deque>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/thread.hpp>
+#include "exceptions.h"
+
+class IoRing;
+
+// Reads a number of whole files at the same time, so that the caller can start working on
+// each file as soon as it is read. Uses Linux io_uring if the kernel allows it, and one
+// thread per file using pread(2) otherwise (also when io_uring fails halfway).
+//
+// Like ContributionsTxt::read_file, a file that can't be read is reported with a ReadError.
+class AsyncReader
+{
+  private:
+    struct Input {
+      std::string M_filename;
+      std::string M_buffer;
+      int M_fd;
+      size_t M_offset;					// Number of bytes read so far.
+      int M_error;					// The errno of a failed read, or 0.
+      double M_start_us;				// When reading began, for the "read" span of --trace.
+    };
+
+    std::vector<Input> M_inputs;
+    IoRing* M_ring;					// NULL if threads are used.
+    size_t M_in_flight;					// Number of submitted io_uring reads that didn't complete yet.
+    std::deque<std::string> M_abandoned;		// Buffers of reads that were in flight when the ring failed.
+    boost::thread_group M_threads;
+    boost::mutex M_mutex;				// Protects M_done.
+    boost::condition_variable M_read;			// Notified when a file was read completely.
+    std::deque<size_t> M_done;				// Files that were read but not yet returned by next().
+
+  public:
+    AsyncReader(std::string const* filenames, size_t number_of_files);
+    ~AsyncReader();
+
+    // Block until another file was read completely and return its index. Each index is returned once.
+    // Throws ReadError if that file could not be read.
+    size_t next(void) throw(ReadError);
+
+    // The contents of the file with that index, after next() returned it.
+    std::string& buffer(size_t index) { return M_inputs[index].M_buffer; }
+
+  private:
+    void submit_read(size_t index);
+    void complete(size_t index);
+    void thread_read(size_t index);
+    void read_with_threads(void);
+
+  private:
+    AsyncReader(AsyncReader const&);
+    AsyncReader& operator=(AsyncReader const&);
+};
+
+// Replace filename by data: write it to a temporary file next to it, fsync that and rename it over filename,
+// as one linked io_uring chain if the kernel allows it. Keeps the permissions of an existing filename.
+// If filename is a symbolic link, the file that it points to is replaced instead.
+// If filename already has exactly the contents data, it is not touched at all (not even its mtime).
+// Without sync, the rename may reach the disk before the data does: for cache files, which are checked when read.
+// Returns false on failure, in which case filename is left untouched.
+bool write_file(std::string const& filename, std::string const& data, bool sync = true);
+
+#endif // ASYNCIO_H
@@ -0,0 +1,180 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Audit.cc Implementation of class Audit.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <iostream>
+#include <sstream>
+#include "debug.h"
+#endif
+
+#include "Audit.h"
+#include "merge.h"
+#include "MergeConflict.h"
+#include "Trace.h"
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace {
+
+char const* const role[4] = { "left", "base", "right", "actual" };
+
+} // namespace
+
+void Audit::read_list(std::istream& is)
+{
+  std::string line;
+  int line_number = 0;
+  while (std::getline(is, line))
+  {
+    ++line_number;
+    std::istringstream words(line);
+    Job job;
+    job.M_line = line_number;
+    job.M_result = unchecked;
+    if (!(words >> job.M_spec[0]) || job.M_spec[0][0] == '#')
+      continue;
+    std::string rest;
+    if (!(words >> job.M_spec[1] >> job.M_spec[2] >> job.M_spec[3]) || (words >> rest))
+    {
+      job.M_result = error;
+      job.M_error = "Expected \"<left> <base> <right> <actual>\"";
+    }
+    else
+    {
+      try
+      {
+	for (int i = 0; i < 4; ++i)
+	  job.M_id[i] = M_repository.blob_id(job.M_spec[i]);
+      }
+      catch (GitError& git_error)
+      {
+	job.M_result = error;
+	job.M_error = git_error.what();
+      }
+    }
+    M_jobs.push_back(job);
+  }
+}
+
+void Audit::run(unsigned int threads)
+{
+  M_next_job = 0;
+  if (threads <= 1)
+  {
+    worker();
+    return;
+  }
+  boost::thread_group workers;
+  for (unsigned int i = 0; i < threads; ++i)
+    workers.create_thread(boost::bind(&Audit::worker, this));
+  workers.join_all();
+}
+
+// Each worker allocates the merge results from one arena, which is released after every merge.
+void Audit::worker(void)
+{
+  Arena arena;
+  for (;;)
+  {
+    size_t next;
+    {
+      boost::mutex::scoped_lock lock(M_next_job_mutex);
+      if (M_next_job == M_jobs.size())
+	return;
+      next = M_next_job++;
+    }
+    if (M_jobs[next].M_result == unchecked)
+      check(M_jobs[next], arena);
+    arena.release();
+  }
+}
+
+void Audit::check(Job& job, Arena& arena)
+{
+  std::ostringstream line;
+  line << "line " << job.M_line;
+  TraceSpan span("audit merge", line.str().c_str());
+  try
+  {
+    DocumentCache::document_ptr left(M_cache.get(job.M_id[0]));
+    DocumentCache::document_ptr base(M_cache.get(job.M_id[1]));
+    DocumentCache::document_ptr right(M_cache.get(job.M_id[2]));
+
+    MergeConflicts conflicts;
+    CollectConflicts collect_conflicts(conflicts);
+    NoMergeStatistics no_statistics;
+    ContributionsTxt result(merge(*base, *left, *right, no_statistics, no_statistics, NULL, collect_conflicts, &arena));
+    if (!conflicts.empty())
+    {
+      job.M_result = conflict;
+      return;
+    }
+
+    // Compare with exactly what contribmerge would have written.
+    std::ostringstream merged;
+    result.print_on(merged);
+    std::string actual;
+    if (M_repository.read_object(job.M_id[3], actual) != GitRepository::blob)
+      throw GitError("Not a blob: " + job.M_spec[3]);
+    job.M_result = merged.str() == actual ? ok : mismatch;
+  }
+  catch (ParseError& parse_error)
+  {
+    job.M_result = error;
+    job.M_error = "Parsing failed, stopped at: \"" + parse_error.rest() + "\"";
+  }
+  catch (GitError& git_error)
+  {
+    job.M_result = error;
+    job.M_error = git_error.what();
+  }
+}
+
+unsigned long Audit::print_on(std::ostream& os) const
+{
+  unsigned long count[error + 1] = { 0, 0, 0, 0, 0 };
+  for (std::vector<Job>::const_iterator job = M_jobs.begin(); job != M_jobs.end(); ++job)
+  {
+    ++count[job->M_result];
+    if (job->M_result == ok)
+      continue;
+    os << "line " << job->M_line << ": ";
+    switch (job->M_result)
+    {
+      case mismatch:
+	os << "mismatch";
+	break;
+      case conflict:
+	os << "conflict";
+	break;
+      default:
+	os << "error: " << job->M_error;
+	break;
+    }
+    os << '\n';
+    if (job->M_result != error)
+      for (int i = 0; i < 4; ++i)
+	os << "  " << role[i] << ": " << job->M_spec[i] << '\n';
+  }
+  os << M_jobs.size() << " merges: " << count[ok] << " ok, " << count[mismatch] << " mismatches, "
+     << count[conflict] << " conflicts, " << count[error] << " errors.\n";
+  os << M_cache.misses() << " blobs parsed, " << M_cache.hits() << " cache hits, " << M_cache.evictions() << " evictions.\n";
+  return M_jobs.size() - count[ok];
+}
@@ -0,0 +1,80 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Audit.h Declaration of class Audit.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef AUDIT_H
+#define AUDIT_H
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <boost/thread/mutex.hpp>
+#include "Arena.h"
+#include "DocumentCache.h"
+#include "GitRepository.h"
+
+// Re-verify recorded merges: for every (left, base, right, actual) set of blobs,
+// check that merging left and right with base gives exactly actual.
+//
+// Every unique blob is parsed once into a DocumentCache and the merges run in parallel.
+class Audit
+{
+  public:
+    enum result_type {
+      unchecked,
+      ok,
+      mismatch,					// The merge result differs from actual.
+      conflict,					// Left and right don't merge.
+      error					// A blob could not be read or parsed.
+    };
+
+    struct Job {
+      int M_line;				// Line number in the list.
+      std::string M_spec[4];			// Left, base, right and actual as given.
+      GitRepository::ObjectId M_id[4];		// The corresponding blob names.
+      result_type M_result;
+      std::string M_error;
+    };
+
+  private:
+    GitRepository const& M_repository;
+    DocumentCache M_cache;
+    std::vector<Job> M_jobs;
+    boost::mutex M_next_job_mutex;
+    size_t M_next_job;				// Index of the next job to run; protected by M_next_job_mutex.
+
+  public:
+    Audit(GitRepository const& repository, size_t cache_size) :
+        M_repository(repository), M_cache(repository, cache_size), M_next_job(0) { }
+
+    // Read the list of merges to verify: one merge per line as "<left> <base> <right> <actual>",
+    // each a blob name or <rev>:<path>. Empty lines and lines starting with '#' are ignored.
+    void read_list(std::istream& is);
+
+    // Verify all merges using the given number of threads.
+    void run(unsigned int threads);
+
+    // Print mismatches, conflicts, errors and a summary. Returns the number of failed merges.
+    unsigned long print_on(std::ostream& os) const;
+
+  private:
+    void worker(void);
+    void check(Job& job, Arena& arena);
+};
+
+#endif // AUDIT_H
@@ -0,0 +1,240 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Canonicalizer.cc Implementation of class Canonicalizer.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <algorithm>
+#include <iterator>
+#include <set>
+#include <sstream>
+#include "debug.h"
+#endif
+
+#include "Canonicalizer.h"
+#include "ContributionsTxt.h"
+#include "FormattedContributions.h"
+#include "ostream_operators.h"
+#include "Trace.h"
+#include <boost/bind.hpp>
+#include <boost/thread/thread.hpp>
+
+namespace {
+
+// The smallest number of contributors worth a chunk of their own.
+size_t const min_chunk_size = 1024;
+
+// Print the name line of contributor followed by its entries, in the order of their JiraProjectKey
+// and only the first of equal keys (FormattedContributions is a std::set), as a merge does.
+void print_contributor(std::ostream& os, Contributor const& contributor)
+{
+  os << contributor.first << '\n';
+  FormattedContributions const formatted(contributor.second.contributions().begin(), contributor.second.contributions().end());
+  for (FormattedContributions::contributions_type::const_iterator entry = formatted.contributions().begin();
+       entry != formatted.contributions().end(); ++entry)
+    os << '\t' << *entry << '\n';
+}
+
+// A block to sort, with its full name in upper case: FullName::Compare compares those first.
+struct SortKey
+{
+  std::string M_upper;
+  ContributorBlock const* M_block;
+};
+
+// The order of FullName::Compare, and of the blocks in the text between equal names.
+struct SortKeyCompare
+{
+  bool operator()(SortKey const& k1, SortKey const& k2) const
+  {
+    int result = k1.M_upper.compare(k2.M_upper);
+    if (result == 0)
+      result = k1.M_block->M_full_name.compare(k2.M_block->M_full_name);
+    return result < 0 || (result == 0 && k1.M_block < k2.M_block);
+  }
+};
+
+} // namespace
+
+void Canonicalizer::print_on(std::ostream& os, ContributionsTxt const& contributions_txt)
+{
+  os << contributions_txt.header().as_string() << '\n';
+  for (ContributionsTxt::contributors_map::const_iterator contributor = contributions_txt.contributors().begin();
+       contributor != contributions_txt.contributors().end(); ++contributor)
+    print_contributor(os, *contributor);
+  os << '\n';
+}
+
+void Canonicalizer::canonicalize(std::string const& name, std::string const& text, std::string& result) throw(ParseError)
+{
+  TraceSpan span("canonicalize", name.c_str());
+  M_text = &text;
+  M_chunks.clear();
+  M_runs.clear();
+  if (split_contributor_blocks(text, M_header_length, M_blocks) && !M_blocks.empty())
+  {
+    // A few chunks per thread, so that they are spread evenly over the threads.
+    size_t const number_of_chunks = std::max<size_t>(1, std::min<size_t>(M_threads * 4, M_blocks.size() / min_chunk_size));
+    M_chunks.resize(number_of_chunks);
+    for (size_t index = 0; index < number_of_chunks; ++index)
+    {
+      M_chunks[index].M_first = M_blocks.size() * index / number_of_chunks;
+      M_chunks[index].M_last = M_blocks.size() * (index + 1) / number_of_chunks;
+      M_chunks[index].M_parsed = false;
+    }
+    run(&Canonicalizer::parse_chunk, number_of_chunks);
+    bool parsed = true;
+    for (std::vector<Chunk>::const_iterator chunk = M_chunks.begin(); chunk != M_chunks.end(); ++chunk)
+      parsed = parsed && chunk->M_parsed;
+    if (parsed)
+    {
+      M_runs.resize(number_of_chunks);
+      for (size_t index = 0; index < number_of_chunks; ++index)
+	M_runs[index].swap(M_chunks[index].M_printed);
+      while (M_runs.size() > 1)
+      {
+	TraceSpan span("merge runs");
+	run(&Canonicalizer::merge_runs, M_runs.size() / 2);
+	// The merged runs are at the even indices.
+	for (size_t index = 1; 2 * index < M_runs.size(); ++index)
+	  M_runs[index].swap(M_runs[2 * index]);
+	M_runs.resize((M_runs.size() + 1) / 2);
+      }
+      TraceSpan span("print");
+      result.clear();
+      result.reserve(text.size());
+      result += M_header;
+      result += '\n';
+      for (run_type::const_iterator printed = M_runs[0].begin(); printed != M_runs[0].end(); ++printed)
+	if (printed == M_runs[0].begin() || printed[-1].M_full_name != printed->M_full_name)
+	  result.append(M_chunks[printed->M_chunk].M_output, printed->M_offset, printed->M_length);
+      result += '\n';
+      return;
+    }
+  }
+  // Parse the whole text; this throws if it doesn't parse.
+  ContributionsTxt contributions_txt(name, text);
+  std::ostringstream os;
+  print_on(os, contributions_txt);
+  result = os.str();
+}
+
+void Canonicalizer::run(work_type work, size_t count)
+{
+  M_next = 0;
+  if (M_threads <= 1 || count <= 1)
+  {
+    worker(work, count);
+    return;
+  }
+  boost::thread_group workers;
+  for (size_t thread = 0; thread < M_threads && thread < count; ++thread)
+    workers.create_thread(boost::bind(&Canonicalizer::worker, this, work, count));
+  workers.join_all();
+}
+
+// Every worker has one arena for the documents of its chunks, which is released after each piece of work.
+void Canonicalizer::worker(work_type work, size_t count)
+{
+  Arena arena;
+  for (;;)
+  {
+    size_t next;
+    {
+      boost::mutex::scoped_lock lock(M_next_mutex);
+      if (M_next == count)
+	return;
+      next = M_next++;
+    }
+    (this->*work)(next, arena);
+    arena.release();
+  }
+}
+
+// Parse, sort and print the blocks of chunk index; the first chunk also gets the header.
+void Canonicalizer::parse_chunk(size_t index, Arena& arena)
+{
+  TraceSpan span("canonicalize chunk");
+  Chunk& chunk(M_chunks[index]);
+  // Give the blocks to the parser in sorted order, so that every contributor is added at the end of the map.
+  // The sort is stable, so of duplicates the first one is still added first (and the only one kept).
+  std::vector<SortKey> order(chunk.M_last - chunk.M_first);
+  bool sorted = true;
+  for (size_t block = chunk.M_first; block != chunk.M_last; ++block)
+  {
+    SortKey& key(order[block - chunk.M_first]);
+    key.M_block = &M_blocks[block];
+    key.M_upper = key.M_block->M_full_name;
+    for (std::string::iterator c = key.M_upper.begin(); c != key.M_upper.end(); ++c)
+      if (*c >= 'a' && *c <= 'z')
+	*c -= 'a' - 'A';
+    sorted = sorted && (block == chunk.M_first || SortKeyCompare()(order[block - chunk.M_first - 1], key));
+  }
+  if (!sorted)
+  {
+    TraceSpan span("sort blocks");
+    std::sort(order.begin(), order.end(), SortKeyCompare());
+  }
+  std::string text(*M_text, 0, index == 0 ? M_header_length : 0);
+  text += '\n';
+  for (std::vector<SortKey>::const_iterator key = order.begin(); key != order.end(); ++key)
+    text.append(*M_text, key->M_block->M_offset, key->M_block->M_length);
+  ContributionsTxt contributions_txt(&arena);
+  try
+  {
+    contributions_txt.parse("chunk", text);
+  }
+  catch(ParseError&)
+  {
+    return;						// Let the parse of the whole text report it.
+  }
+  // Every block must have become a contributor, except for duplicates.
+  if (contributions_txt.contributors().size() != chunk.M_last - chunk.M_first)
+  {
+    std::set<std::string> names;
+    for (size_t block = chunk.M_first; block != chunk.M_last; ++block)
+      names.insert(M_blocks[block].M_full_name);
+    if (contributions_txt.contributors().size() != names.size())
+      return;
+  }
+  std::ostringstream os;
+  chunk.M_printed.reserve(contributions_txt.contributors().size());
+  for (ContributionsTxt::contributors_map::const_iterator contributor = contributions_txt.contributors().begin();
+       contributor != contributions_txt.contributors().end(); ++contributor)
+  {
+    size_t const offset = os.tellp();
+    print_contributor(os, *contributor);
+    chunk.M_printed.push_back(Printed(contributor->first, index, offset, static_cast<size_t>(os.tellp()) - offset));
+  }
+  chunk.M_output = os.str();
+  if (index == 0)
+    M_header = contributions_txt.header().as_string();
+  chunk.M_parsed = true;
+}
+
+// Merge the sorted runs 2 * index and 2 * index + 1 into run 2 * index.
+void Canonicalizer::merge_runs(size_t index, Arena&)
+{
+  run_type& first(M_runs[2 * index]);
+  run_type& second(M_runs[2 * index + 1]);
+  run_type merged;
+  merged.reserve(first.size() + second.size());
+  std::merge(first.begin(), first.end(), second.begin(), second.end(), std::back_inserter(merged), PrintedCompare());
+  first.swap(merged);
+  run_type().swap(second);
+}
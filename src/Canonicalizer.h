@@ -0,0 +1,111 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Canonicalizer.h Declaration of class Canonicalizer.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CANONICALIZER_H
+#define CANONICALIZER_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+#include "Arena.h"
+#include "ContributorBlocks.h"
+#include "FullName.h"
+#include "exceptions.h"
+
+class ContributionsTxt;
+
+// contribmerge --canonicalize: rewrite a contributions.txt in the form in which contribmerge writes a merge:
+// whitespace normalized as the printer does, the contributors in the order of FullName::Compare,
+// the entries of every contributor in the order of their JiraProjectKey, and of every duplicate
+// contributor or JIRA key of a contributor only the first one.
+//
+// Instead of parsing the whole text into one std::map, the contributors are split into chunks
+// (see split_contributor_blocks) that are parsed, sorted and printed in parallel; the sorted chunks
+// are then merged in parallel, pairwise, into a single order. A text that can't be split that way is
+// parsed as a whole, which also reports the parse error if there is one.
+class Canonicalizer
+{
+  private:
+    // A contributor in canonical form: the name line and entry lines in the output of chunk M_chunk.
+    struct Printed
+    {
+      FullName M_full_name;
+      size_t M_chunk;
+      size_t M_offset;
+      size_t M_length;
+
+      Printed(FullName const& full_name, size_t chunk, size_t offset, size_t length) :
+          M_full_name(full_name), M_chunk(chunk), M_offset(offset), M_length(length) { }
+    };
+
+    // Sorts on the full name, then on the chunk, so that the first of equal names comes first.
+    struct PrintedCompare
+    {
+      bool operator()(Printed const& p1, Printed const& p2) const
+      {
+	if (p1.M_full_name == p2.M_full_name)
+	  return p1.M_chunk < p2.M_chunk;
+	return FullName::Compare()(p1.M_full_name, p2.M_full_name);
+      }
+    };
+
+    struct Chunk
+    {
+      size_t M_first;				// Index of the first block of this chunk.
+      size_t M_last;				// Index one past the last block of this chunk.
+      std::string M_output;			// The contributors of this chunk in canonical form.
+      std::vector<Printed> M_printed;		// Where they are in M_output, sorted.
+      bool M_parsed;				// Set if the blocks parsed into exactly their contributors.
+    };
+
+    typedef std::vector<Printed> run_type;
+    typedef void (Canonicalizer::*work_type)(size_t index, Arena& arena);
+
+    std::string const* M_text;
+    size_t M_header_length;
+    std::vector<ContributorBlock> M_blocks;
+    std::string M_header;			// The header, as parsed.
+    std::vector<Chunk> M_chunks;
+    std::vector<run_type> M_runs;		// Sorted runs, merged pairwise.
+    unsigned int M_threads;
+    boost::mutex M_next_mutex;
+    size_t M_next;				// The next chunk or pair of runs to process; protected by M_next_mutex.
+
+  public:
+    Canonicalizer(unsigned int threads) : M_text(NULL), M_header_length(0), M_threads(threads ? threads : 1), M_next(0) { }
+
+    // Write text, the contents of name, in canonical form to result.
+    void canonicalize(std::string const& name, std::string const& text, std::string& result) throw(ParseError);
+
+    // Print contributions_txt in canonical form.
+    static void print_on(std::ostream& os, ContributionsTxt const& contributions_txt);
+
+  private:
+    void run(work_type work, size_t count);
+    void worker(work_type work, size_t count);
+    void parse_chunk(size_t index, Arena& arena);
+    void merge_runs(size_t index, Arena& arena);
+
+  private:
+    Canonicalizer(Canonicalizer const&);
+    Canonicalizer& operator=(Canonicalizer const&);
+};
+
+#endif // CANONICALIZER_H
@@ -0,0 +1,182 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Changeset.cc Implementation of class Changeset.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <sstream>
+#include "debug.h"
+#endif
+
+#include "Changeset.h"
+#include "ContributionsTxt.h"
+#include "ContributorBlocks.h"
+#include "FullName.h"
+#include "ostream_operators.h"
+#include "Trace.h"
+#include <boost/lexical_cast.hpp>
+#include <boost/scoped_ptr.hpp>
+
+namespace {
+
+// Parse lines, a name line followed by entry lines, as the only contributor of document.
+Contributor const& parse_contributor(std::string const& lines, boost::scoped_ptr<ContributionsTxt>& document) throw(ParseError)
+{
+  document.reset(new ContributionsTxt("changeset", "\n" + lines));	// Empty header.
+  return *document->contributors().begin();
+}
+
+void print_contributor(std::string const& full_name, FormattedContributions::contributions_type const& entries, std::string& result)
+{
+  std::ostringstream os;
+  os << full_name << '\n';
+  for (FormattedContributions::contributions_type::const_iterator entry = entries.begin(); entry != entries.end(); ++entry)
+    os << '\t' << *entry << '\n';
+  result += os.str();
+}
+
+} // namespace
+
+void Changeset::add_change(char sign, std::string const& name_line, std::string const& added, std::string const& removed, size_t line) throw(FormatError)
+{
+  Change change;
+  change.M_sign = sign;
+  try
+  {
+    boost::scoped_ptr<ContributionsTxt> document;
+    Contributor const& contributor(parse_contributor(name_line + added, document));
+    change.M_full_name = contributor.first.full_name().str();
+    change.M_added = FormattedContributions(contributor.second.contributions().begin(), contributor.second.contributions().end());
+    Contributor const& removed_contributor(parse_contributor(name_line + removed, document));
+    change.M_removed = FormattedContributions(removed_contributor.second.contributions().begin(), removed_contributor.second.contributions().end());
+  }
+  catch(ParseError&)
+  {
+    throw FormatError("Changeset line " + boost::lexical_cast<std::string>(line) + ": not a contributor with entries");
+  }
+  if (!M_changes.empty() && !FullName::Compare()(M_changes.back().M_full_name, change.M_full_name))
+    throw FormatError("Changeset line " + boost::lexical_cast<std::string>(line) + ": \"" + change.M_full_name + "\" is not sorted");
+  M_changes.push_back(change);
+}
+
+void Changeset::read(std::string const& text) throw(FormatError)
+{
+  TraceSpan span("read changeset");
+  M_changes.clear();
+  std::istringstream is(text);
+  std::string line, name_line, added, removed;
+  char sign = 0;
+  size_t name_line_number = 0;
+  for (size_t line_number = 1; std::getline(is, line); ++line_number)
+  {
+    if (!line.empty() && line[line.size() - 1] == '\r')
+      line.erase(line.size() - 1);
+    if (line.empty())
+      continue;
+    if (line[0] != '+' && line[0] != '-' && line[0] != ' ')
+      throw FormatError("Changeset line " + boost::lexical_cast<std::string>(line_number) + ": expected '+', '-' or ' '");
+    if (line.size() > 1 && line[1] == '\t')
+    {
+      if (!sign)
+	throw FormatError("Changeset line " + boost::lexical_cast<std::string>(line_number) + ": entry without contributor");
+      (line[0] == '+' ? added : removed) += line.substr(1) + '\n';
+      continue;
+    }
+    if (sign)
+      add_change(sign, name_line, added, removed, name_line_number);
+    sign = line[0];
+    name_line = line.substr(1) + '\n';
+    name_line_number = line_number;
+    added.clear();
+    removed.clear();
+  }
+  if (sign)
+    add_change(sign, name_line, added, removed, name_line_number);
+}
+
+bool Changeset::apply(std::string const& target, std::string& result) const throw(FormatError, ParseError)
+{
+  TraceSpan span("apply");
+  result.reserve(result.size() + target.size());
+  SortedContributorBlockReader reader(target.data(), target.size());
+  ContributorBlock block;
+  bool have_block = reader.next(block);
+  // The bytes of target up to pos have been dealt with; list_end is the end of the last block read.
+  size_t pos = 0;
+  size_t list_end = have_block ? block.M_offset + block.M_length : target.size();
+  FullName::Compare compare;
+  // A change that doesn't apply is only reported once the whole target turned out to be sorted:
+  // otherwise the contributor might still be further on.
+  std::string error;
+  for (std::vector<Change>::const_iterator change = M_changes.begin(); change != M_changes.end(); ++change)
+  {
+    while (have_block && compare(block.M_full_name, change->M_full_name))
+      if ((have_block = reader.next(block)))
+	list_end = block.M_offset + block.M_length;
+    if (!have_block && !reader.valid())
+      return false;
+    bool const exists = have_block && block.M_full_name == change->M_full_name;
+    // Copy the unchanged contributors before this one in one go.
+    size_t const at = exists ? block.M_offset : have_block ? block.M_offset : list_end;
+    result.append(target, pos, at - pos);
+    pos = at;
+    if (!exists && (change->M_sign != '+' || !change->M_removed.contributions().empty()))
+    {
+      if (error.empty())
+	error = "Cannot change \"" + change->M_full_name + "\": no such contributor";
+      continue;
+    }
+    FormattedContributions::contributions_type entries;
+    if (exists)
+    {
+      boost::scoped_ptr<ContributionsTxt> document;
+      Contributor const& contributor(parse_contributor(target.substr(block.M_offset, block.M_length), document));
+      entries.insert(contributor.second.contributions().begin(), contributor.second.contributions().end());
+      pos = block.M_offset + block.M_length;
+      if ((have_block = reader.next(block)))
+	list_end = block.M_offset + block.M_length;
+    }
+    if (change->M_sign == '-')
+      continue;
+    for (FormattedContributions::contributions_type::const_iterator entry = change->M_removed.contributions().begin();
+         entry != change->M_removed.contributions().end(); ++entry)
+      if (!entries.erase(*entry) && error.empty())
+      {
+	std::ostringstream key;
+	key << entry->jira_project_key();
+	error = "Cannot remove " + key.str() + " from \"" + change->M_full_name + "\": no such entry";
+      }
+    for (FormattedContributions::contributions_type::const_iterator entry = change->M_added.contributions().begin();
+         entry != change->M_added.contributions().end(); ++entry)
+    {
+      entries.erase(*entry);
+      entries.insert(*entry);
+    }
+    print_contributor(change->M_full_name, entries, result);
+  }
+  // The unchanged contributors after the last change, and everything that follows the list.
+  result.append(target, pos, std::string::npos);
+  // Check the rest of the list, too.
+  while (have_block)
+    have_block = reader.next(block);
+  if (!reader.valid())
+    return false;
+  if (!error.empty())
+    throw FormatError(error);
+  return true;
+}
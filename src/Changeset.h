@@ -0,0 +1,68 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Changeset.h Declaration of class Changeset.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CHANGESET_H
+#define CHANGESET_H
+
+#include <string>
+#include <vector>
+#include "exceptions.h"
+#include "FormattedContributions.h"
+
+// contribmerge --apply: a sorted list of changes to the contributors of a contributions.txt,
+// in the text format that contribmerge --diff prints. For every contributor a line with a sign
+// and the full name, followed by the entries to remove ("-<tab><entry>") and to add ("+<tab><entry>"):
+//
+//   -<name>	Remove the contributor with all of their entries.
+//   +<name>	Add the contributor, or the entries to an existing one.
+//    <name>	Change the entries of an existing contributor.
+//
+// Entries are matched by their JIRA key: an added entry replaces one with the same key.
+// The contributors must be in the order of FullName::Compare (which is how contribmerge writes them).
+class Changeset
+{
+  private:
+    struct Change
+    {
+      char M_sign;				// '+', '-' or ' '.
+      std::string M_full_name;
+      FormattedContributions M_added;
+      FormattedContributions M_removed;
+    };
+
+    std::vector<Change> M_changes;
+
+  public:
+    // Parse text. Throws if it isn't a changeset.
+    void read(std::string const& text) throw(FormatError);
+
+    // Append target with all changes applied to result. Only the contributors that change are
+    // parsed and written again; everything else is copied byte for byte.
+    // Returns false if target can't be walked (see ContributionsDiff::is_walkable), and
+    // throws if a change doesn't apply to target; result is undefined in both cases.
+    bool apply(std::string const& target, std::string& result) const throw(FormatError, ParseError);
+
+    // Accessors.
+    size_t size(void) const { return M_changes.size(); }
+
+  private:
+    void add_change(char sign, std::string const& name_line, std::string const& added, std::string const& removed, size_t line) throw(FormatError);
+};
+
+#endif // CHANGESET_H
@@ -0,0 +1,347 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ColumnarFormat.cc Implementation of class ColumnarImage and write_columnar.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <algorithm>
+#include <map>
+#include <sstream>
+#include <utility>
+#include <vector>
+#include <unistd.h>
+#include "debug.h"
+#endif
+
+#include "ColumnarFormat.h"
+#include "ContributionsTxt.h"
+#include "ostream_operators.h"
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+char const magic[8] = { 'C', 'M', 'C', 'O', 'L', 'U', 'M', 'N' };
+uint32_t const version = 1;
+
+void put32(std::string& image, uint32_t value)
+{
+  for (int i = 0; i < 4; ++i)
+    image += static_cast<char>((value >> (8 * i)) & 0xff);
+}
+
+void put64(std::string& image, uint64_t value)
+{
+  put32(image, value & 0xffffffff);
+  put32(image, value >> 32);
+}
+
+// A packed JIRA key and the index of its entry in the contributor.
+typedef std::pair<uint64_t, uint32_t> keyed_entry;
+
+struct KeyCompare
+{
+  bool operator()(keyed_entry const& e1, keyed_entry const& e2) const { return e1.first < e2.first; }
+};
+
+} // namespace
+
+ColumnarImage::ColumnarImage(char const* data, size_t size) throw(FormatError) :
+    M_data(reinterpret_cast<unsigned char const*>(data)), M_size(size), M_mapped(false)
+{
+  check_header();
+}
+
+ColumnarImage::ColumnarImage(std::string const& filename) throw(FormatError) : M_data(NULL), M_size(0), M_mapped(false)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    throw FormatError("Cannot open \"" + filename + "\"");
+  struct stat buf;
+  void* addr = MAP_FAILED;
+  if (fstat(fd, &buf) == 0 && buf.st_size > 0)
+    addr = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    throw FormatError("Cannot map \"" + filename + "\"");
+  M_data = static_cast<unsigned char const*>(addr);
+  M_size = buf.st_size;
+  M_mapped = true;
+  try
+  {
+    check_header();
+  }
+  catch (FormatError&)
+  {
+    munmap(const_cast<unsigned char*>(M_data), M_size);
+    throw;
+  }
+}
+
+ColumnarImage::~ColumnarImage()
+{
+  if (M_mapped)
+    munmap(const_cast<unsigned char*>(M_data), M_size);
+}
+
+bool ColumnarImage::is_columnar(char const* data, size_t size)
+{
+  return size >= sizeof(magic) && std::memcmp(data, magic, sizeof(magic)) == 0;
+}
+
+uint32_t ColumnarImage::get32(size_t offset) const
+{
+  unsigned char const* p = M_data + offset;
+  return (uint32_t)p[0] | (uint32_t)p[1] << 8 | (uint32_t)p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+uint64_t ColumnarImage::get64(size_t offset) const
+{
+  return (uint64_t)get32(offset) | (uint64_t)get32(offset + 4) << 32;
+}
+
+void ColumnarImage::check_header(void) const throw(FormatError)
+{
+  if (M_size < header_size || !is_columnar(reinterpret_cast<char const*>(M_data), M_size))
+    throw FormatError("Not a columnar image");
+  if (get32(8) != version)
+    throw FormatError("Unsupported columnar image version");
+  uint64_t const C = contributors(), E = entries(), P = prefixes();
+  bool ok = get32(16) == M_size &&
+            (uint64_t)get32(40) + get32(44) <= M_size &&
+            (uint64_t)get32(48) + 4 * (C + 1) <= M_size &&
+            (uint64_t)get32(52) + 4 * (C + 1) <= M_size &&
+            (uint64_t)get32(56) + 4 * (P + 1) <= M_size &&
+            (uint64_t)get32(60) + 8 * E <= M_size &&
+            (!has_comments() || (uint64_t)get32(64) + 4 * (E + 1) <= M_size) &&
+            (!has_raw() || ((uint64_t)get32(68) + 4 * (C + 1) <= M_size && (uint64_t)get32(72) + 4 * E <= M_size));
+  if (!ok)
+    throw FormatError("Truncated or corrupt columnar image");
+}
+
+bool ColumnarImage::validate(void) const
+{
+  uint32_t const C = contributors(), E = entries(), P = prefixes();
+  uint32_t const strings_size = get32(44);
+  if ((uint64_t)get32(32) + get32(36) > strings_size)
+    return false;
+  // Every string column must be non-decreasing and inside the string table.
+  for (uint32_t i = 0; i < C; ++i)
+    if (column32(48, i) > column32(48, i + 1))
+      return false;
+  if (column32(48, C) > strings_size)
+    return false;
+  for (uint32_t i = 0; i < P; ++i)
+    if (column32(56, i) > column32(56, i + 1))
+      return false;
+  if (column32(56, P) > strings_size)
+    return false;
+  if (has_comments())
+  {
+    for (uint32_t i = 0; i < E; ++i)
+      if (column32(64, i) > column32(64, i + 1))
+	return false;
+    if (column32(64, E) > strings_size)
+      return false;
+  }
+  if (has_raw())
+  {
+    for (uint32_t i = 0; i < C; ++i)
+      if (column32(68, i) > column32(68, i + 1))
+	return false;
+    if (column32(68, C) > strings_size)
+      return false;
+  }
+  // The entry ranges must partition [0, E) and the keys must be sorted per contributor.
+  if (column32(52, 0) != 0 || column32(52, C) != E)
+    return false;
+  for (uint32_t c = 0; c < C; ++c)
+  {
+    if (first_entry(c) > end_entry(c))
+      return false;
+    for (uint32_t e = first_entry(c); e < end_entry(c); ++e)
+      if ((key(e) >> 32) >= P || (e > first_entry(c) && key(e - 1) > key(e)))
+	return false;
+  }
+  // The order column must be a permutation of the entries of each contributor.
+  if (has_raw())
+  {
+    std::vector<bool> seen(E, false);
+    for (uint32_t c = 0; c < C; ++c)
+      for (uint32_t n = 0; n < end_entry(c) - first_entry(c); ++n)
+      {
+	uint32_t const e = text_entry(c, n);
+	if (e < first_entry(c) || e >= end_entry(c) || seen[e])
+	  return false;
+	seen[e] = true;
+      }
+  }
+  return true;
+}
+
+void ColumnarImage::to_contributions_txt(ContributionsTxt& contributions_txt) const
+{
+  contributions_txt = Header(header().to_string());
+  for (uint32_t c = 0; c < contributors(); ++c)
+  {
+    Contributions& contributions(contributions_txt.add_contributor(name(c).to_string()));
+    // Without a raw column, use what contribmerge would write as raw text.
+    std::ostringstream normalized;
+    normalized << name(c) << '\n';
+    for (uint32_t n = 0; n < end_entry(c) - first_entry(c); ++n)
+    {
+      uint32_t const e = text_entry(c, n);
+      boost::string_ref const comment_text(comment(e));
+      ContributionEntry entry(JiraProjectKey(prefix(key(e)).to_string(), issue_number(key(e))), comment_text.data(), comment_text.size());
+      if (!has_raw())
+	normalized << '\t' << entry << '\n';
+      contributions.add_entry(entry);
+    }
+    if (has_raw())
+      contributions.assign_raw_string(raw(c).data(), raw(c).size());
+    else
+    {
+      std::string const raw_string(normalized.str());
+      contributions.assign_raw_string(raw_string.data(), raw_string.size());
+    }
+  }
+}
+
+void write_columnar(ContributionsTxt const& contributions_txt, std::ostream& os, bool with_comments)
+{
+  // The prefixes, sorted, so that packed keys compare like JIRA keys.
+  typedef std::map<InternedString, uint32_t> prefixes_map;
+  prefixes_map prefixes;
+  for (ContributionsTxt::contributors_map::const_iterator contributor = contributions_txt.contributors().begin();
+       contributor != contributions_txt.contributors().end(); ++contributor)
+    for (Contributions::contributions_type::const_iterator entry = contributor->second.contributions().begin();
+         entry != contributor->second.contributions().end(); ++entry)
+      prefixes[entry->jira_project_key().jira_project_key_prefix()] = 0;
+
+  std::string strings(contributions_txt.header().as_string());
+  std::vector<uint32_t> prefix_column;
+  uint32_t index = 0;
+  for (prefixes_map::iterator prefix = prefixes.begin(); prefix != prefixes.end(); ++prefix)
+  {
+    prefix->second = index++;
+    prefix_column.push_back(strings.size());
+    strings.append(prefix->first.data(), prefix->first.size());
+  }
+  prefix_column.push_back(strings.size());
+
+  std::vector<uint32_t> name_column, range_column, comment_column, raw_column, order_column;
+  std::vector<uint64_t> key_column;
+  std::vector<keyed_entry> sorted;
+  for (ContributionsTxt::contributors_map::const_iterator contributor = contributions_txt.contributors().begin();
+       contributor != contributions_txt.contributors().end(); ++contributor)
+  {
+    name_column.push_back(strings.size());
+    strings.append(contributor->first.full_name().data(), contributor->first.full_name().size());
+  }
+  name_column.push_back(strings.size());
+  // All comments are contiguous, so that the end of one is the start of the next.
+  for (ContributionsTxt::contributors_map::const_iterator contributor = contributions_txt.contributors().begin();
+       contributor != contributions_txt.contributors().end(); ++contributor)
+  {
+    uint32_t const first_entry = key_column.size();
+    range_column.push_back(first_entry);
+    Contributions::contributions_type const& entries(contributor->second.contributions());
+    sorted.clear();
+    for (uint32_t n = 0; n < entries.size(); ++n)
+    {
+      JiraProjectKey const& key(entries[n].jira_project_key());
+      sorted.push_back(keyed_entry((uint64_t)prefixes[key.jira_project_key_prefix()] << 32 | (uint32_t)key.issue_number(), n));
+    }
+    std::stable_sort(sorted.begin(), sorted.end(), KeyCompare());
+    if (with_comments)
+      order_column.resize(first_entry + sorted.size());
+    for (std::vector<keyed_entry>::const_iterator entry = sorted.begin(); entry != sorted.end(); ++entry)
+    {
+      if (with_comments)
+      {
+	order_column[first_entry + entry->second] = key_column.size();
+	comment_column.push_back(strings.size());
+	strings.append(entries[entry->second].comment().data(), entries[entry->second].comment().size());
+      }
+      key_column.push_back(entry->first);
+    }
+  }
+  range_column.push_back(key_column.size());
+  if (with_comments)
+  {
+    comment_column.push_back(strings.size());
+    // The raw text contains the comments, so it is only written with them.
+    for (ContributionsTxt::contributors_map::const_iterator contributor = contributions_txt.contributors().begin();
+         contributor != contributions_txt.contributors().end(); ++contributor)
+    {
+      raw_column.push_back(strings.size());
+      strings.append(contributor->second.raw_string().data(), contributor->second.raw_string().size());
+    }
+    raw_column.push_back(strings.size());
+  }
+
+  // Layout.
+  size_t const names_offset = ColumnarImage::header_size;
+  size_t const ranges_offset = names_offset + 4 * name_column.size();
+  size_t const prefixes_offset = ranges_offset + 4 * range_column.size();
+  size_t const keys_offset = (prefixes_offset + 4 * prefix_column.size() + 7) & ~(size_t)7;
+  size_t const comments_offset = keys_offset + 8 * key_column.size();
+  size_t const raws_offset = comments_offset + 4 * comment_column.size();
+  size_t const orders_offset = raws_offset + 4 * raw_column.size();
+  size_t const strings_offset = orders_offset + 4 * order_column.size();
+  size_t const size = strings_offset + strings.size();
+
+  std::string image(magic, sizeof(magic));
+  put32(image, version);
+  put32(image, with_comments ? 3 : 0);
+  put32(image, size);
+  put32(image, contributions_txt.contributors().size());
+  put32(image, key_column.size());
+  put32(image, prefixes.size());
+  put32(image, 0);					// The header is at the start of the string table.
+  put32(image, contributions_txt.header().as_string().size());
+  put32(image, strings_offset);
+  put32(image, strings.size());
+  put32(image, names_offset);
+  put32(image, ranges_offset);
+  put32(image, prefixes_offset);
+  put32(image, keys_offset);
+  put32(image, with_comments ? comments_offset : 0);
+  put32(image, with_comments ? raws_offset : 0);
+  put32(image, with_comments ? orders_offset : 0);
+  put32(image, 0);
+  for (std::vector<uint32_t>::const_iterator i = name_column.begin(); i != name_column.end(); ++i)
+    put32(image, *i);
+  for (std::vector<uint32_t>::const_iterator i = range_column.begin(); i != range_column.end(); ++i)
+    put32(image, *i);
+  for (std::vector<uint32_t>::const_iterator i = prefix_column.begin(); i != prefix_column.end(); ++i)
+    put32(image, *i);
+  image.resize(keys_offset, '\0');
+  for (std::vector<uint64_t>::const_iterator i = key_column.begin(); i != key_column.end(); ++i)
+    put64(image, *i);
+  for (std::vector<uint32_t>::const_iterator i = comment_column.begin(); i != comment_column.end(); ++i)
+    put32(image, *i);
+  for (std::vector<uint32_t>::const_iterator i = raw_column.begin(); i != raw_column.end(); ++i)
+    put32(image, *i);
+  for (std::vector<uint32_t>::const_iterator i = order_column.begin(); i != order_column.end(); ++i)
+    put32(image, *i);
+  image += strings;
+  os.write(image.data(), image.size());
+}
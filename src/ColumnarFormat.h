@@ -0,0 +1,140 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ColumnarFormat.h Declaration of class ColumnarImage and write_columnar.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef COLUMNARFORMAT_H
+#define COLUMNARFORMAT_H
+
+#include <string>
+#include <iosfwd>
+#include <stddef.h>
+#include <stdint.h>
+#include <boost/utility/string_ref.hpp>
+#include "exceptions.h"
+
+class ContributionsTxt;
+
+// The columnar binary format for doc/contributions.txt data.
+//
+// The entries of each contributor are sorted by JIRA key. With comments, an image also holds
+// the raw text of every contributor and the order of its entries in that text, so that
+// loading it gives the same document as parsing the text: text -> binary -> text writes
+// what text -> text writes, and a merge of binary and text inputs leaves unchanged
+// contributors alone. Without comments the document is normalized: entries are sorted
+// and the raw text is what contribmerge would write.
+// All integers are unsigned little endian. A file starts with a header of 20 32-bit words:
+//
+//   Byte  Field
+//    0    magic: the 8 characters "CMCOLUMN"
+//    8    version: 1
+//   12    flags: bit 0 is set when there is a comments column,
+//         bit 1 when there are a raw column and an order column
+//   16    size: the size of the whole file in bytes
+//   20    C: the number of contributors
+//   24    E: the total number of entries
+//   28    P: the number of distinct JIRA project key prefixes
+//   32    header offset and
+//   36    header size: the text before the first contributor, within the string table
+//   40    string table offset and
+//   44    string table size: all text, in the file
+//   48    names column: C + 1 32-bit offsets within the string table;
+//         the name of contributor i is [names[i], names[i + 1]). Contributors are in contribmerge's order.
+//   52    entry ranges column: C + 1 32-bit entry indices;
+//         the entries of contributor i are [ranges[i], ranges[i + 1]), ranges[0] = 0 and ranges[C] = E.
+//   56    prefixes column: P + 1 32-bit offsets within the string table, sorted by prefix.
+//   60    keys column: E 64-bit packed JIRA keys, 8-byte aligned, sorted per contributor.
+//         A key is (prefix index << 32) | issue number, with issue number 0 for a key without one;
+//         so comparing packed keys is the same as comparing JIRA keys.
+//   64    comments column: E + 1 32-bit offsets within the string table, or 0 if there is none.
+//         The comment of entry j is [comments[j], comments[j + 1]), including its leading white space.
+//   68    raw column: C + 1 32-bit offsets within the string table, or 0 if there is none.
+//         The raw text of contributor i, from its name up to and including its last newline,
+//         is [raws[i], raws[i + 1]).
+//   72    order column: E 32-bit entry indices, or 0 if there is none. The n-th entry of
+//         contributor i in its raw text is orders[ranges[i] + n]; a permutation of its range.
+//   76    reserved, 0.
+//
+// Images written before the raw and order columns existed have a header of 18 words and
+// never set bit 1 of the flags.
+//
+// Column positions are offsets in the file.
+class ColumnarImage
+{
+  public:
+    static size_t const header_size = 80;
+
+  private:
+    unsigned char const* M_data;
+    size_t M_size;
+    bool M_mapped;					// True if M_data was mmapped by us.
+
+  public:
+    // Use size bytes at data, which must stay valid as long as this object exists.
+    ColumnarImage(char const* data, size_t size) throw(FormatError);
+    // Map the file filename read-only.
+    explicit ColumnarImage(std::string const& filename) throw(FormatError);
+    ~ColumnarImage();
+
+    // Return true if data starts like a columnar image.
+    static bool is_columnar(char const* data, size_t size);
+
+    // The constructors only check the header and that the columns are inside the file.
+    // This checks every offset, index and key, so that no accessor can read outside the image.
+    bool validate(void) const;
+
+    // Accessors. They read the image directly; nothing is deserialized.
+    uint32_t contributors(void) const { return get32(20); }
+    uint32_t entries(void) const { return get32(24); }
+    uint32_t prefixes(void) const { return get32(28); }
+    bool has_comments(void) const { return get32(12) & 1; }
+    bool has_raw(void) const { return get32(12) & 2; }
+    boost::string_ref header(void) const { return string(get32(32), get32(32) + get32(36)); }
+    boost::string_ref name(uint32_t contributor) const { return string(column32(48, contributor), column32(48, contributor + 1)); }
+    uint32_t first_entry(uint32_t contributor) const { return column32(52, contributor); }
+    uint32_t end_entry(uint32_t contributor) const { return column32(52, contributor + 1); }
+    uint64_t key(uint32_t entry) const { return get64(get32(60) + 8 * (size_t)entry); }
+    boost::string_ref prefix(uint64_t key) const { uint32_t p = key >> 32; return string(column32(56, p), column32(56, p + 1)); }
+    static uint32_t issue_number(uint64_t key) { return key & 0xffffffff; }
+    boost::string_ref comment(uint32_t entry) const
+        { return has_comments() ? string(column32(64, entry), column32(64, entry + 1)) : boost::string_ref(); }
+    boost::string_ref raw(uint32_t contributor) const
+        { return has_raw() ? string(column32(68, contributor), column32(68, contributor + 1)) : boost::string_ref(); }
+    // The entry that is the n-th of contributor in its raw text; without an order column, the n-th in key order.
+    uint32_t text_entry(uint32_t contributor, uint32_t n) const
+        { return has_raw() ? column32(72, first_entry(contributor) + n) : first_entry(contributor) + n; }
+
+    // Fill the empty document contributions_txt.
+    void to_contributions_txt(ContributionsTxt& contributions_txt) const;
+
+  private:
+    uint32_t get32(size_t offset) const;
+    uint64_t get64(size_t offset) const;
+    uint32_t column32(size_t field, uint32_t index) const { return get32(get32(field) + 4 * (size_t)index); }
+    boost::string_ref string(uint32_t begin, uint32_t end) const
+        { return boost::string_ref(reinterpret_cast<char const*>(M_data) + get32(40) + begin, end - begin); }
+    void check_header(void) const throw(FormatError);
+
+  private:
+    ColumnarImage(ColumnarImage const&);
+    ColumnarImage& operator=(ColumnarImage const&);
+};
+
+// Write contributions_txt to os in the columnar format; without comments if with_comments is false.
+void write_columnar(ContributionsTxt const& contributions_txt, std::ostream& os, bool with_comments = true);
+
+#endif // COLUMNARFORMAT_H
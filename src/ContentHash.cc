@@ -0,0 +1,73 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ContentHash.cc Implementation of content_hash, to_hex and executable_identity.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <sstream>
+#include "debug.h"
+#endif
+
+#include "ContentHash.h"
+#include <boost/uuid/detail/sha1.hpp>
+#include <sys/stat.h>
+
+std::string content_hash(char const* data, size_t size)
+{
+  boost::uuids::detail::sha1 sha1;
+  sha1.process_bytes(data, size);
+  boost::uuids::detail::sha1::digest_type digest;
+  sha1.get_digest(digest);
+  std::string hash(20, '\0');
+  for (int i = 0; i < 5; ++i)
+    for (int j = 0; j < 4; ++j)
+      hash[4 * i + j] = (digest[i] >> (24 - 8 * j)) & 0xff;
+  return hash;
+}
+
+std::string to_hex(std::string const& binary)
+{
+  static char const digits[] = "0123456789abcdef";
+  std::string hex;
+  hex.reserve(2 * binary.size());
+  for (std::string::const_iterator c = binary.begin(); c != binary.end(); ++c)
+  {
+    hex += digits[(unsigned char)*c >> 4];
+    hex += digits[*c & 0xf];
+  }
+  return hex;
+}
+
+std::string const& executable_identity(void)
+{
+  static std::string identity;
+  if (identity.empty())
+  {
+    std::ostringstream os;
+#ifdef PACKAGE_STRING
+    os << PACKAGE_STRING;
+#else
+    os << "contribmerge";
+#endif
+    struct stat buf;
+    if (stat("/proc/self/exe", &buf) == 0)
+      os << ' ' << buf.st_size << ' ' << buf.st_mtime;
+    identity = os.str();
+  }
+  return identity;
+}
@@ -0,0 +1,37 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ContentHash.h Declaration of content_hash, to_hex and executable_identity.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CONTENTHASH_H
+#define CONTENTHASH_H
+
+#include <string>
+#include <stddef.h>
+
+// The SHA-1 of size bytes at data, as 20 byte binary string.
+std::string content_hash(char const* data, size_t size);
+inline std::string content_hash(std::string const& data) { return content_hash(data.data(), data.size()); }
+
+// Lower case hexadecimal representation of binary data.
+std::string to_hex(std::string const& binary);
+
+// The package version plus the size and modification time of the running executable;
+// part of the key of anything cached that a rebuild could invalidate.
+std::string const& executable_identity(void);
+
+#endif // CONTENTHASH_H
@@ -20,20 +20,26 @@
 #ifndef CONTRIBUTIONENTRY_H
 #define CONTRIBUTIONENTRY_H
 
-#include <string>
+#include "InternedString.h"
 #include "JiraProjectKey.h"
 
 // Grammar rule: contribution_entry
+//
+// The comment is interned: equal comments of different documents compare equal by pointer.
 class ContributionEntry
 {
   private:
     JiraProjectKey M_jira_project_key;		// "VWR-123"
-    std::string M_comment;			// Optional (empty if there is none).
+    InternedString M_comment;			// Optional (empty if there is none).
 
   public:
+    ContributionEntry(void) { }
+    ContributionEntry(JiraProjectKey const& jira_project_key, char const* comment, size_t comment_size) :
+        M_jira_project_key(jira_project_key), M_comment(comment, comment_size) { }
+
     // Accessors.
     JiraProjectKey const& jira_project_key(void) const { return M_jira_project_key; }
-    std::string const& comment(void) const { return M_comment; }
+    InternedString const& comment(void) const { return M_comment; }
 };
 
 #endif // CONTRIBUTIONENTRY_H
@@ -25,9 +25,59 @@
 
 #include "Contributions.h"
 #include "Inserter.h"
+#include <new>
+#include <boost/type_traits/alignment_of.hpp>
 
-Contributions::Contributions(FormattedContributions const& fc)
+ContributionsPayload* ContributionsPayload::create(allocator_type const& alloc)
 {
-  Inserter<contributions_type> insert_into_contributions(M_contributions);
+  void* memory = alloc.resource()->allocate(sizeof(ContributionsPayload), boost::alignment_of<ContributionsPayload>::value);
+  return new (memory) ContributionsPayload(alloc);
+}
+
+ContributionsPayload* ContributionsPayload::clone(allocator_type const& alloc) const
+{
+  void* memory = alloc.resource()->allocate(sizeof(ContributionsPayload), boost::alignment_of<ContributionsPayload>::value);
+  return new (memory) ContributionsPayload(*this, alloc);
+}
+
+void intrusive_ptr_release(ContributionsPayload const* payload)
+{
+  if (--payload->M_count == 0)
+  {
+    boost::container::pmr::memory_resource* resource = payload->resource();
+    payload->~ContributionsPayload();
+    resource->deallocate(const_cast<ContributionsPayload*>(payload), sizeof(ContributionsPayload), boost::alignment_of<ContributionsPayload>::value);
+  }
+}
+
+Contributions::Contributions(FormattedContributions const& fc, allocator_type const& alloc) : M_allocator(alloc)
+{
+  ContributionsPayload& payload(this->payload());
+  payload.M_contributions.reserve(fc.contributions().size());
+  Inserter<contributions_type> insert_into_contributions(payload.M_contributions);
   for_each(fc.contributions().begin(), fc.contributions().end(), insert_into_contributions);
 }
+
+Contributions Contributions::copy(allocator_type const& alloc) const
+{
+  Contributions result(alloc);
+  if (M_payload)
+    result.M_payload = M_payload->clone(alloc);
+  return result;
+}
+
+ContributionsPayload& Contributions::payload(void)
+{
+  if (!M_payload)
+    M_payload = ContributionsPayload::create(M_allocator);
+  else if (M_payload->shared())
+    M_payload = M_payload->clone(M_allocator);
+  return *M_payload;
+}
+
+ContributionsPayload const& Contributions::empty_payload(void)
+{
+  // Never released.
+  static boost::intrusive_ptr<ContributionsPayload> const empty(ContributionsPayload::create(allocator_type()));
+  return *empty;
+}
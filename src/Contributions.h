@@ -20,32 +20,90 @@
 #ifndef CONTRIBUTIONS_H
 #define CONTRIBUTIONS_H
 
-#include <vector>
-#include <string>
+#include <boost/container/pmr/vector.hpp>
+#include <boost/intrusive_ptr.hpp>
+#include <boost/smart_ptr/detail/atomic_count.hpp>
+#include "Arena.h"
 #include "FormattedContributions.h"
 
+// The data of a Contributions. It is reference counted and shared by every Contributions
+// that refers to it, also across documents, and never changes once it is shared.
+// It lives in the memory resource that it was created with.
+class ContributionsPayload
+{
+  public:
+    typedef ArenaAllocator allocator_type;
+    typedef boost::container::pmr::vector_of<ContributionEntry>::type contributions_type;
+
+  private:
+    mutable boost::detail::atomic_count M_count;
+
+  public:
+    ArenaString M_raw_string;				// Raw contributor data (including full name).
+    contributions_type M_contributions;			// Vector of ContributionEntry's.
+
+    // Create an empty payload, or a copy of this, in the memory resource of alloc.
+    static ContributionsPayload* create(allocator_type const& alloc);
+    ContributionsPayload* clone(allocator_type const& alloc) const;
+
+    boost::container::pmr::memory_resource* resource(void) const { return M_raw_string.get_allocator().resource(); }
+    bool shared(void) const { return M_count > 1; }
+
+    friend void intrusive_ptr_add_ref(ContributionsPayload const* payload) { ++payload->M_count; }
+    friend void intrusive_ptr_release(ContributionsPayload const* payload);
+
+  private:
+    ContributionsPayload(allocator_type const& alloc) : M_count(0), M_raw_string(alloc), M_contributions(alloc) { }
+    ContributionsPayload(ContributionsPayload const& payload, allocator_type const& alloc) :
+        M_count(0), M_raw_string(payload.M_raw_string, alloc), M_contributions(payload.M_contributions, alloc) { }
+    ContributionsPayload(ContributionsPayload const&);
+    ContributionsPayload& operator=(ContributionsPayload const&);
+};
+
 // Grammar rule: contributor.
+//
+// A handle to a ContributionsPayload: copying a Contributions, also into a container with
+// another allocator, shares the payload. The builder functions copy it first if it is shared.
 class Contributions
 {
   public:
-    typedef std::vector<ContributionEntry> contributions_type;
+    typedef ArenaAllocator allocator_type;
+    typedef ContributionsPayload::contributions_type contributions_type;
 
   private:
-    std::string M_raw_string;				// Raw contributor data (including full name).
-    contributions_type M_contributions;			// Vector of ContributionEntry's.
+    boost::intrusive_ptr<ContributionsPayload> M_payload;	// NULL while empty.
+    allocator_type M_allocator;				// Allocator of a new payload.
 
   public:
-    Contributions(void) { }
-    Contributions(FormattedContributions const& fc);
+    Contributions(allocator_type const& alloc = allocator_type()) : M_allocator(alloc) { }
+    Contributions(Contributions const& contributions) : M_payload(contributions.M_payload), M_allocator(contributions.M_allocator) { }
+    Contributions(Contributions const& contributions, allocator_type const& alloc) : M_payload(contributions.M_payload), M_allocator(alloc) { }
+    Contributions(FormattedContributions const& fc, allocator_type const& alloc = allocator_type());
+    Contributions& operator=(Contributions const& contributions) { M_payload = contributions.M_payload; return *this; }
+
+    // Builders; used by the grammar and by loaders of binary images.
+    void reset(allocator_type const& alloc) { M_payload.reset(); M_allocator = alloc; }
+    void assign_raw_string(ArenaString const& raw_string) { payload().M_raw_string = raw_string; }
+    void assign_raw_string(char const* raw_string, size_t size) { payload().M_raw_string.assign(raw_string, raw_string + size); }
+    template<typename Iterator>
+      void assign_raw_string(Iterator begin, Iterator end) { payload().M_raw_string.assign(begin, end); }
+    void add_entry(ContributionEntry const& entry) { payload().M_contributions.push_back(entry); }
 
-    std::insert_iterator<contributions_type> get_inserter(void) { return std::inserter(M_contributions, M_contributions.begin()); }
+    // Return a Contributions with a copy of the payload in the memory resource of alloc.
+    Contributions copy(allocator_type const& alloc) const;
 
     // Accessors.
-    std::string const& raw_string(void) const { return M_raw_string; }
-    contributions_type const& contributions(void) const { return M_contributions; }
+    ArenaString const& raw_string(void) const { return (M_payload ? *M_payload : empty_payload()).M_raw_string; }
+    contributions_type const& contributions(void) const { return (M_payload ? *M_payload : empty_payload()).M_contributions; }
+    boost::container::pmr::memory_resource* resource(void) const { return M_payload ? M_payload->resource() : M_allocator.resource(); }
+    bool shares_payload_with(Contributions const& contributions) const { return M_payload && M_payload == contributions.M_payload; }
 
   public:
-    operator FormattedContributions(void) const { return M_contributions; }
+    operator FormattedContributions(void) const { return FormattedContributions(contributions().begin(), contributions().end()); }
+
+  private:
+    ContributionsPayload& payload(void);
+    static ContributionsPayload const& empty_payload(void);
 };
 
 #endif // CONTRIBUTIONS_H
@@ -0,0 +1,254 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ContributionsDiff.cc Implementation of class ContributionsDiff.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include "debug.h"
+#endif
+
+#include "ContributionsDiff.h"
+#include "ContributionsTxt.h"
+#include "ContributorBlocks.h"
+#include "FormattedContributions.h"
+#include "FullName.h"
+#include "json.h"
+#include "ostream_operators.h"
+#include "three_way_merge.h"
+#include "Trace.h"
+#include <boost/scoped_ptr.hpp>
+
+namespace {
+
+// A contributor block of the old or the new text.
+struct DiffBlock
+{
+  char const* M_text;
+  ContributorBlock M_block;
+  bool M_new;
+
+  DiffBlock(char const* text, bool is_new) : M_text(text), M_new(is_new) { M_block.M_offset = M_block.M_length = 0; }
+};
+
+// Input iterator over the blocks of a text; the default constructed iterator is the end.
+class BlockIterator
+{
+  private:
+    ContributorBlockReader* M_reader;		// NULL at the end.
+    DiffBlock M_current;
+
+  public:
+    BlockIterator(void) : M_reader(NULL), M_current(NULL, false) { }
+    BlockIterator(ContributorBlockReader& reader, char const* text, bool is_new) : M_reader(&reader), M_current(text, is_new) { ++*this; }
+
+    DiffBlock const& operator*(void) const { return M_current; }
+    DiffBlock const* operator->(void) const { return &M_current; }
+    BlockIterator& operator++(void) { if (!M_reader->next(M_current.M_block)) M_reader = NULL; return *this; }
+    BlockIterator operator++(int) { BlockIterator previous(*this); ++*this; return previous; }
+
+    // Only comparing with the end is meaningful.
+    friend bool operator==(BlockIterator const& i1, BlockIterator const& i2) { return i1.M_reader == i2.M_reader; }
+    friend bool operator!=(BlockIterator const& i1, BlockIterator const& i2) { return i1.M_reader != i2.M_reader; }
+};
+
+struct BlockCompare
+{
+  bool operator()(DiffBlock const& b1, DiffBlock const& b2) const { return FullName::Compare()(b1.M_block.M_full_name, b2.M_block.M_full_name); }
+};
+
+// Blocks are compared by BlockMerger, so that - (n, n) doesn't produce any output.
+struct BlockUnequal
+{
+  bool operator()(DiffBlock const&, DiffBlock const&) const { return false; }
+};
+
+// Parse block, as the only contributor of document.
+Contributions const& parse_block(DiffBlock const& block, boost::scoped_ptr<ContributionsTxt>& document) throw(ParseError)
+{
+  std::string text("\n");				// Empty header.
+  text.append(block.M_text + block.M_block.M_offset, block.M_block.M_length);
+  document.reset(new ContributionsTxt(block.M_block.M_full_name, text));
+  return document->contributors().begin()->second;
+}
+
+// Receives the blocks that are only in the old text (removed) or only in the new text (added).
+class DiffOutput
+{
+  private:
+    ContributionsDiff* M_diff;
+
+  public:
+    DiffOutput(ContributionsDiff& diff) : M_diff(&diff) { }
+
+    DiffOutput& operator*(void) { return *this; }
+    DiffOutput& operator++(void) { return *this; }
+    DiffOutput& operator=(DiffBlock const& block)
+    {
+      boost::scoped_ptr<ContributionsTxt> document;
+      Contributions const& contributions(parse_block(block, document));
+      if (block.M_new)
+	M_diff->added(block.M_block.M_full_name, contributions);
+      else
+	M_diff->removed(block.M_block.M_full_name, contributions);
+      return *this;
+    }
+};
+
+// - (n, m): the contributor is in both texts. Only parsed when its lines differ.
+class BlockMerger
+{
+  private:
+    ContributionsDiff* M_diff;
+
+  public:
+    BlockMerger(ContributionsDiff& diff) : M_diff(&diff) { }
+
+    void operator()(BlockIterator l, BlockIterator, BlockIterator r, DiffOutput&)
+    {
+      ContributorBlock const& new_block(l->M_block);
+      ContributorBlock const& old_block(r->M_block);
+      if (new_block.M_length == old_block.M_length &&
+          std::memcmp(l->M_text + new_block.M_offset, r->M_text + old_block.M_offset, new_block.M_length) == 0)
+	return;
+      boost::scoped_ptr<ContributionsTxt> old_document, new_document;
+      M_diff->changed(new_block.M_full_name, parse_block(*r, old_document), parse_block(*l, new_document));
+    }
+};
+
+std::string entry_text(ContributionEntry const& entry)
+{
+  std::ostringstream os;
+  os << entry;
+  return os.str();
+}
+
+void entries_text(Contributions const& contributions, std::vector<std::string>& entries)
+{
+  for (Contributions::contributions_type::const_iterator entry = contributions.contributions().begin();
+       entry != contributions.contributions().end(); ++entry)
+    entries.push_back(entry_text(*entry));
+}
+
+} // namespace
+
+bool ContributionsDiff::is_walkable(std::string const& text)
+{
+  TraceSpan span("check order");
+  SortedContributorBlockReader reader(text.data(), text.size());
+  ContributorBlock block;
+  while (reader.next(block))
+    ;
+  return reader.valid();
+}
+
+unsigned long ContributionsDiff::run(std::string const& old_text, std::string const& new_text) throw(ParseError)
+{
+  TraceSpan span("diff");
+  if (M_format == json)
+    M_os << "{\"contributors\": [";
+  ContributorBlockReader old_reader(old_text.data(), old_text.size());
+  ContributorBlockReader new_reader(new_text.data(), new_text.size());
+  three_way_merge(BlockIterator(new_reader, new_text.data(), true), BlockIterator(),
+                  BlockIterator(), BlockIterator(),
+                  BlockIterator(old_reader, old_text.data(), false), BlockIterator(),
+                  DiffOutput(*this), BlockMerger(*this), BlockCompare(), BlockUnequal());
+  if (M_format == json)
+    M_os << (M_differences ? "\n" : "") << "]}\n";
+  return M_differences;
+}
+
+void ContributionsDiff::added(std::string const& full_name, Contributions const& contributions)
+{
+  std::vector<std::string> entries;
+  entries_text(contributions, entries);
+  print_contributor(full_name, "added", entries, std::vector<std::string>());
+}
+
+void ContributionsDiff::removed(std::string const& full_name, Contributions const& contributions)
+{
+  std::vector<std::string> entries;
+  entries_text(contributions, entries);
+  print_contributor(full_name, "removed", std::vector<std::string>(), entries);
+}
+
+// Entries are matched by their JIRA key; an entry with another comment is removed and added again.
+void ContributionsDiff::changed(std::string const& full_name, Contributions const& old_contributions, Contributions const& new_contributions)
+{
+  FormattedContributions old_entries(old_contributions.contributions().begin(), old_contributions.contributions().end());
+  FormattedContributions new_entries(new_contributions.contributions().begin(), new_contributions.contributions().end());
+  FormattedContributions::contributions_type::const_iterator o = old_entries.contributions().begin();
+  FormattedContributions::contributions_type::const_iterator const oe = old_entries.contributions().end();
+  FormattedContributions::contributions_type::const_iterator n = new_entries.contributions().begin();
+  FormattedContributions::contributions_type::const_iterator const ne = new_entries.contributions().end();
+  std::vector<std::string> added, removed;
+  while (o != oe || n != ne)
+  {
+    if (n == ne || (o != oe && o->jira_project_key() < n->jira_project_key()))
+      removed.push_back(entry_text(*o++));
+    else if (o == oe || n->jira_project_key() < o->jira_project_key())
+      added.push_back(entry_text(*n++));
+    else
+    {
+      if (o->comment() != n->comment())
+      {
+	removed.push_back(entry_text(*o));
+	added.push_back(entry_text(*n));
+      }
+      ++o;
+      ++n;
+    }
+  }
+  // Only whitespace differed.
+  if (added.empty() && removed.empty())
+    return;
+  print_contributor(full_name, "changed", added, removed);
+}
+
+void ContributionsDiff::print_contributor(std::string const& full_name, char const* change,
+    std::vector<std::string> const& added, std::vector<std::string> const& removed)
+{
+  bool const is_changed = std::strcmp(change, "changed") == 0;
+  if (M_format == json)
+  {
+    M_os << (M_differences ? ",\n" : "\n") << "{\"name\": " << json_quote(full_name) << ", \"change\": \"" << change << '"';
+    char const* const names[2] = { "added", "removed" };
+    std::vector<std::string> const* const lists[2] = { &added, &removed };
+    for (int list = 0; list < 2; ++list)
+    {
+      if (!is_changed && lists[list]->empty())
+	continue;
+      M_os << ", \"" << (is_changed ? names[list] : "entries") << "\": [";
+      for (std::vector<std::string>::const_iterator entry = lists[list]->begin(); entry != lists[list]->end(); ++entry)
+	M_os << (entry == lists[list]->begin() ? "" : ", ") << json_quote(*entry);
+      M_os << ']';
+    }
+    M_os << '}';
+  }
+  else
+  {
+    M_os << (is_changed ? ' ' : std::strcmp(change, "added") == 0 ? '+' : '-') << full_name << '\n';
+    for (std::vector<std::string>::const_iterator entry = removed.begin(); entry != removed.end(); ++entry)
+      M_os << "-\t" << *entry << '\n';
+    for (std::vector<std::string>::const_iterator entry = added.begin(); entry != added.end(); ++entry)
+      M_os << "+\t" << *entry << '\n';
+  }
+  ++M_differences;
+}
@@ -0,0 +1,69 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ContributionsDiff.h Declaration of class ContributionsDiff.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CONTRIBUTIONSDIFF_H
+#define CONTRIBUTIONSDIFF_H
+
+#include <iosfwd>
+#include <string>
+#include <vector>
+#include "exceptions.h"
+
+class Contributions;
+
+// contribmerge --diff: print the contributors and entries that were added, removed or changed
+// from one contributions.txt to another. Only the contents count: the order of the contributors
+// and whitespace that the grammar doesn't keep are ignored, and so is the header.
+//
+// Both texts are walked once, side by side, with three_way_merge: new as left, old as right
+// and an empty base, so that - (n, -) is an added, - (-, n) a removed and - (n, m) a changed
+// contributor. Only the contributors whose lines differ are parsed, one at a time, so apart
+// from the two texts themselves the memory needed doesn't grow with the size of the inputs.
+class ContributionsDiff
+{
+  public:
+    enum format_type { text, json };
+
+  private:
+    std::ostream& M_os;
+    format_type M_format;
+    unsigned long M_differences;		// The number of contributors printed.
+
+  public:
+    ContributionsDiff(std::ostream& os, format_type format) : M_os(os), M_format(format), M_differences(0) { }
+
+    // Return true if text can be walked: a contributions.txt with every contributor once,
+    // in the order of FullName::Compare (which is how contribmerge writes it).
+    static bool is_walkable(std::string const& text);
+
+    // Print the differences from old_text to new_text, which must both be walkable.
+    // Returns the number of contributors that differ.
+    unsigned long run(std::string const& old_text, std::string const& new_text) throw(ParseError);
+
+    // Called by the walk.
+    void added(std::string const& full_name, Contributions const& contributions);
+    void removed(std::string const& full_name, Contributions const& contributions);
+    void changed(std::string const& full_name, Contributions const& old_contributions, Contributions const& new_contributions);
+
+  private:
+    void print_contributor(std::string const& full_name, char const* change,
+        std::vector<std::string> const& added, std::vector<std::string> const& removed);
+};
+
+#endif // CONTRIBUTIONSDIFF_H
@@ -0,0 +1,60 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ContributionsParser.cc Implementation of class ContributionsParser.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include "debug.h"
+#endif
+
+#include "ContributionsParser.h"
+#include "grammar_contrib.h"
+
+typedef std::string::const_iterator parse_iterator_type;
+
+struct ContributionsParser::Grammar : public grammar::contributions_txt_grammar<parse_iterator_type>
+{
+};
+
+ContributionsParser::ContributionsParser(void) : M_grammar(new Grammar)
+{
+}
+
+ContributionsParser::~ContributionsParser()
+{
+  delete M_grammar;
+}
+
+void ContributionsParser::parse(std::string const& buffer, ContributionsTxt& contributions_txt) const throw(ParseError)
+{
+  InputRange<parse_iterator_type> range(buffer.begin(), buffer.end());
+
+  bool success = boost::spirit::qi::parse(
+      range.begin(), range.end(),
+      *M_grammar,
+      contributions_txt);
+
+  if (!(success && range.empty()))
+    throw ParseError(range);
+}
+
+ContributionsParser const& ContributionsParser::instance(void)
+{
+  static ContributionsParser const parser;
+  return parser;
+}
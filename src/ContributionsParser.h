@@ -0,0 +1,54 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ContributionsParser.h Declaration of class ContributionsParser.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CONTRIBUTIONSPARSER_H
+#define CONTRIBUTIONSPARSER_H
+
+#include <string>
+#include "exceptions.h"
+
+class ContributionsTxt;
+
+// The grammar of contributions.txt, constructed once.
+//
+// Constructing the grammar allocates all of its rules; a ContributionsParser does
+// that only once and keeps no state while parsing, so that a single instance can
+// parse any number of buffers, also from several threads at the same time.
+class ContributionsParser
+{
+  private:
+    struct Grammar;
+    Grammar* M_grammar;
+
+  public:
+    ContributionsParser(void);
+    ~ContributionsParser();
+
+    // Parse buffer into contributions_txt, which must be empty.
+    void parse(std::string const& buffer, ContributionsTxt& contributions_txt) const throw(ParseError);
+
+    // The parser used by ContributionsTxt.
+    static ContributionsParser const& instance(void);
+
+  private:
+    ContributionsParser(ContributionsParser const&);
+    ContributionsParser& operator=(ContributionsParser const&);
+};
+
+#endif // CONTRIBUTIONSPARSER_H
@@ -19,29 +19,73 @@
 
 #ifndef USE_PCH
 #include "sys.h"
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
 #include <fstream>
 #include <iomanip>
+#include <sstream>
 #include "debug.h"
 #endif
 
 #include "ContributionsTxt.h"
-#include "grammar_contrib.h"
+#include "ContributionsParser.h"
 #include "ostream_operators.h"
+#include "Trace.h"
 
-ContributionsTxt::ContributionsTxt(std::string const& filename) throw(ParseError) : M_header(std::string())
+void ContributionsTxt::read_file(std::string const& filename, std::string& buffer) throw(ReadError)
 {
-  std::ifstream infile(filename.c_str());
-  typedef boost::spirit::istream_iterator parse_iterator_type;
-  InputRange<parse_iterator_type> range(static_cast<parse_iterator_type>(infile));
-  infile.unsetf(std::ios::skipws);
-
-  bool success = boost::spirit::qi::parse(
-      range.begin(), range.end(),
-      grammar::contributions_txt_grammar<parse_iterator_type>(),
-      *this);
-
-  if (!(success && range.empty()))
-    throw ParseError(range);
+  std::ifstream infile;
+  {
+    TraceSpan span("open", filename.c_str());
+    infile.open(filename.c_str(), std::ios::in | std::ios::binary);
+    if (!infile)
+      throw ReadError("Cannot read \"" + filename + "\": " + std::strerror(errno));
+  }
+  TraceSpan span("read", filename.c_str());
+  std::ostringstream contents;
+  contents << infile.rdbuf();
+  buffer = contents.str();
+}
+
+ContributionsTxt::ContributionsTxt(std::string const& filename, boost::container::pmr::memory_resource* resource) throw(ParseError, ReadError) :
+    M_arena(own_arena(resource)), M_header(std::string()), M_contributors(resource ? resource : M_arena.get())
+{
+  std::string buffer;
+  read_file(filename, buffer);
+  parse(filename, buffer);
+}
+
+ContributionsTxt::ContributionsTxt(std::string const& name, std::string const& buffer, boost::container::pmr::memory_resource* resource) throw(ParseError) :
+    M_arena(own_arena(resource)), M_header(std::string()), M_contributors(resource ? resource : M_arena.get())
+{
+  parse(name, buffer);
+}
+
+void ContributionsTxt::add_contributor(std::string const& full_name, Contributions const& contributions)
+{
+  boost::container::pmr::memory_resource* resource = contributions.resource();
+  bool shared = resource == M_contributors.get_allocator().resource();
+  for (std::vector<boost::shared_ptr<Arena> >::const_iterator arena = M_shared_arenas.begin(); !shared && arena != M_shared_arenas.end(); ++arena)
+    shared = resource == arena->get();
+  M_contributors.emplace_hint(M_contributors.end(), full_name, shared ? contributions : contributions.copy(allocator()));
+}
+
+void ContributionsTxt::share_arenas(ContributionsTxt const& ct)
+{
+  if (&ct == this)
+    return;
+  if (ct.M_arena && std::find(M_shared_arenas.begin(), M_shared_arenas.end(), ct.M_arena) == M_shared_arenas.end())
+    M_shared_arenas.push_back(ct.M_arena);
+  for (std::vector<boost::shared_ptr<Arena> >::const_iterator arena = ct.M_shared_arenas.begin(); arena != ct.M_shared_arenas.end(); ++arena)
+    if (*arena != M_arena && std::find(M_shared_arenas.begin(), M_shared_arenas.end(), *arena) == M_shared_arenas.end())
+      M_shared_arenas.push_back(*arena);
+}
+
+void ContributionsTxt::parse(std::string const& name, std::string const& buffer) throw(ParseError)
+{
+  TraceSpan span("parse", name.c_str());
+  ContributionsParser::instance().parse(buffer, *this);
 }
 
 void ContributionsTxt::print_on(std::ostream& os) const
@@ -20,36 +20,84 @@
 #ifndef CONTRIBUTIONSTXT_H
 #define CONTRIBUTIONSTXT_H
 
-#include <map>
 #include <string>
+#include <map>
+#include <vector>
+#include <boost/container/pmr/map.hpp>
+#include <boost/shared_ptr.hpp>
+#include "Arena.h"
 #include "exceptions.h"
 #include "FullName.h"
 #include "Header.h"
 
 // Grammar rule: contributions_txt.
+//
+// All contributors are allocated from a single Arena: the document's own one, unless
+// another memory resource is passed to the constructor (which must then outlive the
+// document and every document that shares its contributors; the document has no arena
+// of its own then). A copy always uses its own arena.
+//
+// The payload of a contributor (see Contributions) is shared, not copied, by a copy of
+// the document and by the result of merge(); such a document keeps the arenas of the
+// documents that it shares payloads with alive.
 class ContributionsTxt
 {
   public:
-    typedef std::map<FullName, Contributions, FullName::Compare> contributors_map;
+    typedef boost::container::pmr::map_of<FullName, Contributions, FullName::Compare>::type contributors_map;
+    typedef std::map<std::string, std::string> conflict_markers_map;
 
   private:
+    boost::shared_ptr<Arena> M_arena;					// Must be constructed before and destroyed after M_contributors. NULL if a resource was passed.
+    std::vector<boost::shared_ptr<Arena> > M_shared_arenas;		// Arenas of other documents that payloads are shared with.
     Header M_header;							// Raw header text.
     contributors_map M_contributors;					// Map of Contributors.
+    conflict_markers_map M_conflict_markers;				// Conflict markers printed instead of the contributor with that full name.
 
   public:
-    ContributionsTxt(std::string const& filename) throw(ParseError);
-    explicit ContributionsTxt(Header const& header) : M_header(header) { }
+    explicit ContributionsTxt(boost::container::pmr::memory_resource* resource = NULL) :
+        M_arena(own_arena(resource)), M_header(std::string()), M_contributors(resource ? resource : M_arena.get()) { }
+    ContributionsTxt(std::string const& filename, boost::container::pmr::memory_resource* resource = NULL) throw(ParseError, ReadError);
+    // Parse buffer, the contents of the file name.
+    ContributionsTxt(std::string const& name, std::string const& buffer, boost::container::pmr::memory_resource* resource = NULL) throw(ParseError);
+    explicit ContributionsTxt(Header const& header, boost::container::pmr::memory_resource* resource = NULL) :
+        M_arena(own_arena(resource)), M_header(header), M_contributors(resource ? resource : M_arena.get()) { }
+    ContributionsTxt(ContributionsTxt const& ct) : M_arena(new Arena), M_shared_arenas(ct.M_shared_arenas), M_header(ct.M_header),
+        M_contributors(ct.M_contributors, M_arena.get()), M_conflict_markers(ct.M_conflict_markers) { if (ct.M_arena) M_shared_arenas.push_back(ct.M_arena); }
     void print_on(std::ostream& os) const;
 
+    // Parse buffer, the contents of the file name, into this (empty) document.
+    void parse(std::string const& name, std::string const& buffer) throw(ParseError);
+
+    // Read the whole file filename into buffer. Throws ReadError if it can't be opened.
+    static void read_file(std::string const& filename, std::string& buffer) throw(ReadError);
+
+    // Add a contributor. Its payload is shared if it lives in an arena that this document
+    // keeps alive, otherwise it is copied into the arena of this document.
+    void add_contributor(std::string const& full_name, Contributions const& contributions);
+    // Add a contributor without entries and return its contributions (allocated in the arena of this document).
+    Contributions& add_contributor(std::string const& full_name)
+        { return M_contributors.emplace_hint(M_contributors.end(), full_name, Contributions())->second; }
+
+    // Keep the arenas of ct alive as long as this document, so that payloads of ct can be shared.
+    void share_arenas(ContributionsTxt const& ct);
+
+    // Remove a contributor (its memory is only given back together with the arena).
+    void erase_contributor(FullName const& full_name) { M_contributors.erase(full_name); }
+
+    // Print markers instead of the contributor full_name (see merge() with CollectConflicts).
+    void add_conflict_markers(std::string const& full_name, std::string const& markers) { M_conflict_markers[full_name] = markers; }
+
     std::insert_iterator<contributors_map> get_inserter(void) { return std::inserter<contributors_map>(M_contributors, M_contributors.begin()); }
 
     // Accessors.
+    ArenaAllocator allocator(void) const { return M_contributors.get_allocator(); }
     Header const& header(void) const { return M_header; }
     contributors_map const& contributors(void) const { return M_contributors; }
+    conflict_markers_map const& conflict_markers(void) const { return M_conflict_markers; }
 
     // Operators.
     ContributionsTxt& operator=(Header const& header) throw() { M_header = header; return *this; }
-    ContributionsTxt& operator=(ContributionsTxt const& ct) throw() { M_contributors = ct.M_contributors; return *this; }
+    ContributionsTxt& operator=(ContributionsTxt const& ct) { share_arenas(ct); M_contributors = ct.M_contributors; return *this; }
 
     friend bool operator==(ContributionsTxt const& ct, Header const& header) { return ct.M_header == header; }
     friend bool operator==(Header const& header, ContributionsTxt const& ct) { return header == ct.M_header; }
@@ -57,6 +105,11 @@ class ContributionsTxt
     friend bool operator!=(Header const& header, ContributionsTxt const& ct) { return header != ct.M_header; }
     friend bool operator==(ContributionsTxt const& ct1, ContributionsTxt const& ct2) { return ct1.M_header == ct2.M_header; }
     friend bool operator!=(ContributionsTxt const& ct1, ContributionsTxt const& ct2) { return ct1.M_header != ct2.M_header; }
+
+  private:
+    // A new arena for the document, unless the caller passed a memory resource.
+    static boost::shared_ptr<Arena> own_arena(boost::container::pmr::memory_resource* resource)
+        { return resource ? boost::shared_ptr<Arena>() : boost::shared_ptr<Arena>(new Arena); }
 };
 
 #endif // CONTRIBUTIONSTXT_H
@@ -0,0 +1,182 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ContributorBlocks.cc Implementation of split_contributor_blocks.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <cstring>
+#include "debug.h"
+#endif
+
+#include "ContributorBlocks.h"
+#include "FullName.h"
+#include "Trace.h"
+
+namespace {
+
+bool is_blank(char c) { return c == ' ' || c == '\t'; }
+bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+bool is_alnum(char c) { return is_alpha(c) || (c >= '0' && c <= '9'); }
+
+// Return the start of the line after the one starting at pos, and set end to the end of its contents.
+// The text must end on a '\n'.
+size_t next_line(char const* data, size_t size, size_t pos, size_t& end)
+{
+  size_t eol = static_cast<char const*>(std::memchr(data + pos, '\n', size - pos)) - data;
+  end = (eol > pos && data[eol - 1] == '\r') ? eol - 1 : eol;
+  return eol + 1;
+}
+
+} // namespace
+
+// Grammar rule empty_line: *blank >> eol, where [begin, end) is a line without its eol.
+bool is_empty_line(char const* begin, char const* end)
+{
+  while (begin != end && is_blank(*begin))
+    ++begin;
+  return begin == end;
+}
+
+// Grammar rule contributor_full_name >> newline: the name line of a contributor.
+// Stores the full name in full_name if [begin, end) is one.
+bool is_name_line(char const* begin, char const* end, std::string& full_name)
+{
+  char const* p = begin;
+  if (p == end || !is_alpha(*p))
+    return false;
+  while (++p != end && is_alnum(*p))
+    ;
+  full_name.assign(begin, p);
+  char const* blanks = p;
+  while (p != end && is_blank(*p))
+    ++p;
+  if (p != blanks && p != end && is_alpha(*p))
+  {
+    char const* last_name = p;
+    while (++p != end && is_alpha(*p))
+      ;
+    full_name += ' ';
+    full_name.append(last_name, p);
+    while (p != end && is_blank(*p))
+      ++p;
+  }
+  return p == end;
+}
+
+ContributorBlockReader::ContributorBlockReader(char const* data, size_t size) :
+    M_data(data), M_size(size), M_pos(0), M_header_length(0), M_valid(false), M_done(true)
+{
+  // Every line must end on "\n" or "\r\n" (eol also matches a lone '\r', which is not supported here).
+  if (size == 0 || data[size - 1] != '\n')
+    return;
+  for (char const* cr = static_cast<char const*>(std::memchr(data, '\r', size)); cr;
+       cr = static_cast<char const*>(std::memchr(cr + 1, '\r', data + size - cr - 1)))
+    if (cr[1] != '\n')
+      return;
+
+  // The header ends at the first empty line that is followed by a name line (grammar rule start).
+  std::string full_name;
+  size_t pos = 0, end;
+  while (pos < size)
+  {
+    size_t next = next_line(data, size, pos, end);
+    if (is_empty_line(data + pos, data + end) && next < size)
+    {
+      size_t name_end;
+      next_line(data, size, next, name_end);
+      if (is_name_line(data + next, data + name_end, full_name))
+      {
+	M_header_length = pos;
+	M_pos = next;
+	M_valid = true;
+	M_done = false;
+	return;
+      }
+    }
+    pos = next;
+  }
+}
+
+bool ContributorBlockReader::next(ContributorBlock& block)
+{
+  if (M_done)
+    return false;
+  // A name line starts a block and entry lines (starting with a blank) continue it.
+  size_t end;
+  size_t next = next_line(M_data, M_size, M_pos, end);
+  if (!is_name_line(M_data + M_pos, M_data + end, block.M_full_name))
+  {
+    finish();
+    return false;
+  }
+  block.M_offset = M_pos;
+  M_pos = next;
+  while (M_pos < M_size)
+  {
+    next = next_line(M_data, M_size, M_pos, end);
+    if (!is_blank(M_data[M_pos]) || is_empty_line(M_data + M_pos, M_data + end))
+      break;
+    M_pos = next;
+  }
+  block.M_length = M_pos - block.M_offset;
+  if (M_pos == M_size)
+    M_done = true;
+  return true;
+}
+
+// The line at M_pos is not a name line: it must be an empty line that ends the list, followed by empty lines only.
+void ContributorBlockReader::finish(void)
+{
+  M_done = true;
+  while (M_pos < M_size)
+  {
+    size_t end;
+    size_t next = next_line(M_data, M_size, M_pos, end);
+    if (!is_empty_line(M_data + M_pos, M_data + end))
+    {
+      M_valid = false;
+      return;
+    }
+    M_pos = next;
+  }
+}
+
+bool SortedContributorBlockReader::next(ContributorBlock& block)
+{
+  if (!M_sorted || !M_reader.next(block))
+    return false;
+  if (!M_previous.empty() && !FullName::Compare()(M_previous, block.M_full_name))
+  {
+    M_sorted = false;
+    return false;
+  }
+  M_previous = block.M_full_name;
+  return true;
+}
+
+bool split_contributor_blocks(std::string const& text, size_t& header_length, std::vector<ContributorBlock>& blocks)
+{
+  TraceSpan span("split blocks");
+  blocks.clear();
+  ContributorBlockReader reader(text.data(), text.size());
+  ContributorBlock block;
+  while (reader.next(block))
+    blocks.push_back(block);
+  header_length = reader.header_length();
+  return reader.valid();
+}
@@ -0,0 +1,94 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ContributorBlocks.h Declaration of split_contributor_blocks.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef CONTRIBUTORBLOCKS_H
+#define CONTRIBUTORBLOCKS_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+
+// The lines of one contributor in a contributions.txt: the name line and the entry lines following it.
+struct ContributorBlock
+{
+  std::string M_full_name;		// As the grammar stores it: the first name, optionally followed by a space and the last name.
+  size_t M_offset;			// Start of the name line.
+  size_t M_length;			// Up to and including the eol of the last entry line.
+};
+
+// Grammar rule empty_line: *blank >> eol, where [begin, end) is a line without its eol.
+bool is_empty_line(char const* begin, char const* end);
+
+// Grammar rule contributor_full_name >> newline: the name line of a contributor.
+// Stores the full name in full_name if [begin, end) (a line without its eol) is one.
+bool is_name_line(char const* begin, char const* end, std::string& full_name);
+
+// Reads the blocks of a contributions.txt one at a time, in the order in which they appear,
+// by looking at the start of each line only: the entries are not parsed.
+class ContributorBlockReader
+{
+  private:
+    char const* M_data;
+    size_t M_size;
+    size_t M_pos;				// Start of the next line to read.
+    size_t M_header_length;
+    bool M_valid;				// False if the text doesn't have the line structure that the grammar expects.
+    bool M_done;				// Set after the last block was read.
+
+  public:
+    // Find the header of the size bytes at data, which must stay valid while reading.
+    ContributorBlockReader(char const* data, size_t size);
+
+    // Read the next block. Returns false after the last block, or as soon as the text turns out to be invalid.
+    bool next(ContributorBlock& block);
+
+    // Accessors.
+    bool valid(void) const { return M_valid; }
+    size_t header_length(void) const { return M_header_length; }
+
+  private:
+    void finish(void);
+};
+
+// A ContributorBlockReader that also checks that the contributors are in the order of FullName::Compare,
+// which is how contribmerge writes them and what is needed to walk them side by side with another sorted list.
+class SortedContributorBlockReader
+{
+  private:
+    ContributorBlockReader M_reader;
+    std::string M_previous;			// The full name of the last block read.
+    bool M_sorted;
+
+  public:
+    SortedContributorBlockReader(char const* data, size_t size) : M_reader(data, size), M_sorted(true) { }
+
+    // Read the next block. Also returns false as soon as a block is out of order.
+    bool next(ContributorBlock& block);
+
+    // Accessors.
+    bool valid(void) const { return M_sorted && M_reader.valid(); }
+    size_t header_length(void) const { return M_reader.header_length(); }
+};
+
+// Split text, a contributions.txt, into its header (the first header_length bytes) and one block per contributor,
+// in the order in which they appear (see ContributorBlockReader).
+// Returns false if text doesn't have the line structure that the grammar expects.
+bool split_contributor_blocks(std::string const& text, size_t& header_length, std::vector<ContributorBlock>& blocks);
+
+#endif // CONTRIBUTORBLOCKS_H
@@ -0,0 +1,35 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file DiscardIterator.h Declaration of DiscardIterator.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DISCARDITERATOR_H
+#define DISCARDITERATOR_H
+
+#include <iterator>
+
+// Output iterator that throws away everything that is written to it.
+struct DiscardIterator : public std::iterator<std::output_iterator_tag, void, void, void, void>
+{
+  template<typename T>
+    DiscardIterator& operator=(T const&) { return *this; }
+  DiscardIterator& operator*(void) { return *this; }
+  DiscardIterator& operator++(void) { return *this; }
+  DiscardIterator& operator++(int) { return *this; }
+};
+
+#endif // DISCARDITERATOR_H
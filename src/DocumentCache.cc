@@ -0,0 +1,83 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file DocumentCache.cc Implementation of class DocumentCache.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include "debug.h"
+#endif
+
+#include "DocumentCache.h"
+#include "Trace.h"
+
+DocumentCache::document_ptr DocumentCache::get(GitRepository::ObjectId const& blob_id) throw(GitError, ParseError)
+{
+  {
+    boost::mutex::scoped_lock lock(M_mutex);
+    for (;;)
+    {
+      entries_map::iterator entry = M_entries.find(blob_id);
+      if (entry != M_entries.end())
+      {
+	++M_hits;
+	M_lru.splice(M_lru.begin(), M_lru, entry->second.M_lru);
+	return entry->second.M_document;
+      }
+      if (M_loading.find(blob_id) == M_loading.end())
+	break;
+      // Another thread is parsing this blob; wait for it instead of doing it twice.
+      M_loaded.wait(lock);
+    }
+    M_loading.insert(blob_id);
+    ++M_misses;
+  }
+
+  // Read and parse without holding the lock.
+  document_ptr document;
+  try
+  {
+    std::string const name(GitRepository::to_hex(blob_id));
+    TraceSpan span("load blob", name.c_str());
+    std::string buffer;
+    if (M_repository.read_object(blob_id, buffer) != GitRepository::blob)
+      throw GitError("Not a blob: " + name);
+    document.reset(new ContributionsTxt(name, buffer));
+  }
+  catch (...)
+  {
+    boost::mutex::scoped_lock lock(M_mutex);
+    M_loading.erase(blob_id);
+    M_loaded.notify_all();
+    throw;
+  }
+
+  boost::mutex::scoped_lock lock(M_mutex);
+  M_loading.erase(blob_id);
+  M_lru.push_front(blob_id);
+  Entry& entry(M_entries[blob_id]);
+  entry.M_document = document;
+  entry.M_lru = M_lru.begin();
+  while (M_entries.size() > M_capacity)
+  {
+    M_entries.erase(M_lru.back());
+    M_lru.pop_back();
+    ++M_evictions;
+  }
+  M_loaded.notify_all();
+  return document;
+}
@@ -0,0 +1,77 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file DocumentCache.h Declaration of class DocumentCache.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef DOCUMENTCACHE_H
+#define DOCUMENTCACHE_H
+
+#include <list>
+#include <map>
+#include <set>
+#include <boost/shared_ptr.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include "ContributionsTxt.h"
+#include "GitRepository.h"
+
+// A thread-safe LRU cache of parsed documents, keyed by git blob name (the SHA-1 of the content).
+//
+// Each blob is read and parsed at most once while it is in the cache, also when several
+// threads ask for it at the same time. Evicted documents stay alive as long as they are used.
+class DocumentCache
+{
+  public:
+    typedef boost::shared_ptr<ContributionsTxt const> document_ptr;
+
+  private:
+    typedef std::list<GitRepository::ObjectId> lru_list;		// Most recently used first.
+    struct Entry {
+      document_ptr M_document;
+      lru_list::iterator M_lru;
+    };
+    typedef std::map<GitRepository::ObjectId, Entry> entries_map;
+
+    GitRepository const& M_repository;
+    size_t M_capacity;
+    boost::mutex M_mutex;						// Protects everything below.
+    boost::condition_variable M_loaded;					// Notified when a blob is done loading.
+    entries_map M_entries;
+    lru_list M_lru;
+    std::set<GitRepository::ObjectId> M_loading;			// Blobs that are being read and parsed right now.
+    unsigned long M_hits;
+    unsigned long M_misses;
+    unsigned long M_evictions;
+
+  public:
+    DocumentCache(GitRepository const& repository, size_t capacity) :
+        M_repository(repository), M_capacity(capacity), M_hits(0), M_misses(0), M_evictions(0) { }
+
+    // Return the parsed blob blob_id.
+    document_ptr get(GitRepository::ObjectId const& blob_id) throw(GitError, ParseError);
+
+    // Accessors.
+    unsigned long hits(void) const { return M_hits; }
+    unsigned long misses(void) const { return M_misses; }
+    unsigned long evictions(void) const { return M_evictions; }
+
+  private:
+    DocumentCache(DocumentCache const&);
+    DocumentCache& operator=(DocumentCache const&);
+};
+
+#endif // DOCUMENTCACHE_H
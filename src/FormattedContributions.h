@@ -20,7 +20,6 @@
 #ifndef FORMATTEDCONTRIBUTIONS_H
 #define FORMATTEDCONTRIBUTIONS_H
 
-#include <vector>
 #include <set>
 #include <iterator>
 #include "ContributionEntry.h"
@@ -40,7 +39,8 @@ class FormattedContributions
 
   public:
     FormattedContributions(void) { }
-    FormattedContributions(std::vector<ContributionEntry> const& vec);
+    template<class InputIterator>
+      FormattedContributions(InputIterator first, InputIterator last) : M_contributions(first, last) { }
 
     std::insert_iterator<contributions_type> get_inserter(void) { return std::inserter(M_contributions, M_contributions.begin()); }
 
@@ -20,21 +20,48 @@
 #ifndef USE_PCH
 #include "sys.h"
 #include <algorithm>
+#include <cctype>
 #include "debug.h"
 #endif
 
 #include "FullName.h"
-#include <boost/algorithm/string/predicate.hpp>
 
-bool FullName::Compare::operator()(FullName const& name1, FullName const& name2) const
+namespace {
+
+// boost::ilexicographical_compare in both directions at once, without its std::locale lookup per character.
+// Full names only consist of ASCII letters, digits and spaces (see the grammar) and the locale is never changed.
+int icompare(char const* s1, size_t size1, char const* s2, size_t size2)
+{
+  for (size_t i = 0; i < size1 && i < size2; ++i)
+  {
+    int c1 = std::toupper(static_cast<unsigned char>(s1[i]));
+    int c2 = std::toupper(static_cast<unsigned char>(s2[i]));
+    if (c1 != c2)
+      return c1 < c2 ? -1 : 1;
+  }
+  return size1 < size2 ? -1 : size1 > size2 ? 1 : 0;
+}
+
+// Case insensitive, and case sensitive between names that only differ in case.
+template<class String>
+bool less(String const& n1, String const& n2)
 {
-  std::string const& n1(name1.M_full_name);
-  std::string const& n2(name2.M_full_name);
   if (n1 == n2)
     return false;
-  if (boost::ilexicographical_compare(n1, n2))
-    return true;
-  if (boost::ilexicographical_compare(n2, n1))
-    return false;
-  return boost::lexicographical_compare(n1, n2);
+  int result = icompare(n1.data(), n1.size(), n2.data(), n2.size());
+  if (result != 0)
+    return result < 0;
+  return n1 < n2;
+}
+
+} // namespace
+
+bool FullName::Compare::operator()(FullName const& name1, FullName const& name2) const
+{
+  return less(name1.M_full_name, name2.M_full_name);
+}
+
+bool FullName::Compare::operator()(std::string const& name1, std::string const& name2) const
+{
+  return less(name1, name2);
 }
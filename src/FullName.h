@@ -23,21 +23,23 @@
 #include <utility>
 #include <string>
 #include "Contributions.h"
+#include "InternedString.h"
 
 class FullName;
 
 typedef std::pair<FullName const, Contributions> Contributor;
 
+// The full name is interned: equal names of different documents compare equal by pointer.
 class FullName
 {
   private:
-    std::string M_full_name;						// Firstname[ Lastname].
+    InternedString M_full_name;						// Firstname[ Lastname].
 
   public:
     FullName(std::string const& full_name) : M_full_name(full_name) { }
 
     // Accessors.
-    std::string const& full_name(void) const { return M_full_name; }
+    InternedString const& full_name(void) const { return M_full_name; }
 
   public:
     friend bool operator==(FullName const& name1, FullName const& name2) { return name1.M_full_name == name2.M_full_name; }
@@ -46,6 +48,8 @@ class FullName
     struct Compare {
       bool operator()(FullName const& name1, FullName const& name2) const;
       bool operator()(Contributor const& name1, Contributor const& name2) const { return operator()(name1.first, name2.first); }
+      // Compare full names that are not (yet) interned, in the same order.
+      bool operator()(std::string const& name1, std::string const& name2) const;
     };
 };
 
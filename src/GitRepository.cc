@@ -0,0 +1,630 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file GitRepository.cc Implementation of class GitRepository.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <unistd.h>
+#include "debug.h"
+#endif
+
+#include "GitRepository.h"
+#include "ContentHash.h"
+#include <climits>
+#include <limits>
+#include <fcntl.h>
+#include <dirent.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+namespace {
+
+bool is_directory(std::string const& path)
+{
+  struct stat buf;
+  return stat(path.c_str(), &buf) == 0 && S_ISDIR(buf.st_mode);
+}
+
+// Read the regular file filename into contents. Returns false if it doesn't exist.
+bool read_whole_file(std::string const& filename, std::string& contents)
+{
+  struct stat buf;
+  if (stat(filename.c_str(), &buf) != 0 || !S_ISREG(buf.st_mode))
+    return false;
+  std::ifstream infile(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!infile)
+    return false;
+  std::ostringstream stream;
+  stream << infile.rdbuf();
+  contents = stream.str();
+  return true;
+}
+
+std::string trim(std::string const& str)
+{
+  std::string::size_type end = str.find_last_not_of(" \t\r\n");
+  return end == std::string::npos ? std::string() : str.substr(0, end + 1);
+}
+
+bool map_file(std::string const& filename, unsigned char const*& data, size_t& size)
+{
+  int fd = open(filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+  struct stat buf;
+  void* addr = MAP_FAILED;
+  if (fstat(fd, &buf) == 0 && buf.st_size > 0)
+    addr = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    return false;
+  data = static_cast<unsigned char const*>(addr);
+  size = buf.st_size;
+  return true;
+}
+
+uint32_t get_be32(unsigned char const* p)
+{
+  return (uint32_t)p[0] << 24 | (uint32_t)p[1] << 16 | (uint32_t)p[2] << 8 | p[3];
+}
+
+bool parse_hex(std::string const& hex, GitRepository::ObjectId& id)
+{
+  if (hex.size() != 40)
+    return false;
+  id.resize(20);
+  for (int i = 0; i < 40; ++i)
+  {
+    char c = hex[i];
+    int nibble;
+    if (c >= '0' && c <= '9')
+      nibble = c - '0';
+    else if (c >= 'a' && c <= 'f')
+      nibble = c - 'a' + 10;
+    else if (c >= 'A' && c <= 'F')
+      nibble = c - 'A' + 10;
+    else
+      return false;
+    if (i % 2 == 0)
+      id[i / 2] = nibble << 4;
+    else
+      id[i / 2] |= nibble;
+  }
+  return true;
+}
+
+// Inflate the zlib stream at in into out. If expected_size is not -1 then
+// the result must be exactly that large.
+void inflate_data(unsigned char const* in, size_t in_size, std::string& out, size_t expected_size) throw(GitError)
+{
+  z_stream stream;
+  std::memset(&stream, 0, sizeof(stream));
+  if (inflateInit(&stream) != Z_OK)
+    throw GitError("inflateInit failed");
+  stream.next_in = const_cast<Bytef*>(in);
+  stream.avail_in = in_size > UINT_MAX ? UINT_MAX : in_size;
+  out.resize(expected_size == (size_t)-1 ? 4 * in_size + 64 : expected_size + 1);
+  int ret;
+  do
+  {
+    if (stream.total_out == out.size())
+      out.resize(2 * out.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&out[stream.total_out]);
+    stream.avail_out = out.size() - stream.total_out;
+    ret = inflate(&stream, Z_NO_FLUSH);
+  }
+  while (ret == Z_OK);
+  size_t total_out = stream.total_out;
+  inflateEnd(&stream);
+  if (ret != Z_STREAM_END || (expected_size != (size_t)-1 && total_out != expected_size))
+    throw GitError("Corrupt zlib data in git object");
+  out.resize(total_out);
+}
+
+size_t delta_header_size(std::string const& delta, size_t& pos) throw(GitError)
+{
+  size_t size = 0;
+  int shift = 0;
+  unsigned char c;
+  do
+  {
+    if (pos >= delta.size())
+      throw GitError("Corrupt delta in pack");
+    c = delta[pos++];
+    if (shift >= std::numeric_limits<size_t>::digits)
+      throw GitError("Corrupt delta in pack");
+    size |= (size_t)(c & 0x7f) << shift;
+    shift += 7;
+  }
+  while (c & 0x80);
+  return size;
+}
+
+void apply_delta(std::string const& base, std::string const& delta, std::string& out) throw(GitError)
+{
+  size_t pos = 0;
+  size_t base_size = delta_header_size(delta, pos);
+  size_t result_size = delta_header_size(delta, pos);
+  if (base_size != base.size())
+    throw GitError("Delta base size mismatch in pack");
+  out.clear();
+  out.reserve(result_size);
+  while (pos < delta.size())
+  {
+    unsigned char op = delta[pos++];
+    if (op & 0x80)
+    {
+      // Copy from base.
+      size_t offset = 0, size = 0;
+      for (int i = 0; i < 4; ++i)
+	if (op & (1 << i))
+	{
+	  if (pos >= delta.size())
+	    throw GitError("Corrupt delta in pack");
+	  offset |= (size_t)(unsigned char)delta[pos++] << (8 * i);
+	}
+      for (int i = 0; i < 3; ++i)
+	if (op & (0x10 << i))
+	{
+	  if (pos >= delta.size())
+	    throw GitError("Corrupt delta in pack");
+	  size |= (size_t)(unsigned char)delta[pos++] << (8 * i);
+	}
+      if (size == 0)
+	size = 0x10000;
+      if (offset + size > base.size())
+	throw GitError("Corrupt delta in pack");
+      out.append(base, offset, size);
+    }
+    else if (op)
+    {
+      // Insert literal data.
+      if (pos + op > delta.size())
+	throw GitError("Corrupt delta in pack");
+      out.append(delta, pos, op);
+      pos += op;
+    }
+    else
+      throw GitError("Corrupt delta in pack");
+  }
+  if (out.size() != result_size)
+    throw GitError("Delta result size mismatch in pack");
+}
+
+char const* type_name(GitRepository::object_type type)
+{
+  switch (type)
+  {
+    case GitRepository::commit:
+      return "commit";
+    case GitRepository::tree:
+      return "tree";
+    case GitRepository::blob:
+      return "blob";
+    case GitRepository::tag:
+      return "tag";
+    default:
+      return "object";
+  }
+}
+
+// Pack index version 2: magic and version, 256 fanout entries, then per object
+// a SHA-1, a CRC32 and a 31-bit offset, followed by the 64-bit offsets.
+size_t const index_header_size = 8 + 256 * 4;
+
+// Return true if index is a version 2 pack index that is large enough for the
+// number of objects it claims to have, and whose fanout table never decreases
+// (so that no fanout entry exceeds that number and every binary search stays
+// within the table of names).
+bool valid_index(unsigned char const* index, size_t index_size)
+{
+  if (index_size < index_header_size || get_be32(index) != 0xff744f63 || get_be32(index + 4) != 2)
+    return false;
+  unsigned char const* fanout = index + 8;
+  uint32_t previous = 0;
+  for (int i = 0; i < 256; ++i)
+  {
+    uint32_t entry = get_be32(fanout + 4 * i);
+    if (entry < previous)
+      return false;
+    previous = entry;
+  }
+  return index_size >= index_header_size + 28 * (size_t)previous;
+}
+
+} // namespace
+
+GitRepository::GitRepository(std::string const& path) throw(GitError)
+{
+  std::string contents;
+  if (is_directory(path + "/.git"))
+    M_git_dir = path + "/.git";
+  else if (read_whole_file(path + "/.git", contents) && contents.compare(0, 8, "gitdir: ") == 0)
+  {
+    // A linked work tree or submodule.
+    std::string dir(trim(contents.substr(8)));
+    M_git_dir = dir[0] == '/' ? dir : path + '/' + dir;
+  }
+  else if (is_directory(path + "/objects") && read_whole_file(path + "/HEAD", contents))
+    M_git_dir = path;
+  else
+    throw GitError("Not a git repository: " + path);
+
+  M_common_dir = M_git_dir;
+  if (read_whole_file(M_git_dir + "/commondir", contents))
+  {
+    std::string dir(trim(contents));
+    M_common_dir = dir[0] == '/' ? dir : M_git_dir + '/' + dir;
+  }
+
+  std::string pack_dir(M_common_dir + "/objects/pack");
+  DIR* dir = opendir(pack_dir.c_str());
+  if (!dir)
+    return;
+  struct dirent* entry;
+  while ((entry = readdir(dir)))
+  {
+    std::string name(entry->d_name);
+    if (name.size() <= 4 || name.compare(name.size() - 4, 4, ".idx") != 0)
+      continue;
+    Pack pack;
+    pack.M_filename = pack_dir + '/' + name.substr(0, name.size() - 4) + ".pack";
+    if (!map_file(pack_dir + '/' + name, pack.M_index, pack.M_index_size))
+      continue;
+    if (!map_file(pack.M_filename, pack.M_data, pack.M_data_size))
+    {
+      munmap(const_cast<unsigned char*>(pack.M_index), pack.M_index_size);
+      continue;
+    }
+    // Ignore what we can't read; the objects in it will not be found.
+    if (!valid_index(pack.M_index, pack.M_index_size))
+    {
+      munmap(const_cast<unsigned char*>(pack.M_index), pack.M_index_size);
+      munmap(const_cast<unsigned char*>(pack.M_data), pack.M_data_size);
+      continue;
+    }
+    M_packs.push_back(pack);
+  }
+  closedir(dir);
+}
+
+GitRepository::~GitRepository()
+{
+  for (std::vector<Pack>::iterator pack = M_packs.begin(); pack != M_packs.end(); ++pack)
+  {
+    munmap(const_cast<unsigned char*>(pack->M_index), pack->M_index_size);
+    munmap(const_cast<unsigned char*>(pack->M_data), pack->M_data_size);
+  }
+}
+
+std::string GitRepository::to_hex(ObjectId const& id)
+{
+  return ::to_hex(id);
+}
+
+void GitRepository::read_blob(std::string const& spec, std::string& buffer) const throw(GitError)
+{
+  if (read_object(blob_id(spec), buffer) != blob)
+    throw GitError("Not a blob: " + spec);
+}
+
+GitRepository::ObjectId GitRepository::blob_id(std::string const& spec) const throw(GitError)
+{
+  std::string::size_type colon = spec.find(':');
+  if (colon == std::string::npos)
+    return resolve(spec);
+
+  ObjectId id(peel(resolve(spec.substr(0, colon)), tree));
+  std::string path(spec.substr(colon + 1));
+  std::string data;
+  std::string::size_type start = 0;
+  while (start < path.size())
+  {
+    std::string::size_type slash = path.find('/', start);
+    if (slash == std::string::npos)
+      slash = path.size();
+    std::string component(path, start, slash - start);
+    start = slash + 1;
+    if (component.empty())
+      continue;
+    if (read_object(id, data) != tree)
+      throw GitError("Not a directory in " + spec + ": " + path.substr(0, slash));
+    // Tree entries are "<mode> <name>\0<20 byte SHA-1>".
+    std::string::size_type pos = 0;
+    bool found = false;
+    while (pos < data.size())
+    {
+      std::string::size_type space = data.find(' ', pos);
+      std::string::size_type nul = data.find('\0', space);
+      if (space == std::string::npos || nul == std::string::npos || nul + 21 > data.size())
+	throw GitError("Corrupt tree object " + to_hex(id));
+      if (data.compare(space + 1, nul - space - 1, component) == 0)
+      {
+	id.assign(data, nul + 1, 20);
+	found = true;
+	break;
+      }
+      pos = nul + 21;
+    }
+    if (!found)
+      throw GitError("Path not found: " + spec);
+  }
+  return id;
+}
+
+GitRepository::ObjectId GitRepository::resolve(std::string const& rev) const throw(GitError)
+{
+  std::string::size_type suffix = rev.find_first_of("^~");
+  std::string name(rev, 0, suffix);
+  ObjectId id;
+  if (!parse_hex(name, id))
+  {
+    // The same search order as git rev-parse.
+    static char const* const prefixes[] = { "", "refs/", "refs/tags/", "refs/heads/", "refs/remotes/" };
+    bool found = false;
+    for (size_t i = 0; !found && i < sizeof(prefixes) / sizeof(prefixes[0]); ++i)
+      found = read_ref(prefixes[i] + name, id);
+    if (!found && !read_ref("refs/remotes/" + name + "/HEAD", id))
+      throw GitError("Unknown revision: " + name);
+  }
+  while (suffix < rev.size())
+  {
+    char op = rev[suffix++];
+    if (op != '^' && op != '~')
+      throw GitError("Unknown revision: " + rev);
+    std::string::size_type end = rev.find_first_not_of("0123456789", suffix);
+    if (end == std::string::npos)
+      end = rev.size();
+    unsigned int n = end == suffix ? 1 : std::atoi(rev.substr(suffix, end - suffix).c_str());
+    if (op == '^')
+      id = parent(id, n);
+    else
+      while (n--)
+	id = parent(id, 1);
+    suffix = end;
+  }
+  return id;
+}
+
+GitRepository::object_type GitRepository::read_object(ObjectId const& id, std::string& data, int depth) const throw(GitError)
+{
+  object_type type;
+  if (read_loose_object(id, type, data))
+    return type;
+  Pack const* pack;
+  size_t offset;
+  if (find_packed_object(id, pack, offset))
+    return read_packed_object(*pack, offset, data, depth);
+  throw GitError("Object not found: " + to_hex(id));
+}
+
+bool GitRepository::read_loose_object(ObjectId const& id, object_type& type, std::string& data) const throw(GitError)
+{
+  std::string hex(to_hex(id));
+  std::string compressed;
+  if (!read_whole_file(M_common_dir + "/objects/" + hex.substr(0, 2) + '/' + hex.substr(2), compressed))
+    return false;
+  std::string raw;
+  inflate_data(reinterpret_cast<unsigned char const*>(compressed.data()), compressed.size(), raw, (size_t)-1);
+  // The header is "<type> <size>\0", where size is the decimal length of what follows.
+  std::string::size_type space = raw.find(' ');
+  std::string::size_type nul = raw.find('\0');
+  if (space == std::string::npos || nul == std::string::npos || space > nul)
+    throw GitError("Corrupt loose object " + hex);
+  std::string::size_type const digits = nul - space - 1;
+  if (digits == 0 || digits > 19 || (digits > 1 && raw[space + 1] == '0') ||
+      raw.find_first_not_of("0123456789", space + 1) != nul)
+    throw GitError("Corrupt loose object " + hex);
+  unsigned long long declared_size = 0;
+  for (std::string::size_type i = space + 1; i < nul; ++i)
+    declared_size = 10 * declared_size + (raw[i] - '0');
+  if (declared_size != raw.size() - nul - 1)
+    throw GitError("Corrupt loose object " + hex);
+  std::string type_str(raw, 0, space);
+  if (type_str == "commit")
+    type = commit;
+  else if (type_str == "tree")
+    type = tree;
+  else if (type_str == "blob")
+    type = blob;
+  else if (type_str == "tag")
+    type = tag;
+  else
+    throw GitError("Corrupt loose object " + hex);
+  data.assign(raw, nul + 1, std::string::npos);
+  return true;
+}
+
+bool GitRepository::find_packed_object(ObjectId const& id, Pack const*& pack_out, size_t& offset) const
+{
+  unsigned char const* sha = reinterpret_cast<unsigned char const*>(id.data());
+  for (std::vector<Pack>::const_iterator pack = M_packs.begin(); pack != M_packs.end(); ++pack)
+  {
+    unsigned char const* fanout = pack->M_index + 8;
+    uint32_t const count = get_be32(fanout + 255 * 4);
+    uint32_t first = sha[0] ? get_be32(fanout + (sha[0] - 1) * 4) : 0;
+    uint32_t last = get_be32(fanout + sha[0] * 4);
+    unsigned char const* names = pack->M_index + index_header_size;
+    while (first < last)
+    {
+      uint32_t middle = first + (last - first) / 2;
+      int cmp = std::memcmp(names + 20 * (size_t)middle, sha, 20);
+      if (cmp < 0)
+	first = middle + 1;
+      else if (cmp > 0)
+	last = middle;
+      else
+      {
+	unsigned char const* offsets = names + 24 * (size_t)count;
+	uint32_t offset32 = get_be32(offsets + 4 * (size_t)middle);
+	if (offset32 & 0x80000000)
+	{
+	  unsigned char const* large_offset = offsets + 4 * (size_t)count + 8 * (size_t)(offset32 & 0x7fffffff);
+	  if (large_offset + 8 > pack->M_index + pack->M_index_size)
+	    return false;
+	  offset = (size_t)((uint64_t)get_be32(large_offset) << 32 | get_be32(large_offset + 4));
+	}
+	else
+	  offset = offset32;
+	pack_out = &*pack;
+	return true;
+      }
+    }
+  }
+  return false;
+}
+
+GitRepository::object_type GitRepository::read_packed_object(Pack const& pack, size_t offset, std::string& data, int depth) const throw(GitError)
+{
+  unsigned char const* const end = pack.M_data + pack.M_data_size;
+  // A delta chain longer than git ever writes (pack-objects' maximum --depth) is a cycle.
+  if (offset >= pack.M_data_size || depth > 4095)
+    throw GitError("Corrupt pack " + pack.M_filename);
+  unsigned char const* p = pack.M_data + offset;
+
+  // Object header: type and inflated size.
+  unsigned char c = *p++;
+  object_type type = static_cast<object_type>((c >> 4) & 7);
+  size_t size = c & 15;
+  int shift = 4;
+  while (c & 0x80)
+  {
+    if (p == end)
+      throw GitError("Corrupt pack " + pack.M_filename);
+    c = *p++;
+    if (shift >= std::numeric_limits<size_t>::digits)
+      throw GitError("Corrupt pack " + pack.M_filename);
+    size |= (size_t)(c & 0x7f) << shift;
+    shift += 7;
+  }
+
+  switch (type)
+  {
+    case commit:
+    case tree:
+    case blob:
+    case tag:
+      inflate_data(p, end - p, data, size);
+      return type;
+    case ofs_delta:
+    case ref_delta:
+    {
+      std::string base;
+      object_type base_type;
+      if (type == ofs_delta)
+      {
+	// The base is at a negative offset within the same pack.
+	if (p == end)
+	  throw GitError("Corrupt pack " + pack.M_filename);
+	c = *p++;
+	size_t distance = c & 0x7f;
+	while (c & 0x80)
+	{
+	  if (p == end || distance >= (std::numeric_limits<size_t>::max() >> 7))
+	    throw GitError("Corrupt pack " + pack.M_filename);
+	  c = *p++;
+	  distance = ((distance + 1) << 7) | (c & 0x7f);
+	}
+	if (distance == 0 || distance > offset)
+	  throw GitError("Corrupt pack " + pack.M_filename);
+	base_type = read_packed_object(pack, offset - distance, base, depth + 1);
+      }
+      else
+      {
+	if (end - p < 20)
+	  throw GitError("Corrupt pack " + pack.M_filename);
+	base_type = read_object(ObjectId(reinterpret_cast<char const*>(p), 20), base, depth + 1);
+	p += 20;
+      }
+      std::string delta;
+      inflate_data(p, end - p, delta, size);
+      apply_delta(base, delta, data);
+      return base_type;
+    }
+    default:
+      throw GitError("Corrupt pack " + pack.M_filename);
+  }
+}
+
+bool GitRepository::read_ref(std::string const& name, ObjectId& id, int depth) const throw(GitError)
+{
+  if (depth > 5)
+    throw GitError("Too many levels of symbolic refs: " + name);
+
+  // Per work tree refs (HEAD, MERGE_HEAD, ...) are in the git dir, the rest in the common dir.
+  std::string contents;
+  if (read_whole_file(M_git_dir + '/' + name, contents) ||
+      (M_common_dir != M_git_dir && read_whole_file(M_common_dir + '/' + name, contents)))
+  {
+    if (contents.compare(0, 5, "ref: ") == 0)
+      return read_ref(trim(contents.substr(5)), id, depth + 1);
+    return parse_hex(trim(contents).substr(0, 40), id);
+  }
+
+  // Lines of packed-refs are "<SHA-1> <refname>", or comments and "^<SHA-1>" peeled tags.
+  if (!read_whole_file(M_common_dir + "/packed-refs", contents))
+    return false;
+  std::istringstream lines(contents);
+  std::string line;
+  while (std::getline(lines, line))
+  {
+    if (line.size() > 41 && line[40] == ' ' && trim(line.substr(41)) == name)
+      return parse_hex(line.substr(0, 40), id);
+  }
+  return false;
+}
+
+GitRepository::ObjectId GitRepository::peel(ObjectId id, object_type wanted) const throw(GitError)
+{
+  std::string data;
+  for (;;)
+  {
+    object_type type = read_object(id, data);
+    if (type == wanted)
+      return id;
+    // Both tags and commits start with the line "object <SHA-1>" respectively "tree <SHA-1>".
+    if (type == tag && data.compare(0, 7, "object ") == 0 && parse_hex(data.substr(7, 40), id))
+      continue;
+    if (type == commit && wanted == tree && data.compare(0, 5, "tree ") == 0 && parse_hex(data.substr(5, 40), id))
+      continue;
+    throw GitError(to_hex(id) + " is a " + type_name(type) + ", not a " + type_name(wanted));
+  }
+}
+
+GitRepository::ObjectId GitRepository::parent(ObjectId const& id, unsigned int n) const throw(GitError)
+{
+  ObjectId commit_id(peel(id, commit));
+  if (n == 0)
+    return commit_id;
+  std::string data;
+  read_object(commit_id, data);
+  std::istringstream lines(data);
+  std::string line;
+  ObjectId parent_id;
+  // The header of a commit ends at the first empty line.
+  while (std::getline(lines, line) && !line.empty())
+    if (line.compare(0, 7, "parent ") == 0 && --n == 0 && parse_hex(line.substr(7, 40), parent_id))
+      return parent_id;
+  throw GitError("Commit " + to_hex(commit_id) + " has no such parent");
+}
@@ -0,0 +1,91 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file GitRepository.h Declaration of class GitRepository.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef GITREPOSITORY_H
+#define GITREPOSITORY_H
+
+#include <string>
+#include <vector>
+#include <stddef.h>
+#include "exceptions.h"
+
+// Read-only access to the object database of a local git repository, without running git.
+//
+// Supports loose objects, packfiles (index version 2, including OFS_DELTA and REF_DELTA
+// objects), refs, packed-refs and symbolic refs. A revision is a (full) object name, a
+// ref name like HEAD, master or tags/v1.0, optionally followed by any number of ^[N] and ~[N].
+class GitRepository
+{
+  public:
+    typedef std::string ObjectId;			// 20 byte binary SHA-1.
+
+    enum object_type {
+      none = 0,
+      commit = 1,
+      tree = 2,
+      blob = 3,
+      tag = 4,
+      ofs_delta = 6,
+      ref_delta = 7
+    };
+
+  private:
+    // A memory mapped pack file and its index.
+    struct Pack {
+      std::string M_filename;
+      unsigned char const* M_index;
+      size_t M_index_size;
+      unsigned char const* M_data;
+      size_t M_data_size;
+    };
+
+    std::string M_git_dir;				// Where HEAD is.
+    std::string M_common_dir;				// Where objects and refs are (differs from M_git_dir for linked worktrees).
+    std::vector<Pack> M_packs;
+
+  public:
+    // path is a work tree, the .git directory or a bare repository.
+    explicit GitRepository(std::string const& path) throw(GitError);
+    ~GitRepository();
+
+    // The object name of the blob spec, which is <rev>:<path> or the name of a blob.
+    ObjectId blob_id(std::string const& spec) const throw(GitError);
+    // Read the blob named by spec, see blob_id, into buffer.
+    void read_blob(std::string const& spec, std::string& buffer) const throw(GitError);
+
+    ObjectId resolve(std::string const& rev) const throw(GitError);
+    // Depth is the number of deltas that need this object as base, if any.
+    object_type read_object(ObjectId const& id, std::string& data, int depth = 0) const throw(GitError);
+
+    static std::string to_hex(ObjectId const& id);
+
+  private:
+    bool read_loose_object(ObjectId const& id, object_type& type, std::string& data) const throw(GitError);
+    bool find_packed_object(ObjectId const& id, Pack const*& pack, size_t& offset) const;
+    object_type read_packed_object(Pack const& pack, size_t offset, std::string& data, int depth = 0) const throw(GitError);
+    bool read_ref(std::string const& name, ObjectId& id, int depth = 0) const throw(GitError);
+    ObjectId peel(ObjectId id, object_type wanted) const throw(GitError);
+    ObjectId parent(ObjectId const& id, unsigned int n) const throw(GitError);
+
+  private:
+    GitRepository(GitRepository const&);
+    GitRepository& operator=(GitRepository const&);
+};
+
+#endif // GITREPOSITORY_H
@@ -0,0 +1,170 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file InputWatcher.cc Implementation of class InputWatcher.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <cerrno>
+#include <cstring>
+#include <unistd.h>
+#include "debug.h"
+#endif
+
+#include "InputWatcher.h"
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#endif
+
+namespace {
+
+// How long to wait for more changes after the first one, in milliseconds.
+int const quiet_period = 50;
+
+} // namespace
+
+volatile sig_atomic_t InputWatcher::S_interrupted = 0;
+
+void InputWatcher::interrupt(int)
+{
+  S_interrupted = 1;
+}
+
+InputWatcher::InputWatcher(void) : M_fd(-1), M_stop_on_interrupt(false)
+{
+#ifdef __linux__
+  M_fd = inotify_init();
+  if (M_fd == -1)
+    M_error = std::string("inotify_init: ") + std::strerror(errno);
+#else
+  M_error = "inotify is only available on Linux";
+#endif
+}
+
+InputWatcher::~InputWatcher()
+{
+  if (M_fd != -1)
+    close(M_fd);
+}
+
+bool InputWatcher::add(std::string const& filename)
+{
+  if (M_fd == -1)
+    return false;
+#ifdef __linux__
+  std::string::size_type slash = filename.rfind('/');
+  std::string const directory(slash == std::string::npos ? std::string(".") : slash == 0 ? std::string("/") : filename.substr(0, slash));
+  std::string const name(slash == std::string::npos ? filename : filename.substr(slash + 1));
+  int wd = inotify_add_watch(M_fd, directory.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO);
+  if (wd == -1)
+  {
+    M_error = directory + ": inotify_add_watch: " + std::strerror(errno);
+    return false;
+  }
+  // Adding the same directory again returns the same watch descriptor.
+  M_directories[wd] = directory;
+  M_files[directory + '/' + name] = filename;
+  return true;
+#else
+  return false;
+#endif
+}
+
+void InputWatcher::stop_on_interrupt(void)
+{
+  struct sigaction action;
+  std::memset(&action, 0, sizeof(action));
+  action.sa_handler = &InputWatcher::interrupt;		// Without SA_RESTART, so that ppoll returns.
+  sigemptyset(&action.sa_mask);
+  sigaction(SIGINT, &action, NULL);
+  sigaction(SIGTERM, &action, NULL);
+  sigset_t interrupts;
+  sigemptyset(&interrupts);
+  sigaddset(&interrupts, SIGINT);
+  sigaddset(&interrupts, SIGTERM);
+  // Only deliver them in ppoll, so that one that arrives while merging isn't missed.
+  sigprocmask(SIG_BLOCK, &interrupts, &M_wait_mask);
+  sigdelset(&M_wait_mask, SIGINT);
+  sigdelset(&M_wait_mask, SIGTERM);
+  M_stop_on_interrupt = true;
+}
+
+std::set<std::string> InputWatcher::wait(void)
+{
+  std::set<std::string> changed;
+#ifdef __linux__
+  char buffer[4096] __attribute__ ((aligned(__alignof__(struct inotify_event))));
+  struct timespec const quiet = { 0, quiet_period * 1000000L };
+  struct timespec const* timeout = NULL;
+  for (;;)
+  {
+    struct pollfd pfd;
+    pfd.fd = M_fd;
+    pfd.events = POLLIN;
+    int ready = ppoll(&pfd, 1, timeout, M_stop_on_interrupt ? &M_wait_mask : NULL);
+    if (ready == -1 && errno == EINTR && S_interrupted)
+    {
+      changed.clear();
+      break;
+    }
+    if (ready == -1 && errno == EINTR)
+      continue;
+    if (ready == -1)
+    {
+      M_error = std::string("poll: ") + std::strerror(errno);
+      changed.clear();
+      break;
+    }
+    if (ready == 0)
+      break;						// Quiet for a while.
+    ssize_t len = read(M_fd, buffer, sizeof(buffer));
+    if (len == -1 && errno == EINTR)
+      continue;
+    if (len <= 0)
+    {
+      M_error = std::string("read: ") + std::strerror(errno);
+      changed.clear();
+      break;
+    }
+    for (char const* ptr = buffer; ptr < buffer + len;)
+    {
+      struct inotify_event const* event = reinterpret_cast<struct inotify_event const*>(ptr);
+      ptr += sizeof(struct inotify_event) + event->len;
+      if ((event->mask & IN_Q_OVERFLOW))
+      {
+	// Events were lost; assume everything changed.
+	for (std::map<std::string, std::string>::const_iterator file = M_files.begin(); file != M_files.end(); ++file)
+	  changed.insert(file->second);
+	continue;
+      }
+      std::map<int, std::string>::const_iterator directory = M_directories.find(event->wd);
+      if (directory == M_directories.end() || event->len == 0)
+	continue;
+      std::map<std::string, std::string>::const_iterator file = M_files.find(directory->second + '/' + event->name);
+      if (file != M_files.end())
+	changed.insert(file->second);
+    }
+    if (!changed.empty())
+      timeout = &quiet;
+  }
+#else
+  M_error = "inotify is only available on Linux";
+#endif
+  return changed;
+}
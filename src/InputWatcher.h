@@ -0,0 +1,70 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file InputWatcher.h Declaration of class InputWatcher.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INPUTWATCHER_H
+#define INPUTWATCHER_H
+
+#include <map>
+#include <set>
+#include <string>
+#include <signal.h>
+
+// Waits for files to be written, using Linux inotify(7).
+//
+// The directories of the files are watched rather than the files themselves, because
+// most editors save by writing a new file and renaming it over the old one.
+class InputWatcher
+{
+  private:
+    int M_fd;
+    std::map<int, std::string> M_directories;		// Watch descriptor -> directory.
+    std::map<std::string, std::string> M_files;		// directory/name -> file name as passed to add().
+    std::string M_error;				// Why the last call failed.
+    bool M_stop_on_interrupt;
+    sigset_t M_wait_mask;				// The signal mask while waiting, if M_stop_on_interrupt.
+
+    static volatile sig_atomic_t S_interrupted;
+    static void interrupt(int);
+
+  public:
+    InputWatcher(void);
+    ~InputWatcher();
+
+    // Watch filename. Returns false on failure (see error()).
+    bool add(std::string const& filename);
+
+    // Block until at least one of the watched files was written, then wait until no more
+    // changes arrive for a short while (saving can take several writes) and return the
+    // names of all files that changed. Returns an empty set on failure (see error()),
+    // or when interrupted (see stop_on_interrupt()).
+    std::set<std::string> wait(void);
+
+    // Let SIGINT and SIGTERM end wait() instead of the process, so that the caller can
+    // shut down normally. Those signals are blocked from now on, except during wait().
+    void stop_on_interrupt(void);
+    bool interrupted(void) const { return S_interrupted; }
+
+    std::string const& error(void) const { return M_error; }
+
+  private:
+    InputWatcher(InputWatcher const&);
+    InputWatcher& operator=(InputWatcher const&);
+};
+
+#endif // INPUTWATCHER_H
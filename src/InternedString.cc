@@ -0,0 +1,236 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file InternedString.cc Implementation of class InternedString.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <algorithm>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <new>
+#include "debug.h"
+#endif
+
+#include "InternedString.h"
+
+namespace {
+
+// FNV-1a.
+size_t hash(char const* data, size_t size)
+{
+  size_t h = 2166136261U;
+  for (char const* p = data; p != data + size; ++p)
+    h = (h ^ static_cast<unsigned char>(*p)) * 16777619U;
+  return h;
+}
+
+// The index of the highest bit that is set in x, which may not be zero.
+int highest_bit(size_t x)
+{
+  return sizeof(unsigned long long) * 8 - 1 - __builtin_clzll(x);
+}
+
+size_t reverse_bits(size_t x)
+{
+  size_t r = 0;
+  for (size_t i = 0; i < sizeof(size_t) * 8; ++i, x >>= 1)
+    r = r << 1 | (x & 1);
+  return r;
+}
+
+} // namespace
+
+// The table is a split-ordered list (Shalev and Shavit): all nodes are in a single
+// linked list, sorted by their bit reversed hash, and a bucket points to a head node
+// in that list, in front of the strings whose hash ends on the bits of the bucket
+// number. Doubling the number of buckets therefore never moves a node: a new bucket
+// simply gets a new head node, inserted in the list of the bucket it splits off from.
+// The buckets are in segments that are allocated when first needed and never move.
+//
+// A node is completely initialized before it is inserted in the list with a
+// compare-and-swap, and never changes after that, except for its M_next when a node
+// is inserted after it and its (atomic) reference count; a lookup therefore only
+// needs acquire loads. Nodes are only removed by collect(), which runs alone.
+InternedString::Node InternedString::S_head;
+InternedString::Node* volatile* volatile InternedString::S_segments[S_max_segments];
+size_t volatile InternedString::S_number_of_buckets = S_first_segment_size;
+size_t volatile InternedString::S_count;
+size_t volatile InternedString::S_bytes;
+
+InternedString::Node* InternedString::new_node(size_t order, size_t hash, char const* data, size_t size)
+{
+  Node* node = static_cast<Node*>(operator new(offsetof(Node, M_data) + size + 1));
+  node->M_order = order;
+  node->M_hash = hash;
+  node->M_size = size;
+  node->M_references = 1;					// The InternedString that interns it.
+  std::memcpy(node->M_data, data, size);
+  node->M_data[size] = 0;
+  return node;
+}
+
+InternedString::Node* volatile* InternedString::slot(size_t number)
+{
+  int segment = 0;
+  size_t index = number;
+  if (number >= S_first_segment_size)
+  {
+    int const high_bit = highest_bit(number);
+    segment = high_bit - S_first_segment_bits + 1;
+    index = number - ((size_t)1 << high_bit);
+  }
+  Node* volatile* buckets = __atomic_load_n(&S_segments[segment], __ATOMIC_ACQUIRE);
+  if (!buckets)
+  {
+    size_t const size = segment == 0 ? S_first_segment_size : S_first_segment_size << (segment - 1);
+    Node* volatile* segment_buckets = static_cast<Node* volatile*>(std::calloc(size, sizeof(Node*)));
+    if (!segment_buckets)
+      throw std::bad_alloc();
+    buckets = __sync_val_compare_and_swap(&S_segments[segment], (Node* volatile*)NULL, segment_buckets);
+    if (buckets)				// Another thread allocated the segment first.
+      std::free(const_cast<Node**>(segment_buckets));
+    else
+      buckets = segment_buckets;
+  }
+  return buckets + index;
+}
+
+InternedString::Node* InternedString::bucket(size_t number)
+{
+  if (number == 0)
+    return &S_head;
+  Node* volatile* const bucket_slot = slot(number);
+  Node* head = __atomic_load_n(bucket_slot, __ATOMIC_ACQUIRE);
+  if (head)
+    return head;
+  // Insert a head node in the list of the parent bucket: the bucket number without its highest bit.
+  size_t const order = reverse_bits(number);
+  Node* previous = bucket(number & ~((size_t)1 << highest_bit(number)));
+  Node* node = NULL;
+  for (;;)
+  {
+    Node* next = __atomic_load_n(&previous->M_next, __ATOMIC_ACQUIRE);
+    while (next && next->M_order < order)
+    {
+      previous = next;
+      next = __atomic_load_n(&next->M_next, __ATOMIC_ACQUIRE);
+    }
+    if (next && next->M_order == order)	// Another thread inserted the head first.
+    {
+      if (node)
+	operator delete(node);
+      head = next;
+      break;
+    }
+    if (!node)
+      node = new_node(order, 0, "", 0);
+    node->M_next = next;
+    if (__sync_bool_compare_and_swap(&previous->M_next, next, node))
+    {
+      head = node;
+      break;
+    }
+  }
+  // Every thread finds the same head node, so it doesn't matter who stores it.
+  __atomic_store_n(bucket_slot, head, __ATOMIC_RELEASE);
+  return head;
+}
+
+InternedString::Node const* InternedString::intern(char const* data, size_t size)
+{
+  if (size == 0)
+    return NULL;
+  size_t const h = hash(data, size);
+  size_t const order = reverse_bits(h) | 1;
+  size_t const number_of_buckets = __atomic_load_n(&S_number_of_buckets, __ATOMIC_ACQUIRE);
+  Node* previous = bucket(h & (number_of_buckets - 1));
+  Node* node = NULL;
+  for (;;)
+  {
+    Node* next = __atomic_load_n(&previous->M_next, __ATOMIC_ACQUIRE);
+    while (next && next->M_order < order)
+    {
+      previous = next;
+      next = __atomic_load_n(&next->M_next, __ATOMIC_ACQUIRE);
+    }
+    // Strings with the same split order (nearly always the same hash) are adjacent.
+    for (; next && next->M_order == order; previous = next, next = __atomic_load_n(&next->M_next, __ATOMIC_ACQUIRE))
+      if (next->M_hash == h && next->M_size == size && std::memcmp(next->M_data, data, size) == 0)
+      {
+	if (node)				// Another thread interned the same string first.
+	  operator delete(node);
+	__sync_add_and_fetch(&next->M_references, 1);
+	return next;
+      }
+    if (!node)
+      node = new_node(order, h, data, size);
+    node->M_next = next;
+    if (__sync_bool_compare_and_swap(&previous->M_next, next, node))
+      break;
+    // Another node was inserted after previous; continue the search from there.
+  }
+  size_t const count = __sync_add_and_fetch(&S_count, 1);
+  __sync_add_and_fetch(&S_bytes, size);
+  if (count > S_load_factor * number_of_buckets)
+    __sync_bool_compare_and_swap(&S_number_of_buckets, number_of_buckets, 2 * number_of_buckets);
+  return node;
+}
+
+int InternedString::compare(InternedString const& str) const
+{
+  if (M_node == str.M_node)
+    return 0;
+  size_t const n1 = size();
+  size_t const n2 = str.size();
+  int result = std::memcmp(data(), str.data(), std::min(n1, n2));
+  if (result == 0)
+    result = n1 < n2 ? -1 : n1 > n2 ? 1 : 0;
+  return result;
+}
+
+size_t InternedString::count(void)
+{
+  return S_count;
+}
+
+size_t InternedString::bytes(void)
+{
+  return S_bytes;
+}
+
+// The head nodes of the buckets (even split order) are kept; only unreferenced strings are unlinked.
+size_t InternedString::collect(void)
+{
+  size_t freed = 0;
+  Node* previous = &S_head;
+  while (Node* node = previous->M_next)
+  {
+    if (!(node->M_order & 1) || node->M_references)
+    {
+      previous = node;
+      continue;
+    }
+    previous->M_next = node->M_next;
+    S_count -= 1;
+    S_bytes -= node->M_size;
+    operator delete(node);
+    ++freed;
+  }
+  return freed;
+}
@@ -0,0 +1,112 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file InternedString.h Declaration of class InternedString.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef INTERNEDSTRING_H
+#define INTERNEDSTRING_H
+
+#include <cstddef>
+#include <string>
+#include "Arena.h"
+
+// An immutable string that is stored once per process.
+//
+// Every distinct string is kept in a process wide table, so that equal strings
+// (also from different documents) are represented by the same pointer and
+// comparing them for equality is a pointer comparison. Looking up a string in
+// the table is lock-free; any thread may create InternedString's concurrently.
+// The table grows with the number of strings, so that lookups stay cheap however
+// many distinct strings a long running process (--watch, audit) sees.
+//
+// Lifetime: every string counts the InternedString's that refer to it, but a string
+// whose count drops to zero stays in the table (a concurrent lookup may revive it)
+// until collect() is called. A process that keeps replacing its documents, like
+// --watch, calls collect() between jobs, while no other thread uses InternedString;
+// otherwise the table only grows, and is freed at exit.
+class InternedString
+{
+  public:
+    typedef char const* const_iterator;
+    typedef const_iterator iterator;
+    typedef char value_type;
+
+  private:
+    struct Node {
+      Node* M_next;				// Next node in split order.
+      size_t M_order;				// Split order: the bit reversed hash (odd), or bucket number (even).
+      size_t M_hash;
+      size_t M_size;
+      size_t mutable volatile M_references;	// The number of InternedString's with this M_node.
+      char M_data[1];				// M_size characters plus a terminating zero.
+    };
+
+    static int const S_first_segment_bits = 10;
+    static size_t const S_first_segment_size = 1 << S_first_segment_bits;	// Segment n > 0 has S_first_segment_size << (n - 1) buckets.
+    static int const S_max_segments = sizeof(size_t) * 8 - S_first_segment_bits + 1;
+    static size_t const S_load_factor = 2;		// Average number of strings per bucket before the number of buckets doubles.
+    static Node S_head;					// The head of bucket 0, and thus of the whole list.
+    static Node* volatile* volatile S_segments[S_max_segments];
+    static size_t volatile S_number_of_buckets;
+    static size_t volatile S_count;
+    static size_t volatile S_bytes;
+
+    Node const* M_node;				// NULL for the empty string.
+
+    static Node const* intern(char const* data, size_t size);
+    static Node* new_node(size_t order, size_t hash, char const* data, size_t size);
+    static Node* volatile* slot(size_t number);		// The slot of bucket number.
+    static Node* bucket(size_t number);			// The head node of bucket number.
+
+    void add_reference(void) const { if (M_node) __sync_add_and_fetch(&M_node->M_references, 1); }
+    void remove_reference(void) const { if (M_node) __sync_sub_and_fetch(&M_node->M_references, 1); }
+
+  public:
+    InternedString(void) : M_node(NULL) { }
+    InternedString(char const* data, size_t size) : M_node(intern(data, size)) { }
+    InternedString(std::string const& str) : M_node(intern(str.data(), str.size())) { }
+    InternedString(ArenaString const& str) : M_node(intern(str.data(), str.size())) { }
+    InternedString(InternedString const& str) : M_node(str.M_node) { add_reference(); }
+    ~InternedString() { remove_reference(); }
+
+    InternedString& operator=(InternedString const& str) { str.add_reference(); remove_reference(); M_node = str.M_node; return *this; }
+
+    // Accessors.
+    char const* data(void) const { return M_node ? M_node->M_data : ""; }
+    char const* c_str(void) const { return data(); }
+    size_t size(void) const { return M_node ? M_node->M_size : 0; }
+    bool empty(void) const { return !M_node; }
+    const_iterator begin(void) const { return data(); }
+    const_iterator end(void) const { return data() + size(); }
+    std::string str(void) const { return std::string(data(), size()); }
+    int compare(InternedString const& str) const;
+
+    // The number of distinct strings and their total size.
+    static size_t count(void);
+    static size_t bytes(void);
+
+    // Free every string that no InternedString refers to anymore. Returns the number of strings freed.
+    // May only be called while no other thread uses InternedString.
+    static size_t collect(void);
+
+    friend bool operator==(InternedString const& s1, InternedString const& s2) { return s1.M_node == s2.M_node; }
+    friend bool operator!=(InternedString const& s1, InternedString const& s2) { return s1.M_node != s2.M_node; }
+    friend bool operator<(InternedString const& s1, InternedString const& s2)
+        { return s1.M_node != s2.M_node && s1.compare(s2) < 0; }
+};
+
+#endif // INTERNEDSTRING_H
@@ -20,26 +20,28 @@
 #ifndef JIRAPROJECTKEY_H
 #define JIRAPROJECTKEY_H
 
-#include <string>
+#include "InternedString.h"
 
 // Grammar rule: jira_project_key
 class JiraProjectKey
 {
   private:
-    std::string M_jira_project_key_prefix;				// "VWR"
+    InternedString M_jira_project_key_prefix;				// "VWR" (interned, compared by pointer for equality).
     int M_issue_number;							// 123
 
   public:
+    JiraProjectKey(void) : M_issue_number(0) { }
+    JiraProjectKey(InternedString const& jira_project_key_prefix, int issue_number) :
+        M_jira_project_key_prefix(jira_project_key_prefix), M_issue_number(issue_number) { }
+
     // Accessors.
-    std::string const& jira_project_key_prefix(void) const { return M_jira_project_key_prefix; }
+    InternedString const& jira_project_key_prefix(void) const { return M_jira_project_key_prefix; }
     int issue_number(void) const { return M_issue_number; }
 
     friend bool operator<(JiraProjectKey const& jpk1, JiraProjectKey const& jpk2)
     {
-      if (jpk1.M_jira_project_key_prefix < jpk2.M_jira_project_key_prefix)
-	return true;
-      else if (jpk2.M_jira_project_key_prefix < jpk1.M_jira_project_key_prefix)
-	return false;
+      if (jpk1.M_jira_project_key_prefix != jpk2.M_jira_project_key_prefix)
+	return jpk1.M_jira_project_key_prefix < jpk2.M_jira_project_key_prefix;
       return jpk1.M_issue_number < jpk2.M_issue_number;
     }
 };
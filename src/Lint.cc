@@ -0,0 +1,339 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Lint.cc Implementation of class Lint.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include "debug.h"
+#endif
+
+#include "Lint.h"
+#include "ContributorBlocks.h"
+#include "FullName.h"
+#include "Trace.h"
+#include <boost/lexical_cast.hpp>
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace {
+
+// The JIRA project key prefixes of grammar rule jira_project_key_prefix (keep them in sync).
+char const* const known_prefixes[] = { "VWR", "SVC", "WEB", "SEC", "SNOW", "SH", "DN", "CTS", "STORM", "CT" };
+
+bool is_known_prefix(char const* prefix, size_t size)
+{
+  for (size_t i = 0; i < sizeof(known_prefixes) / sizeof(known_prefixes[0]); ++i)
+    if (std::strncmp(prefix, known_prefixes[i], size) == 0 && known_prefixes[i][size] == '\0')
+      return true;
+  return false;
+}
+
+bool is_blank(char c) { return c == ' ' || c == '\t'; }
+bool is_alpha(char c) { return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z'); }
+bool is_digit(char c) { return c >= '0' && c <= '9'; }
+char to_upper(char c) { return (c >= 'a' && c <= 'z') ? c - 'a' + 'A' : c; }
+
+// Names that only differ in case are equal.
+bool iequal(std::string const& name1, std::string const& name2)
+{
+  if (name1.size() != name2.size())
+    return false;
+  for (size_t i = 0; i < name1.size(); ++i)
+    if (to_upper(name1[i]) != to_upper(name2[i]))
+      return false;
+  return true;
+}
+
+struct Name
+{
+  std::string M_full_name;
+  size_t M_line;
+};
+
+// The order of FullName::Compare, except that names that only differ in case are in the order of their lines.
+struct NameCompare
+{
+  bool operator()(Name const& name1, Name const& name2) const
+  {
+    if (iequal(name1.M_full_name, name2.M_full_name))
+      return name1.M_line < name2.M_line;
+    return FullName::Compare()(name1.M_full_name, name2.M_full_name);
+  }
+};
+
+std::string quoted(std::string const& str)
+{
+  return '"' + str + '"';
+}
+
+std::string line_reference(size_t line)
+{
+  return "line " + boost::lexical_cast<std::string>(line);
+}
+
+// If name only differs in case from first_of_group, the name on the lowest line of those, describe that in finding.
+bool is_duplicate(Name const& first_of_group, Name const& name, Lint::Finding& finding)
+{
+  if (!iequal(first_of_group.M_full_name, name.M_full_name))
+    return false;
+  finding.M_line = name.M_line;
+  finding.M_column = 1;
+  if (name.M_full_name == first_of_group.M_full_name)
+    finding.M_message = "duplicate contributor " + quoted(name.M_full_name) +
+        " (also on " + line_reference(first_of_group.M_line) + "); only one of them is kept";
+  else
+    finding.M_message = quoted(name.M_full_name) + " only differs in case from " + quoted(first_of_group.M_full_name) +
+        " on " + line_reference(first_of_group.M_line);
+  return true;
+}
+
+// Find the offsets of every '\n' and of every '\r' in size bytes at data.
+void scan(char const* data, size_t size, std::vector<size_t>& newlines, std::vector<size_t>& carriage_returns)
+{
+  TraceSpan span("scan");
+  size_t i = 0;
+#ifdef __SSE2__
+  __m128i const nl = _mm_set1_epi8('\n');
+  __m128i const cr = _mm_set1_epi8('\r');
+  for (; i + 16 <= size; i += 16)
+  {
+    __m128i const chunk = _mm_loadu_si128(reinterpret_cast<__m128i const*>(data + i));
+    unsigned int nl_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, nl));
+    unsigned int cr_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chunk, cr));
+    for (; nl_mask; nl_mask &= nl_mask - 1)
+      newlines.push_back(i + __builtin_ctz(nl_mask));
+    for (; cr_mask; cr_mask &= cr_mask - 1)
+      carriage_returns.push_back(i + __builtin_ctz(cr_mask));
+  }
+#endif
+  for (; i < size; ++i)
+    if (data[i] == '\n')
+      newlines.push_back(i);
+    else if (data[i] == '\r')
+      carriage_returns.push_back(i);
+}
+
+// The lines of a text, given the offsets of its '\n' characters.
+class Lines
+{
+  private:
+    char const* M_data;
+    size_t M_size;
+    std::vector<size_t> const& M_newlines;
+
+  public:
+    Lines(char const* data, size_t size, std::vector<size_t> const& newlines) : M_data(data), M_size(size), M_newlines(newlines) { }
+
+    // The number of lines, including a last line without newline.
+    size_t size(void) const { return M_newlines.size() + ((M_size && M_data[M_size - 1] != '\n') ? 1 : 0); }
+
+    // Line l (0-based) is [begin(l), end(l)), without its eol ("\n" or "\r\n").
+    char const* begin(size_t l) const { return M_data + (l == 0 ? 0 : M_newlines[l - 1] + 1); }
+    char const* end(size_t l) const
+    {
+      char const* eol = M_data + (l < M_newlines.size() ? M_newlines[l] : M_size);
+      return (eol != begin(l) && eol[-1] == '\r') ? eol - 1 : eol;
+    }
+};
+
+} // namespace
+
+void Lint::add(size_t line, size_t column, std::string const& message)
+{
+  Finding finding;
+  finding.M_line = line;
+  finding.M_column = column;
+  finding.M_message = message;
+  M_findings.push_back(finding);
+}
+
+// Grammar rule contribution_entry, where [begin, end) is the line without its eol.
+// Keys holds the keys of the previous entries of the same contributor, with their line.
+void Lint::check_entry(char const* begin, char const* end, size_t line, std::vector<std::pair<std::string, size_t> >& keys)
+{
+  char const* p = begin;
+  while (p != end && is_blank(*p))
+    ++p;
+  size_t const column = p - begin + 1;
+  static char const no_jira[] = "[NO JIRA]";
+  std::string key;
+  if ((size_t)(end - p) >= sizeof(no_jira) - 1 && std::memcmp(p, no_jira, sizeof(no_jira) - 1) == 0)
+    key = no_jira;					// The grammar drops the issue number of these.
+  else
+  {
+    char const* q = p;
+    while (q != end && is_alpha(*q))
+      ++q;
+    if (q == p || q == end || *q != '-' || q + 1 == end || !is_digit(q[1]))
+    {
+      add(line, column, "expected a JIRA key");
+      return;
+    }
+    if (!is_known_prefix(p, q - p))
+      add(line, column, "unknown JIRA project key prefix " + quoted(std::string(p, q)));
+    // The issue number is an int: leading zeroes don't make a different key.
+    char const* digits = q + 1;
+    while (digits + 1 != end && *digits == '0' && is_digit(digits[1]))
+      ++digits;
+    char const* r = digits;
+    while (r != end && is_digit(*r))
+      ++r;
+    key.assign(p, q + 1);
+    key.append(digits, r);
+  }
+  // A contributor has only a few entries: a linear search is faster than any lookup table.
+  for (std::vector<std::pair<std::string, size_t> >::const_iterator previous = keys.begin(); previous != keys.end(); ++previous)
+    if (previous->first == key)
+    {
+      add(line, column, "duplicate JIRA key " + key + " (also on " + line_reference(previous->second) +
+          "); only one of them is kept");
+      return;
+    }
+  keys.push_back(std::make_pair(key, line));
+}
+
+void Lint::check(std::string const& text)
+{
+  TraceSpan span("lint");
+  M_findings.clear();
+  char const* const data = text.data();
+  size_t const size = text.size();
+  std::vector<size_t> newlines, carriage_returns;
+  scan(data, size, newlines, carriage_returns);
+  Lines const lines(data, size, newlines);
+  size_t const number_of_lines = lines.size();
+  for (std::vector<size_t>::const_iterator cr = carriage_returns.begin(); cr != carriage_returns.end(); ++cr)
+    if (*cr + 1 == size || data[*cr + 1] != '\n')
+    {
+      size_t const l = std::upper_bound(newlines.begin(), newlines.end(), *cr) - newlines.begin();
+      add(l + 1, data + *cr - lines.begin(l) + 1, "carriage return without a newline");
+    }
+  if (number_of_lines > newlines.size())
+    add(number_of_lines, lines.end(number_of_lines - 1) - lines.begin(number_of_lines - 1) + 1, "no newline at the end of the file");
+
+  // The header ends at the first empty line that is followed by a name line (grammar rule start).
+  std::string full_name;
+  size_t first = 0;
+  while (first + 1 < number_of_lines &&
+         !(is_empty_line(lines.begin(first), lines.end(first)) &&
+           is_name_line(lines.begin(first + 1), lines.end(first + 1), full_name)))
+    ++first;
+  if (first + 1 >= number_of_lines)
+  {
+    add(1, 1, "no contributors: expected an empty line followed by the name of a contributor");
+    return;
+  }
+
+  // Duplicate names are adjacent in a sorted text, the common case, where they are found while going.
+  // Otherwise all names are sorted afterwards, and the duplicates found while going are discarded.
+  NameCompare compare;
+  std::vector<size_t> name_lines;			// The lines (0-based) with the name of a contributor.
+  Name name, previous, first_of_group;
+  bool sorted = true;
+  Finding finding;
+  std::vector<Finding> duplicates;
+  std::vector<std::pair<std::string, size_t> > keys;	// The JIRA keys of the current contributor and their line.
+  size_t empty_line = 0;				// The last empty line since the last contributor or entry.
+  for (size_t l = first; l < number_of_lines; ++l)
+  {
+    char const* const begin = lines.begin(l);
+    char const* const end = lines.end(l);
+    size_t const line = l + 1;
+    char const* trailing = end;
+    while (trailing != begin && is_blank(trailing[-1]))
+      --trailing;
+    if (trailing != end)
+      add(line, trailing - begin + 1, "trailing whitespace");
+    if (trailing == begin)
+    {
+      if (l != first)
+	empty_line = line;
+      continue;
+    }
+    if (empty_line)
+    {
+      add(empty_line, 1, "empty line inside the list of contributors");
+      empty_line = 0;
+    }
+    if (is_blank(*begin))
+    {
+      if (name_lines.empty())
+	add(line, 1, "entry without a contributor");
+      else
+	check_entry(begin, end, line, keys);
+      continue;
+    }
+    if (!is_name_line(begin, end, name.M_full_name))
+    {
+      add(line, 1, "expected the name of a contributor (a first name, optionally followed by a last name) or an entry");
+      continue;
+    }
+    keys.clear();
+    name.M_line = line;
+    // Same as compare(previous, name), as previous is on a lower line.
+    if (!name_lines.empty() && !FullName::Compare()(previous.M_full_name, name.M_full_name) &&
+        !iequal(previous.M_full_name, name.M_full_name))
+    {
+      add(line, 1, quoted(name.M_full_name) + " is out of order: it should come before " + quoted(previous.M_full_name) +
+          " on " + line_reference(previous.M_line));
+      sorted = false;
+    }
+    else if (sorted)
+    {
+      if (!name_lines.empty() && is_duplicate(first_of_group, name, finding))
+	duplicates.push_back(finding);
+      else
+	first_of_group = name;
+    }
+    name_lines.push_back(l);
+    previous.M_full_name.swap(name.M_full_name);
+    previous.M_line = line;
+  }
+
+  if (!sorted)
+  {
+    duplicates.clear();
+    std::vector<Name> names(name_lines.size());
+    for (size_t i = 0; i < name_lines.size(); ++i)
+    {
+      is_name_line(lines.begin(name_lines[i]), lines.end(name_lines[i]), names[i].M_full_name);
+      names[i].M_line = name_lines[i] + 1;
+    }
+    std::stable_sort(names.begin(), names.end(), compare);
+    for (std::vector<Name>::const_iterator name = names.begin(); name != names.end(); ++name)
+    {
+      if (name != names.begin() && is_duplicate(first_of_group, *name, finding))
+	duplicates.push_back(finding);
+      else
+	first_of_group = *name;
+    }
+  }
+  M_findings.insert(M_findings.end(), duplicates.begin(), duplicates.end());
+}
+
+void Lint::print_on(std::ostream& os, std::string const& name) const
+{
+  std::vector<Finding> findings(M_findings);
+  std::stable_sort(findings.begin(), findings.end());
+  for (std::vector<Finding>::const_iterator finding = findings.begin(); finding != findings.end(); ++finding)
+    os << name << ':' << finding->M_line << ':' << finding->M_column << ": " << finding->M_message << '\n';
+}
@@ -0,0 +1,73 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Lint.h Declaration of class Lint.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef LINT_H
+#define LINT_H
+
+#include <iosfwd>
+#include <string>
+#include <utility>
+#include <vector>
+#include <stddef.h>
+
+// contribmerge --lint: check a contributions.txt for everything that a merge would stumble over
+// or silently change, and report all of it (a parse only reports the first failure):
+//
+// - lines that are neither a name nor an entry, and empty lines inside the list of contributors;
+// - contributors that are not in the order of FullName::Compare, that appear twice,
+//   or whose names only differ in case;
+// - unknown JIRA project key prefixes;
+// - JIRA keys that appear twice for the same contributor (a merge keeps only one of them);
+// - trailing whitespace (outside the header), lone carriage returns and a missing final newline.
+//
+// The text is not parsed with the grammar: it is scanned once for line ends (with SSE2 when
+// available, 16 bytes at a time) and every line is classified by its first characters.
+class Lint
+{
+  public:
+    struct Finding
+    {
+      size_t M_line;				// 1-based.
+      size_t M_column;				// 1-based, in bytes.
+      std::string M_message;
+
+      friend bool operator<(Finding const& f1, Finding const& f2)
+          { return f1.M_line != f2.M_line ? f1.M_line < f2.M_line : f1.M_column < f2.M_column; }
+    };
+
+  private:
+    std::vector<Finding> M_findings;
+
+  public:
+    // Check text, the contents of a contributions.txt.
+    void check(std::string const& text);
+
+    // Print every finding as "<name>:<line>:<column>: <message>", in the order of the lines.
+    void print_on(std::ostream& os, std::string const& name) const;
+
+    // Accessors.
+    std::vector<Finding> const& findings(void) const { return M_findings; }
+
+  private:
+    void add(size_t line, size_t column, std::string const& message);
+    void check_entry(char const* begin, char const* end, size_t line,
+        std::vector<std::pair<std::string, size_t> >& keys);
+};
+
+#endif // LINT_H
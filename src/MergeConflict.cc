@@ -0,0 +1,45 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file MergeConflict.cc Implementation of class MergeConflicts.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <iostream>
+#include "debug.h"
+#endif
+
+#include "MergeConflict.h"
+
+void MergeConflict::print_on(std::ostream& os) const
+{
+  if (M_contributor.empty())
+    os << "Conflict in the header";
+  else
+    os << "Conflict in contributor \"" << M_contributor << '"';
+  os << ", rule " << M_rule << " --> MergeFailure.\n";
+  os << "  base:  <RAW>" << M_base << "</RAW>\n";
+  os << "  left:  <RAW>" << M_left << "</RAW>\n";
+  os << "  right: <RAW>" << M_right << "</RAW>\n";
+}
+
+void MergeConflicts::print_on(std::ostream& os) const
+{
+  for (conflicts_type::const_iterator conflict = M_conflicts.begin(); conflict != M_conflicts.end(); ++conflict)
+    conflict->print_on(os);
+  os << M_conflicts.size() << (M_conflicts.size() == 1 ? " conflict.\n" : " conflicts.\n");
+}
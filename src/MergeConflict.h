@@ -0,0 +1,58 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file MergeConflict.h Declaration of class MergeConflicts.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MERGECONFLICT_H
+#define MERGECONFLICT_H
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+// A conflict found by merge().
+struct MergeConflict
+{
+  std::string M_contributor;		// Full name of the contributor; empty for a conflict in the header.
+  std::string M_rule;			// The rule that was hit, for example "n (-, m)".
+  std::string M_base;			// The conflicting base, left and right version (a contribution entry,
+  std::string M_left;			// the raw contributor or the header), or "-" when it doesn't exist.
+  std::string M_right;
+
+  void print_on(std::ostream& os) const;
+};
+
+// Every conflict found by merge() in --collect-conflicts mode, in the order they were found.
+class MergeConflicts
+{
+  public:
+    typedef std::vector<MergeConflict> conflicts_type;
+
+  private:
+    conflicts_type M_conflicts;
+
+  public:
+    void add(MergeConflict const& conflict) { M_conflicts.push_back(conflict); }
+
+    // Accessors.
+    conflicts_type const& conflicts(void) const { return M_conflicts; }
+    bool empty(void) const { return M_conflicts.empty(); }
+
+    void print_on(std::ostream& os) const;
+};
+
+#endif // MERGECONFLICT_H
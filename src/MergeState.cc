@@ -0,0 +1,369 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file MergeState.cc Implementation of class MergeState.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <vector>
+#include "debug.h"
+#endif
+
+#include "MergeState.h"
+#include "AsyncIO.h"
+#include "ContentHash.h"
+#include "ContributionsTxt.h"
+#include "ContributorBlocks.h"
+#include "merge.h"
+#include "ostream_operators.h"
+#include "Trace.h"
+#include <stdint.h>
+#include <zlib.h>
+
+namespace {
+
+// The layout of a state file, in native byte order:
+//
+//   char magic[8]
+//   uint32_t version
+//   uint32_t checksum		CRC-32 of the payload
+//   payload:
+//     string key
+//     uint64_t base_header_length, right_header_length, number_of_entries
+//     for every entry:
+//       string full_name
+//       uint64_t base_offset, base_length, right_offset, right_length
+//       string left_hash, result
+//
+// where a string is a uint64_t length followed by that many bytes.
+
+char const state_magic[8] = { 'C', 'M', 'S', 'T', 'A', 'T', 'E', ' ' };
+uint32_t const state_version = 1;			// Increment whenever the layout changes.
+
+void put(std::string& payload, uint64_t value)
+{
+  payload.append(reinterpret_cast<char const*>(&value), sizeof(value));
+}
+
+void put(std::string& payload, char const* data, size_t size)
+{
+  put(payload, size);
+  payload.append(data, size);
+}
+
+void put(std::string& payload, std::string const& str)
+{
+  put(payload, str.data(), str.size());
+}
+
+// Reads a payload, failing (for good) at the first attempt to read beyond its end.
+class PayloadReader
+{
+  private:
+    std::string const& M_payload;
+    size_t M_pos;
+    bool M_good;
+
+  public:
+    PayloadReader(std::string const& payload) : M_payload(payload), M_pos(0), M_good(true) { }
+
+    bool good(void) const { return M_good; }
+    bool at_end(void) const { return M_pos == M_payload.size(); }
+
+    uint64_t get(void)
+    {
+      uint64_t value = 0;
+      if (M_good && M_payload.size() - M_pos >= sizeof(value))
+      {
+	std::memcpy(&value, M_payload.data() + M_pos, sizeof(value));
+	M_pos += sizeof(value);
+      }
+      else
+	M_good = false;
+      return value;
+    }
+
+    std::string get_string(void)
+    {
+      uint64_t size = get();
+      if (!M_good || M_payload.size() - M_pos < size)
+      {
+	M_good = false;
+	return std::string();
+      }
+      M_pos += size;
+      return M_payload.substr(M_pos - size, size);
+    }
+};
+
+// Parse the header followed by the given blocks of buffer. Returns false if they don't parse into exactly those contributors.
+bool parse_blocks(std::string const& name, std::string const& buffer, size_t header_length,
+    std::vector<std::pair<size_t, size_t> > const& blocks, ContributionsTxt& document)
+{
+  std::string header(buffer, 0, header_length);
+  if (blocks.empty())
+  {
+    document = Header(header);
+    return true;
+  }
+  std::string text(header);
+  text += '\n';
+  for (std::vector<std::pair<size_t, size_t> >::const_iterator block = blocks.begin(); block != blocks.end(); ++block)
+    text.append(buffer, block->first, block->second);
+  try
+  {
+    document.parse(name, text);
+  }
+  catch(ParseError&)
+  {
+    return false;
+  }
+  return document.contributors().size() == blocks.size();
+}
+
+} // namespace
+
+std::string MergeState::key(std::string const& options, std::string const& base_buffer, std::string const& right_buffer)
+{
+  std::string data(executable_identity());
+  data += '\0';
+  data += options;
+  data += '\0';
+  data += content_hash(base_buffer);
+  data += content_hash(right_buffer);
+  return content_hash(data);
+}
+
+bool MergeState::assign(std::string const& key,
+    std::string const& base_buffer, std::string const& left_buffer, std::string const& right_buffer,
+    ContributionsTxt const& base, ContributionsTxt const& left, ContributionsTxt const& right,
+    ContributionsTxt const& result, std::string const& output)
+{
+  TraceSpan span("merge state");
+  if (!result.conflict_markers().empty())
+    return false;
+  size_t left_header_length;
+  std::vector<ContributorBlock> base_blocks, left_blocks, right_blocks;
+  if (!split_contributor_blocks(base_buffer, M_base_header_length, base_blocks) ||
+      !split_contributor_blocks(left_buffer, left_header_length, left_blocks) ||
+      !split_contributor_blocks(right_buffer, M_right_header_length, right_blocks))
+    return false;
+  // Every contributor must have been found exactly once, under the same name as the grammar gives it.
+  if (base_blocks.size() != base.contributors().size() ||
+      left_blocks.size() != left.contributors().size() ||
+      right_blocks.size() != right.contributors().size())
+    return false;
+
+  M_key = key;
+  M_entries.clear();
+  for (std::vector<ContributorBlock>::const_iterator block = base_blocks.begin(); block != base_blocks.end(); ++block)
+  {
+    FullName const full_name(block->M_full_name);
+    if (base.contributors().find(full_name) == base.contributors().end())
+      return false;
+    Entry& entry(M_entries[full_name]);
+    entry.M_base_offset = block->M_offset;
+    entry.M_base_length = block->M_length;
+  }
+  for (std::vector<ContributorBlock>::const_iterator block = right_blocks.begin(); block != right_blocks.end(); ++block)
+  {
+    FullName const full_name(block->M_full_name);
+    if (right.contributors().find(full_name) == right.contributors().end())
+      return false;
+    Entry& entry(M_entries[full_name]);
+    entry.M_right_offset = block->M_offset;
+    entry.M_right_length = block->M_length;
+  }
+  for (std::vector<ContributorBlock>::const_iterator block = left_blocks.begin(); block != left_blocks.end(); ++block)
+  {
+    FullName const full_name(block->M_full_name);
+    if (left.contributors().find(full_name) == left.contributors().end())
+      return false;
+    M_entries[full_name].M_left_hash = content_hash(left_buffer.data() + block->M_offset, block->M_length);
+  }
+  for (ContributionsTxt::contributors_map::const_iterator contributor = result.contributors().begin();
+       contributor != result.contributors().end(); ++contributor)
+  {
+    entries_map::iterator entry = M_entries.find(contributor->first);
+    if (entry == M_entries.end())
+      return false;
+    std::ostringstream os;
+    os << *contributor;
+    entry->second.M_result = os.str();
+  }
+  // Finally, the results must add up to the real output.
+  return this->output(result.header().as_string()) == output;
+}
+
+bool MergeState::remerge(std::string const& base_buffer, std::string const& left_buffer, std::string const& right_buffer, std::string& output)
+{
+  TraceSpan span("remerge");
+  size_t left_header_length;
+  std::vector<ContributorBlock> left_blocks;
+  if (!split_contributor_blocks(left_buffer, left_header_length, left_blocks))
+    return false;
+
+  // Find the contributors whose block in left changed, was added or was removed.
+  std::map<FullName, std::string, FullName::Compare> changed;	// The new left hash of each of them (empty if removed).
+  std::set<FullName, FullName::Compare> seen;
+  std::vector<std::pair<size_t, size_t> > base_changed, left_changed, right_changed;
+  for (std::vector<ContributorBlock>::const_iterator block = left_blocks.begin(); block != left_blocks.end(); ++block)
+  {
+    FullName const full_name(block->M_full_name);
+    if (!seen.insert(full_name).second)
+      return false;
+    std::string hash(content_hash(left_buffer.data() + block->M_offset, block->M_length));
+    entries_map::const_iterator entry = M_entries.find(full_name);
+    if (entry == M_entries.end() || entry->second.M_left_hash != hash)
+    {
+      changed[full_name] = hash;
+      left_changed.push_back(std::make_pair(block->M_offset, block->M_length));
+    }
+  }
+  for (entries_map::const_iterator entry = M_entries.begin(); entry != M_entries.end(); ++entry)
+    if (!entry->second.M_left_hash.empty() && seen.find(entry->first) == seen.end())
+      changed[entry->first];
+  for (std::map<FullName, std::string, FullName::Compare>::const_iterator contributor = changed.begin(); contributor != changed.end(); ++contributor)
+  {
+    entries_map::const_iterator entry = M_entries.find(contributor->first);
+    if (entry == M_entries.end())
+      continue;
+    if (entry->second.M_base_length)
+      base_changed.push_back(std::make_pair(entry->second.M_base_offset, entry->second.M_base_length));
+    if (entry->second.M_right_length)
+      right_changed.push_back(std::make_pair(entry->second.M_right_offset, entry->second.M_right_length));
+  }
+
+  // Merge just those contributors.
+  ContributionsTxt base, left, right;
+  if (!parse_blocks("base", base_buffer, M_base_header_length, base_changed, base) ||
+      !parse_blocks("left", left_buffer, left_header_length, left_changed, left) ||
+      !parse_blocks("right", right_buffer, M_right_header_length, right_changed, right))
+    return false;
+  MergeConflicts conflicts;
+  CollectConflicts collect_conflicts(conflicts);
+  NoMergeStatistics no_statistics;
+  ContributionsTxt result(merge(base, left, right, no_statistics, no_statistics, NULL, collect_conflicts));
+  if (!conflicts.empty())
+    return false;
+
+  // Update the entries of the changed contributors.
+  for (std::map<FullName, std::string, FullName::Compare>::const_iterator contributor = changed.begin(); contributor != changed.end(); ++contributor)
+  {
+    Entry& entry(M_entries[contributor->first]);
+    entry.M_left_hash = contributor->second;
+    ContributionsTxt::contributors_map::const_iterator merged = result.contributors().find(contributor->first);
+    if (merged == result.contributors().end())
+      entry.M_result.clear();
+    else
+    {
+      std::ostringstream os;
+      os << *merged;
+      entry.M_result = os.str();
+    }
+    if (!entry.M_base_length && !entry.M_right_length && entry.M_left_hash.empty())
+      M_entries.erase(contributor->first);
+  }
+  output = this->output(result.header().as_string());
+  return true;
+}
+
+std::string MergeState::output(std::string const& header) const
+{
+  std::string output(header);
+  output += '\n';
+  for (entries_map::const_iterator entry = M_entries.begin(); entry != M_entries.end(); ++entry)
+    output += entry->second.M_result;
+  output += '\n';
+  return output;
+}
+
+bool MergeState::load(std::string const& filename, std::string const& key)
+{
+  TraceSpan span("merge state load", filename.c_str());
+  std::ifstream file(filename.c_str(), std::ios::in | std::ios::binary);
+  if (!file)
+    return false;
+  std::ostringstream contents;
+  contents << file.rdbuf();
+  std::string const data(contents.str());
+  size_t const header_size = sizeof(state_magic) + 2 * sizeof(uint32_t);
+  if (data.size() < header_size || std::memcmp(data.data(), state_magic, sizeof(state_magic)) != 0)
+    return false;
+  uint32_t version, checksum;
+  std::memcpy(&version, data.data() + sizeof(state_magic), sizeof(version));
+  std::memcpy(&checksum, data.data() + sizeof(state_magic) + sizeof(version), sizeof(checksum));
+  std::string const payload(data, header_size);
+  if (version != state_version ||
+      crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<unsigned char const*>(payload.data()), payload.size()) != checksum)
+    return false;
+
+  PayloadReader reader(payload);
+  if (reader.get_string() != key)
+    return false;
+  MergeState state;
+  state.M_key = key;
+  state.M_base_header_length = reader.get();
+  state.M_right_header_length = reader.get();
+  for (uint64_t count = reader.get(); reader.good() && count > 0; --count)
+  {
+    std::string full_name(reader.get_string());
+    Entry& entry(state.M_entries[FullName(full_name)]);
+    entry.M_base_offset = reader.get();
+    entry.M_base_length = reader.get();
+    entry.M_right_offset = reader.get();
+    entry.M_right_length = reader.get();
+    entry.M_left_hash = reader.get_string();
+    entry.M_result = reader.get_string();
+  }
+  if (!reader.good() || !reader.at_end())
+    return false;
+  *this = state;
+  return true;
+}
+
+void MergeState::store(std::string const& filename) const
+{
+  TraceSpan span("merge state store", filename.c_str());
+  std::string payload;
+  put(payload, M_key);
+  put(payload, M_base_header_length);
+  put(payload, M_right_header_length);
+  put(payload, M_entries.size());
+  for (entries_map::const_iterator entry = M_entries.begin(); entry != M_entries.end(); ++entry)
+  {
+    put(payload, entry->first.full_name().data(), entry->first.full_name().size());
+    put(payload, entry->second.M_base_offset);
+    put(payload, entry->second.M_base_length);
+    put(payload, entry->second.M_right_offset);
+    put(payload, entry->second.M_right_length);
+    put(payload, entry->second.M_left_hash);
+    put(payload, entry->second.M_result);
+  }
+  uint32_t const checksum = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<unsigned char const*>(payload.data()), payload.size());
+
+  // The state is replaced atomically (see write_file); failure to write it is not fatal.
+  std::string state(state_magic, sizeof(state_magic));
+  state.append(reinterpret_cast<char const*>(&state_version), sizeof(state_version));
+  state.append(reinterpret_cast<char const*>(&checksum), sizeof(checksum));
+  state += payload;
+  write_file(filename, state, false);
+}
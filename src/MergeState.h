@@ -0,0 +1,83 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file MergeState.h Declaration of class MergeState.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MERGESTATE_H
+#define MERGESTATE_H
+
+#include <map>
+#include <string>
+#include "FullName.h"
+
+class ContributionsTxt;
+
+// What is needed to redo a merge after <left> changed, while <base> and <right> did not:
+// the location of each contributor block in <base> and <right>, the hash of its block in
+// <left> and its printed result. A re-merge only parses and merges the contributors whose
+// block in <left> changed (or that were added or removed); the result of all others is
+// reused byte for byte.
+class MergeState
+{
+  public:
+    struct Entry {
+      size_t M_base_offset;
+      size_t M_base_length;				// Zero if the contributor isn't in base.
+      size_t M_right_offset;
+      size_t M_right_length;				// Zero if the contributor isn't in right.
+      std::string M_left_hash;				// Content hash of the block in left; empty if not in left.
+      std::string M_result;				// The printed result; empty if not in the result.
+
+      Entry(void) : M_base_offset(0), M_base_length(0), M_right_offset(0), M_right_length(0) { }
+    };
+    typedef std::map<FullName, Entry, FullName::Compare> entries_map;
+
+  private:
+    std::string M_key;					// See key().
+    size_t M_base_header_length;
+    size_t M_right_header_length;
+    entries_map M_entries;
+
+  public:
+    MergeState(void) : M_base_header_length(0), M_right_header_length(0) { }
+
+    // The key of a state for base and right, where options describes the options that affect the result.
+    static std::string key(std::string const& options, std::string const& base_buffer, std::string const& right_buffer);
+
+    // Initialize from a finished merge of the documents left, base and right, parsed from the corresponding
+    // buffers, into result, printed as output. Returns false if the inputs aren't suitable for re-merging.
+    bool assign(std::string const& key,
+        std::string const& base_buffer, std::string const& left_buffer, std::string const& right_buffer,
+        ContributionsTxt const& base, ContributionsTxt const& left, ContributionsTxt const& right,
+        ContributionsTxt const& result, std::string const& output);
+
+    // Load the state from filename. Returns false if it doesn't exist, is corrupt or has another key.
+    bool load(std::string const& filename, std::string const& key);
+
+    // Write the state to filename. Failure to write is silently ignored.
+    void store(std::string const& filename) const;
+
+    // Merge the new left_buffer, with the base_buffer and right_buffer of this state, into output and update the state.
+    // Returns false, leaving the state unchanged, if that isn't possible (a conflict or a parse error); do a full merge then.
+    bool remerge(std::string const& base_buffer, std::string const& left_buffer, std::string const& right_buffer, std::string& output);
+
+  private:
+    // Assemble the output from header and the results in M_entries.
+    std::string output(std::string const& header) const;
+};
+
+#endif // MERGESTATE_H
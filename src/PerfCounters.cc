@@ -0,0 +1,179 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file PerfCounters.cc Implementation of class PerfCounters.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <cerrno>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <unistd.h>
+#include "debug.h"
+#endif
+
+#include "PerfCounters.h"
+
+#ifdef __linux__
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#endif
+
+namespace {
+
+#ifdef __linux__
+unsigned long long const config[PerfCounters::number_of_events] = {
+  PERF_COUNT_HW_CPU_CYCLES,
+  PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_MISSES,
+  PERF_COUNT_HW_BRANCH_MISSES
+};
+#endif
+
+} // namespace
+
+PerfCounters::PerfCounters(void)
+{
+  for (int event = 0; event < number_of_events; ++event)
+  {
+    M_fd[event] = -1;
+#ifdef __linux__
+    struct perf_event_attr attr;
+    std::memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_TYPE_HARDWARE;
+    attr.config = config[event];
+    // Only count user space, that is allowed with perf_event_paranoid <= 2.
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    M_fd[event] = syscall(__NR_perf_event_open, &attr, 0 /* this thread */, -1 /* any cpu */, -1 /* no group */, 0);
+    if (M_fd[event] == -1 && M_error.empty())
+      M_error = std::string(name(static_cast<event_type>(event))) + ": perf_event_open: " + std::strerror(errno);
+#else
+    if (M_error.empty())
+      M_error = "perf_event_open is only available on Linux";
+#endif
+  }
+}
+
+PerfCounters::~PerfCounters()
+{
+  for (int event = 0; event < number_of_events; ++event)
+    if (M_fd[event] != -1)
+      close(M_fd[event]);
+}
+
+bool PerfCounters::any_available(void) const
+{
+  for (int event = 0; event < number_of_events; ++event)
+    if (M_fd[event] != -1)
+      return true;
+  return false;
+}
+
+PerfCounters::Sample PerfCounters::read(void) const
+{
+  Sample sample;
+  for (int event = 0; event < number_of_events; ++event)
+  {
+    sample.M_value[event] = 0;
+    if (M_fd[event] != -1 && ::read(M_fd[event], &sample.M_value[event], sizeof(sample.M_value[event])) != sizeof(sample.M_value[event]))
+      sample.M_value[event] = 0;
+  }
+  return sample;
+}
+
+char const* PerfCounters::name(event_type event)
+{
+  switch (event)
+  {
+    case cycles:
+      return "cycles";
+    case instructions:
+      return "instructions";
+    case cache_misses:
+      return "cache-misses";
+    case branch_misses:
+      return "branch-misses";
+    default:
+      break;
+  }
+  return "unknown";
+}
+
+void PerfReport::add_phase(std::string const& name, std::string const& target, unsigned long contributors,
+                           PerfCounters::Sample const& start, PerfCounters::Sample const& end)
+{
+  Phase phase;
+  phase.M_name = name;
+  phase.M_target = target;
+  phase.M_contributors = contributors;
+  for (int event = 0; event < PerfCounters::number_of_events; ++event)
+    phase.M_delta.M_value[event] = end.M_value[event] - start.M_value[event];
+  M_phases.push_back(phase);
+}
+
+void PerfReport::print_on(std::ostream& os) const
+{
+  if (!M_counters.any_available())
+  {
+    os << "Performance counters unavailable (" << M_counters.error() << ").\n";
+    return;
+  }
+  os << "Performance counters (user space):\n";
+  os << "  phase " << std::setw(14) << "cycles" << std::setw(14) << "instructions" << std::setw(6) << "IPC"
+     << std::setw(12) << "cache-miss" << std::setw(12) << "branch-miss"
+     << std::setw(10) << "cm/contr" << std::setw(10) << "bm/contr" << '\n';
+  for (std::vector<Phase>::const_iterator phase = M_phases.begin(); phase != M_phases.end(); ++phase)
+  {
+    unsigned long long const* value = phase->M_delta.M_value;
+    os << "  " << std::left << std::setw(6) << phase->M_name << std::right;
+    for (int event = PerfCounters::cycles; event <= PerfCounters::instructions; ++event)
+    {
+      if (M_counters.available(static_cast<PerfCounters::event_type>(event)))
+	os << std::setw(14) << value[event];
+      else
+	os << std::setw(14) << '-';
+    }
+    os << std::fixed << std::setprecision(2);
+    if (value[PerfCounters::cycles] && M_counters.available(PerfCounters::instructions))
+      os << std::setw(6) << static_cast<double>(value[PerfCounters::instructions]) / value[PerfCounters::cycles];
+    else
+      os << std::setw(6) << '-';
+    for (int event = PerfCounters::cache_misses; event <= PerfCounters::branch_misses; ++event)
+    {
+      if (M_counters.available(static_cast<PerfCounters::event_type>(event)))
+	os << std::setw(12) << value[event];
+      else
+	os << std::setw(12) << '-';
+    }
+    for (int event = PerfCounters::cache_misses; event <= PerfCounters::branch_misses; ++event)
+    {
+      if (M_counters.available(static_cast<PerfCounters::event_type>(event)) && phase->M_contributors)
+	os << std::setw(10) << static_cast<double>(value[event]) / phase->M_contributors;
+      else
+	os << std::setw(10) << '-';
+    }
+    if (!phase->M_target.empty())
+      os << "  " << phase->M_target;
+    os << '\n';
+  }
+  if (!M_counters.error().empty())
+    os << "  Not all counters are available (" << M_counters.error() << ").\n";
+}
@@ -0,0 +1,92 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file PerfCounters.h Declaration of class PerfCounters.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef PERFCOUNTERS_H
+#define PERFCOUNTERS_H
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+
+// Hardware performance counters of the calling thread, using Linux perf_event_open(2).
+//
+// If the kernel doesn't allow it (no PMU in a VM, perf_event_paranoid, seccomp, not Linux)
+// then the counters that could not be opened are simply not available.
+class PerfCounters
+{
+  public:
+    enum event_type {
+      cycles,
+      instructions,
+      cache_misses,
+      branch_misses,
+      number_of_events
+    };
+
+    struct Sample {
+      unsigned long long M_value[number_of_events];
+    };
+
+  private:
+    int M_fd[number_of_events];
+    std::string M_error;				// Why the first counter that failed could not be opened.
+
+  public:
+    PerfCounters(void);
+    ~PerfCounters();
+
+    bool available(event_type event) const { return M_fd[event] != -1; }
+    bool any_available(void) const;
+    std::string const& error(void) const { return M_error; }
+
+    Sample read(void) const;
+
+    static char const* name(event_type event);
+
+  private:
+    PerfCounters(PerfCounters const&);
+    PerfCounters& operator=(PerfCounters const&);
+};
+
+// The counter deltas of each phase, as reported by --perf-counters.
+class PerfReport
+{
+  public:
+    struct Phase {
+      std::string M_name;
+      std::string M_target;
+      unsigned long M_contributors;			// Number of contributors processed in this phase.
+      PerfCounters::Sample M_delta;
+    };
+
+  private:
+    PerfCounters const& M_counters;
+    std::vector<Phase> M_phases;
+
+  public:
+    PerfReport(PerfCounters const& counters) : M_counters(counters) { }
+
+    PerfCounters const& counters(void) const { return M_counters; }
+    void add_phase(std::string const& name, std::string const& target, unsigned long contributors,
+                   PerfCounters::Sample const& start, PerfCounters::Sample const& end);
+
+    void print_on(std::ostream& os) const;
+};
+
+#endif // PERFCOUNTERS_H
@@ -0,0 +1,470 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file QueryIndex.cc Implementation of class QueryIndex.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <vector>
+#include <unistd.h>
+#include "debug.h"
+#endif
+
+#include "QueryIndex.h"
+#include "AsyncIO.h"
+#include "ColumnarFormat.h"
+#include "ContentHash.h"
+#include "ContributionsTxt.h"
+#include "ContributorBlocks.h"
+#include "FullName.h"
+#include "ostream_operators.h"
+#include "Trace.h"
+#include <boost/algorithm/string/predicate.hpp>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+namespace {
+
+// The layout of an index, in native byte order:
+//
+//   IndexHeader
+//   uint64_t block_hashes[M_contributors]	(only if M_block_hashes is set)
+//   IndexKey keys[M_entries]
+//   char image[M_image_size]			(a columnar image of the source)
+
+uint32_t const index_magic = 0x434d4931;		// "CMI1" in native byte order; a foreign byte order doesn't match.
+uint32_t const index_version = 1;			// Increment whenever the layout changes.
+
+struct IndexHeader {
+  uint32_t M_magic;
+  uint32_t M_version;
+  uint32_t M_checksum;					// CRC-32 of everything after the header.
+  uint32_t M_block_hashes;				// Set if there is a hash of the lines of every contributor.
+  uint64_t M_size;					// Size of the whole index.
+  uint64_t M_contributors;
+  uint64_t M_entries;
+  uint64_t M_image_size;
+  // The source. The size and modification time are not covered by the checksum: they are
+  // updated in place when the source was touched without changing its contents.
+  uint64_t M_source_size;
+  int64_t M_source_mtime_sec;
+  int64_t M_source_mtime_nsec;
+  unsigned char M_content_hash[20];			// content_hash() of the source.
+  uint32_t M_reserved;
+};
+
+struct IndexKey {
+  uint64_t M_key;					// Packed JIRA key (see ColumnarImage).
+  uint32_t M_contributor;
+  uint32_t M_entry;
+
+  friend bool operator<(IndexKey const& k1, IndexKey const& k2)
+  {
+    if (k1.M_key != k2.M_key)
+      return k1.M_key < k2.M_key;
+    return k1.M_contributor != k2.M_contributor ? k1.M_contributor < k2.M_contributor : k1.M_entry < k2.M_entry;
+  }
+};
+
+struct KeyLess
+{
+  bool operator()(IndexKey const& k, uint64_t key) const { return k.M_key < key; }
+};
+
+IndexHeader const& header(unsigned char const* data) { return *reinterpret_cast<IndexHeader const*>(data); }
+
+uint64_t const* block_hashes(unsigned char const* data)
+{
+  return reinterpret_cast<uint64_t const*>(data + sizeof(IndexHeader));
+}
+
+IndexKey const* keys(unsigned char const* data)
+{
+  return reinterpret_cast<IndexKey const*>(block_hashes(data) + (header(data).M_block_hashes ? header(data).M_contributors : 0));
+}
+
+char const* image(unsigned char const* data)
+{
+  return reinterpret_cast<char const*>(keys(data) + header(data).M_entries);
+}
+
+int64_t mtime_nsec(struct stat const& buf)
+{
+#ifdef __linux__
+  return buf.st_mtim.tv_nsec;
+#else
+  return 0;
+#endif
+}
+
+// The hash of the lines of one contributor: both checksums of zlib, which are much cheaper than content_hash.
+uint64_t block_hash(char const* data, size_t size)
+{
+  Bytef const* const bytes = reinterpret_cast<Bytef const*>(data);
+  return (uint64_t)crc32(crc32(0L, Z_NULL, 0), bytes, size) << 32 | adler32(adler32(0L, Z_NULL, 0), bytes, size);
+}
+
+// Add contributor c of old_image, with the lines raw, to contributions_txt.
+void copy_contributor(ColumnarImage const& old_image, uint32_t c, std::string const& full_name,
+    char const* raw, size_t raw_size, ContributionsTxt& contributions_txt)
+{
+  Contributions& contributions(contributions_txt.add_contributor(full_name));
+  for (uint32_t n = 0; n < old_image.end_entry(c) - old_image.first_entry(c); ++n)
+  {
+    uint32_t const e = old_image.text_entry(c, n);
+    boost::string_ref const comment(old_image.comment(e));
+    contributions.add_entry(ContributionEntry(
+        JiraProjectKey(old_image.prefix(old_image.key(e)).to_string(), ColumnarImage::issue_number(old_image.key(e))),
+        comment.data(), comment.size()));
+  }
+  contributions.assign_raw_string(raw, raw_size);
+}
+
+// Parse the lines of one contributor and add them to contributions_txt.
+void parse_contributor(char const* raw, size_t raw_size, ContributionsTxt& contributions_txt) throw(ParseError)
+{
+  std::string text("\n");				// Empty header.
+  text.append(raw, raw_size);
+  ContributionsTxt document("index", text);
+  Contributor const& contributor(*document.contributors().begin());
+  contributions_txt.add_contributor(contributor.first.full_name().str(), contributor.second);
+}
+
+// Write the index of text, the contents of source, to index. Reuse the contributors of old_data
+// (an index of an earlier version of source, or NULL) whose lines didn't change.
+// Returns true if not every contributor had to be parsed.
+bool build_index(std::string const& source, std::string const& text, struct stat const& info,
+    unsigned char const* old_data, ColumnarImage const* old_image, std::string& index) throw(ParseError, FormatError)
+{
+  TraceSpan span("build index", source.c_str());
+  ContributionsTxt contributions_txt;
+
+  // Find the contributor blocks; they can only be hashed (and reused) if they're sorted.
+  std::vector<ContributorBlock> blocks;
+  std::vector<uint64_t> hashes;
+  size_t header_length = 0;
+  if (!ColumnarImage::is_columnar(text.data(), text.size()))
+  {
+    TraceSpan span("hash blocks");
+    SortedContributorBlockReader reader(text.data(), text.size());
+    ContributorBlock block;
+    while (reader.next(block))
+    {
+      blocks.push_back(block);
+      hashes.push_back(block_hash(text.data() + block.M_offset, block.M_length));
+    }
+    header_length = reader.header_length();
+    if (!reader.valid())
+    {
+      blocks.clear();
+      hashes.clear();
+    }
+  }
+
+  bool const reuse = old_data && header(old_data).M_block_hashes && !blocks.empty();
+  size_t reused = 0;
+  if (reuse)
+  {
+    // Walk the old contributors side by side with the blocks; both are in the order of FullName::Compare.
+    TraceSpan span("reuse contributors");
+    contributions_txt = Header(text.substr(0, header_length));
+    uint64_t const* const old_hashes = block_hashes(old_data);
+    uint32_t const old_contributors = old_image->contributors();
+    uint32_t c = 0;
+    FullName::Compare compare;
+    for (size_t b = 0; b < blocks.size(); ++b)
+    {
+      char const* raw = text.data() + blocks[b].M_offset;
+      std::string const& full_name(blocks[b].M_full_name);
+      while (c < old_contributors && compare(old_image->name(c).to_string(), full_name))
+	++c;
+      if (c < old_contributors && old_hashes[c] == hashes[b] && old_image->name(c) == full_name)
+      {
+	copy_contributor(*old_image, c, full_name, raw, blocks[b].M_length, contributions_txt);
+	++reused;
+      }
+      else
+	parse_contributor(raw, blocks[b].M_length, contributions_txt);
+    }
+  }
+  else if (ColumnarImage::is_columnar(text.data(), text.size()))
+  {
+    ColumnarImage columnar(text.data(), text.size());
+    if (!columnar.validate())
+      throw FormatError("Corrupt columnar image: " + source);
+    columnar.to_contributions_txt(contributions_txt);
+  }
+  else
+    contributions_txt.parse(source, text);
+
+  std::ostringstream columnar;
+  write_columnar(contributions_txt, columnar);
+  std::string const image_data(columnar.str());
+  ColumnarImage const image(image_data.data(), image_data.size());
+
+  std::vector<IndexKey> index_keys;
+  index_keys.reserve(image.entries());
+  for (uint32_t c = 0; c < image.contributors(); ++c)
+    for (uint32_t e = image.first_entry(c); e < image.end_entry(c); ++e)
+    {
+      IndexKey key;
+      key.M_key = image.key(e);
+      key.M_contributor = c;
+      key.M_entry = e;
+      index_keys.push_back(key);
+    }
+  std::sort(index_keys.begin(), index_keys.end());
+
+  IndexHeader index_header;
+  std::memset(&index_header, 0, sizeof(index_header));
+  index_header.M_magic = index_magic;
+  index_header.M_version = index_version;
+  index_header.M_block_hashes = !hashes.empty() && hashes.size() == image.contributors();
+  index_header.M_contributors = image.contributors();
+  index_header.M_entries = image.entries();
+  index_header.M_image_size = image_data.size();
+  index_header.M_source_size = info.st_size;
+  index_header.M_source_mtime_sec = info.st_mtime;
+  index_header.M_source_mtime_nsec = mtime_nsec(info);
+  std::string const hash(content_hash(text));
+  std::memcpy(index_header.M_content_hash, hash.data(), sizeof(index_header.M_content_hash));
+
+  index.assign(reinterpret_cast<char const*>(&index_header), sizeof(index_header));
+  if (index_header.M_block_hashes)
+    index.append(reinterpret_cast<char const*>(&hashes[0]), hashes.size() * sizeof(uint64_t));
+  if (!index_keys.empty())
+    index.append(reinterpret_cast<char const*>(&index_keys[0]), index_keys.size() * sizeof(IndexKey));
+  index += image_data;
+  IndexHeader& written_header(*reinterpret_cast<IndexHeader*>(&index[0]));
+  written_header.M_size = index.size();
+  written_header.M_checksum =
+      crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<unsigned char const*>(index.data()) + sizeof(IndexHeader), index.size() - sizeof(IndexHeader));
+  return reused > 0;
+}
+
+} // namespace
+
+QueryIndex::QueryIndex(void) : M_data(NULL), M_size(0), M_mapped(false)
+{
+}
+
+QueryIndex::~QueryIndex()
+{
+  unmap();
+}
+
+void QueryIndex::unmap(void)
+{
+  M_image.reset();
+  if (M_mapped)
+    munmap(const_cast<unsigned char*>(M_data), M_size);
+  M_data = NULL;
+  M_size = 0;
+  M_mapped = false;
+}
+
+bool QueryIndex::map(std::string const& index_filename)
+{
+  TraceSpan span("map index", index_filename.c_str());
+  int fd = ::open(index_filename.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+  struct stat buf;
+  void* addr = MAP_FAILED;
+  if (fstat(fd, &buf) == 0 && (size_t)buf.st_size >= sizeof(IndexHeader))
+    addr = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    return false;
+  M_data = static_cast<unsigned char const*>(addr);
+  M_size = buf.st_size;
+  M_mapped = true;
+  return true;
+}
+
+// Check the header and the sizes of the index, and also the checksum if with_checksum is set
+// (that reads the whole index, which a query otherwise doesn't).
+bool QueryIndex::check(bool with_checksum) throw()
+{
+  IndexHeader const& index_header(header(M_data));
+  uint64_t const hashes_size = index_header.M_block_hashes ? index_header.M_contributors * sizeof(uint64_t) : 0;
+  if (index_header.M_magic != index_magic || index_header.M_version != index_version || index_header.M_size != M_size ||
+      index_header.M_contributors > M_size || index_header.M_entries > M_size || index_header.M_image_size > M_size ||
+      sizeof(IndexHeader) + hashes_size + index_header.M_entries * sizeof(IndexKey) + index_header.M_image_size != M_size)
+    return false;
+  if (with_checksum &&
+      crc32(crc32(0L, Z_NULL, 0), M_data + sizeof(IndexHeader), M_size - sizeof(IndexHeader)) != index_header.M_checksum)
+    return false;
+  try
+  {
+    M_image.reset(new ColumnarImage(image(M_data), index_header.M_image_size));
+  }
+  catch (FormatError&)
+  {
+    return false;
+  }
+  return M_image->contributors() == index_header.M_contributors && M_image->entries() == index_header.M_entries &&
+         (!with_checksum || M_image->validate());
+}
+
+QueryIndex::status_type QueryIndex::open(std::string const& source, std::string const& index_filename) throw(ParseError, FormatError, ReadError)
+{
+  TraceSpan span("open index", index_filename.c_str());
+  unmap();
+  struct stat info;
+  if (stat(source.c_str(), &info) != 0)
+    throw FormatError("Cannot stat \"" + source + "\"");
+
+  bool const have_index = map(index_filename) && check(false);
+  if (have_index)
+  {
+    IndexHeader const& index_header(header(M_data));
+    if (index_header.M_source_size == (uint64_t)info.st_size &&
+        index_header.M_source_mtime_sec == (int64_t)info.st_mtime && index_header.M_source_mtime_nsec == mtime_nsec(info))
+      return up_to_date;
+  }
+
+  std::string text;
+  ContributionsTxt::read_file(source, text);
+  std::string const hash(content_hash(text));
+  status_type status = built;
+  if (have_index && std::memcmp(header(M_data).M_content_hash, hash.data(), hash.size()) == 0)
+  {
+    // Only touched: store the new size and modification time.
+    M_built.assign(reinterpret_cast<char const*>(M_data), M_size);
+    IndexHeader& index_header(*reinterpret_cast<IndexHeader*>(&M_built[0]));
+    index_header.M_source_size = info.st_size;
+    index_header.M_source_mtime_sec = info.st_mtime;
+    index_header.M_source_mtime_nsec = mtime_nsec(info);
+    status = restamped;
+  }
+  else
+  {
+    std::string index;
+    bool const old_valid = have_index && check(true);
+    if (build_index(source, text, info, old_valid ? M_data : NULL, old_valid ? M_image.get() : NULL, index))
+      status = updated;
+    M_built.swap(index);
+  }
+  unmap();
+  M_data = reinterpret_cast<unsigned char const*>(M_built.data());
+  M_size = M_built.size();
+  if (!check(false))
+    throw FormatError("Cannot index \"" + source + "\"");
+  // Failure to write is not fatal: the index is only an optimization.
+  write_file(index_filename, M_built);
+  return status;
+}
+
+// The packed key of the JIRA key or prefix key, or the first packed key after it if it doesn't exist;
+// or if upper is set, the first packed key after all keys starting with key.
+uint64_t QueryIndex::lower_bound(std::string const& key, bool upper) const throw(FormatError)
+{
+  // Split "VWR-123" into the prefix "VWR" and issue number 123; "STORM" or "STORM-" is a prefix only.
+  std::string prefix(key);
+  uint64_t issue_number = 0;
+  bool has_issue_number = false;
+  std::string::size_type dash = key.rfind('-');
+  if (dash != std::string::npos && key.find_first_not_of("0123456789", dash + 1) == std::string::npos)
+  {
+    prefix = key.substr(0, dash);
+    if (dash + 1 < key.size())
+    {
+      if (key.size() - dash - 1 > 10 || (issue_number = std::strtoul(key.c_str() + dash + 1, NULL, 10)) > 0xffffffff)
+	throw FormatError("Issue number too large: " + key);
+      has_issue_number = true;
+    }
+  }
+  if (prefix.empty())
+    throw FormatError("Not a JIRA key: " + key);
+  // The prefixes of the image are sorted.
+  uint32_t begin = 0, end = M_image->prefixes();
+  while (begin < end)
+  {
+    uint32_t middle = begin + (end - begin) / 2;
+    if (M_image->prefix((uint64_t)middle << 32).compare(prefix) < 0)
+      begin = middle + 1;
+    else
+      end = middle;
+  }
+  uint64_t const packed_prefix = (uint64_t)begin << 32;
+  if (begin == M_image->prefixes() || M_image->prefix(packed_prefix) != prefix)
+    return packed_prefix;				// No such prefix: the keys of the next one.
+  if (!has_issue_number)
+    return upper ? packed_prefix + ((uint64_t)1 << 32) : packed_prefix;
+  return packed_prefix + issue_number + (upper ? 1 : 0);
+}
+
+unsigned long QueryIndex::print_keys(std::string const& query, std::ostream& os) const throw(FormatError)
+{
+  TraceSpan span("query keys", query.c_str());
+  std::string::size_type dots = query.find("..");
+  uint64_t const first = lower_bound(query.substr(0, dots), false);
+  uint64_t const last = lower_bound(dots == std::string::npos ? query : query.substr(dots + 2), true);
+  IndexHeader const& index_header(header(M_data));
+  IndexKey const* const begin = keys(M_data);
+  IndexKey const* const end = begin + index_header.M_entries;
+  unsigned long count = 0;
+  for (IndexKey const* key = std::lower_bound(begin, end, first, KeyLess()); key != end && key->M_key < last; ++key)
+  {
+    if (key->M_contributor >= index_header.M_contributors || key->M_entry >= index_header.M_entries)
+      throw FormatError("Corrupt index");
+    os << M_image->name(key->M_contributor) << '\t' << M_image->prefix(key->M_key);
+    if (ColumnarImage::issue_number(key->M_key))
+      os << '-' << ColumnarImage::issue_number(key->M_key);
+    os << M_image->comment(key->M_entry) << '\n';
+    ++count;
+  }
+  return count;
+}
+
+unsigned long QueryIndex::print_name(std::string const& full_name, std::ostream& os) const
+{
+  TraceSpan span("query name", full_name.c_str());
+  // The contributors are in the order of FullName::Compare, which is case insensitive
+  // except between names that only differ in case: find the first of those.
+  uint32_t begin = 0, end = M_image->contributors();
+  while (begin < end)
+  {
+    uint32_t middle = begin + (end - begin) / 2;
+    if (boost::algorithm::ilexicographical_compare(M_image->name(middle).to_string(), full_name))
+      begin = middle + 1;
+    else
+      end = middle;
+  }
+  unsigned long count = 0;
+  for (uint32_t c = begin; c < M_image->contributors() && boost::algorithm::iequals(M_image->name(c).to_string(), full_name); ++c)
+  {
+    os << M_image->name(c) << '\n';
+    for (uint32_t e = M_image->first_entry(c); e < M_image->end_entry(c); ++e)
+    {
+      os << '\t' << M_image->prefix(M_image->key(e));
+      if (ColumnarImage::issue_number(M_image->key(e)))
+	os << '-' << ColumnarImage::issue_number(M_image->key(e));
+      os << M_image->comment(e) << '\n';
+    }
+    ++count;
+  }
+  return count;
+}
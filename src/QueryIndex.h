@@ -0,0 +1,87 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file QueryIndex.h Declaration of class QueryIndex.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef QUERYINDEX_H
+#define QUERYINDEX_H
+
+#include <iosfwd>
+#include <string>
+#include <stddef.h>
+#include <stdint.h>
+#include <boost/scoped_ptr.hpp>
+#include "exceptions.h"
+
+class ColumnarImage;
+
+// contribmerge --query: a sidecar file next to a contributions.txt with everything needed to answer
+// "who is credited for VWR-24487?" without parsing it.
+//
+// The index holds a columnar image of the source (see ColumnarFormat.h), whose contributors are
+// in the order of FullName::Compare and therefore double as a case insensitive name index, plus
+// a reverse index: every (packed JIRA key, contributor, entry) sorted by key, so that a key or a
+// range of keys is found with a binary search in the mapped file.
+//
+// The index stores the content hash of the source, and its size and modification time as a
+// shortcut. When the source changed, only the contributors whose lines changed are parsed again:
+// the index also stores a hash of the lines of every contributor.
+class QueryIndex
+{
+  public:
+    enum status_type {
+      up_to_date,		// Size and modification time of the source match.
+      restamped,		// The source was touched, but the contents didn't change.
+      updated,			// The contributors that changed were parsed again.
+      built			// The whole source was parsed.
+    };
+
+  private:
+    unsigned char const* M_data;
+    size_t M_size;
+    bool M_mapped;				// True if M_data was mmapped by us.
+    std::string M_built;			// The index, if it was (re)built by us.
+    boost::scoped_ptr<ColumnarImage> M_image;
+
+  public:
+    QueryIndex(void);
+    ~QueryIndex();
+
+    // Open the index index_filename of the source, which is written first if it doesn't exist or is out of date.
+    status_type open(std::string const& source, std::string const& index_filename) throw(ParseError, FormatError, ReadError);
+
+    // Print the entries with a JIRA key in the range described by query, one per line as
+    // "<full name><tab><entry>", sorted by key. Query is a key ("VWR-24487"), a prefix ("STORM")
+    // or an inclusive range of those ("VWR-100..VWR-200"). Returns the number of lines printed.
+    unsigned long print_keys(std::string const& query, std::ostream& os) const throw(FormatError);
+
+    // Print the contributors with the given full name, ignoring case, as they would be written.
+    // Returns the number of contributors printed.
+    unsigned long print_name(std::string const& full_name, std::ostream& os) const;
+
+  private:
+    void unmap(void);
+    bool map(std::string const& index_filename);
+    bool check(bool with_checksum) throw();
+    uint64_t lower_bound(std::string const& key, bool upper) const throw(FormatError);
+
+  private:
+    QueryIndex(QueryIndex const&);
+    QueryIndex& operator=(QueryIndex const&);
+};
+
+#endif // QUERYINDEX_H
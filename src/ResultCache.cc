@@ -0,0 +1,171 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ResultCache.cc Implementation of class ResultCache.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include <unistd.h>
+#include "debug.h"
+#endif
+
+#include "ResultCache.h"
+#include "AsyncIO.h"
+#include "ContentHash.h"
+#include "Trace.h"
+#include <dirent.h>
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <zlib.h>
+
+namespace {
+
+// The layout of a result file, in native byte order:
+//
+//   ResultHeader
+//   char output[M_output_size]
+//   char diagnostics[M_diagnostics_size]
+
+char const result_magic[8] = { 'C', 'M', 'R', 'E', 'S', 'U', 'L', 'T' };
+uint32_t const result_version = 1;			// Increment whenever the layout changes.
+
+struct ResultHeader {
+  char M_magic[8];
+  uint32_t M_version;
+  int32_t M_status;
+  uint32_t M_has_output;
+  uint32_t M_checksum;					// CRC-32 of everything after the header.
+  uint64_t M_output_size;
+  uint64_t M_diagnostics_size;
+};
+
+char const* const suffix = ".result";
+
+struct CacheFile {
+  time_t M_mtime;
+  off_t M_size;
+  std::string M_name;
+
+  friend bool operator<(CacheFile const& f1, CacheFile const& f2) { return f1.M_mtime < f2.M_mtime; }
+};
+
+} // namespace
+
+std::string ResultCache::key(std::string const& options, std::string const& base, std::string const& left, std::string const& right)
+{
+  std::string data(executable_identity());
+  data += '\0';
+  data += options;
+  data += '\0';
+  data += content_hash(base);
+  data += content_hash(left);
+  data += content_hash(right);
+  return content_hash(data);
+}
+
+std::string ResultCache::filename(std::string const& key) const
+{
+  return M_directory + '/' + to_hex(key) + suffix;
+}
+
+bool ResultCache::load(std::string const& key, Result& result) const
+{
+  std::string const name(filename(key));
+  TraceSpan span("result cache load", name.c_str());
+  FILE* file = std::fopen(name.c_str(), "rb");
+  if (!file)
+    return false;
+  ResultHeader header;
+  bool valid = std::fread(&header, sizeof(header), 1, file) == 1 &&
+               std::memcmp(header.M_magic, result_magic, sizeof(result_magic)) == 0 && header.M_version == result_version &&
+               header.M_output_size <= (1ULL << 32) && header.M_diagnostics_size <= (1ULL << 32);
+  std::string data;
+  if (valid)
+  {
+    data.resize(header.M_output_size + header.M_diagnostics_size);
+    valid = (data.empty() || std::fread(&data[0], data.size(), 1, file) == 1) && std::fgetc(file) == EOF &&
+            crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<unsigned char const*>(data.data()), data.size()) == header.M_checksum;
+  }
+  std::fclose(file);
+  if (!valid)
+    return false;
+  result.M_status = header.M_status;
+  result.M_has_output = header.M_has_output;
+  result.M_output.assign(data, 0, header.M_output_size);
+  result.M_diagnostics.assign(data, header.M_output_size, std::string::npos);
+  // Mark it as recently used.
+  utimes(name.c_str(), NULL);
+  return true;
+}
+
+void ResultCache::store(std::string const& key, Result const& result) const
+{
+  std::string const name(filename(key));
+  TraceSpan span("result cache store", name.c_str());
+  ResultHeader header;
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.M_magic, result_magic, sizeof(result_magic));
+  header.M_version = result_version;
+  header.M_status = result.M_status;
+  header.M_has_output = result.M_has_output;
+  header.M_output_size = result.M_output.size();
+  header.M_diagnostics_size = result.M_diagnostics.size();
+  std::string data(result.M_output + result.M_diagnostics);
+  header.M_checksum = crc32(crc32(0L, Z_NULL, 0), reinterpret_cast<unsigned char const*>(data.data()), data.size());
+
+  // Concurrent readers never see a partial result: see write_file.
+  mkdir(M_directory.c_str(), 0777);
+  if (write_file(name, std::string(reinterpret_cast<char const*>(&header), sizeof(header)) + data, false))
+    evict();
+}
+
+void ResultCache::evict(void) const
+{
+  DIR* dir = opendir(M_directory.c_str());
+  if (!dir)
+    return;
+  std::vector<CacheFile> files;
+  unsigned long long total_size = 0;
+  size_t const suffix_length = std::strlen(suffix);
+  struct dirent* entry;
+  while ((entry = readdir(dir)))
+  {
+    CacheFile file;
+    file.M_name = entry->d_name;
+    struct stat buf;
+    if (file.M_name.size() <= suffix_length || file.M_name.compare(file.M_name.size() - suffix_length, suffix_length, suffix) != 0 ||
+        stat((M_directory + '/' + file.M_name).c_str(), &buf) != 0)
+      continue;
+    file.M_mtime = buf.st_mtime;
+    file.M_size = buf.st_size;
+    total_size += buf.st_size;
+    files.push_back(file);
+  }
+  closedir(dir);
+  if (total_size <= M_max_size)
+    return;
+  std::sort(files.begin(), files.end());
+  for (std::vector<CacheFile>::const_iterator file = files.begin(); file != files.end() && total_size > M_max_size; ++file)
+    if (unlink((M_directory + '/' + file->M_name).c_str()) == 0)
+      total_size -= file->M_size;
+}
@@ -0,0 +1,63 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file ResultCache.h Declaration of class ResultCache.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef RESULTCACHE_H
+#define RESULTCACHE_H
+
+#include <string>
+
+// A directory with finished merge results, keyed by the content hashes of base, left
+// and right, the identity of the contribmerge executable and the options that affect
+// the result. A hit gives the output bytes, the diagnostics and the exit status without
+// parsing or merging anything.
+//
+// The total size of the directory is kept below a maximum by removing the least
+// recently used results (a hit updates the modification time of its file).
+class ResultCache
+{
+  public:
+    struct Result {
+      int M_status;					// Exit status.
+      bool M_has_output;				// False if nothing was written (a merge failure).
+      std::string M_output;				// The bytes written to each destination.
+      std::string M_diagnostics;			// What was written to standard error.
+    };
+
+  private:
+    std::string M_directory;
+    unsigned long long M_max_size;			// In bytes.
+
+  public:
+    ResultCache(std::string const& directory, unsigned long long max_size) : M_directory(directory), M_max_size(max_size) { }
+
+    // The key of merging left and right with base, where options describes the options that affect the result.
+    static std::string key(std::string const& options, std::string const& base, std::string const& left, std::string const& right);
+
+    // Return true and fill result if the cache has a valid result for key.
+    bool load(std::string const& key, Result& result) const;
+
+    // Store result under key and evict old results. Failure to write is silently ignored.
+    void store(std::string const& key, Result const& result) const;
+
+  private:
+    std::string filename(std::string const& key) const;
+    void evict(void) const;
+};
+
+#endif // RESULTCACHE_H
@@ -0,0 +1,249 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file SnapshotCache.cc Implementation of class SnapshotCache.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <cstring>
+#include <map>
+#include <vector>
+#include <unistd.h>
+#include "debug.h"
+#endif
+
+#include "SnapshotCache.h"
+#include "AsyncIO.h"
+#include "ContentHash.h"
+#include "ContributionsTxt.h"
+#include "Trace.h"
+#include <fcntl.h>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+namespace {
+
+// The layout of an image, in native byte order:
+//
+//   ImageHeader
+//   ImageContributor[M_contributors]
+//   ImageEntry[M_entries]
+//   char strings[M_strings_size]
+//
+// All offsets of strings are relative to the start of the string table.
+
+uint32_t const image_magic = 0x434d5331;		// "CMS1" in native byte order; a foreign byte order doesn't match.
+uint32_t const image_version = 2;			// Increment whenever the layout changes.
+
+struct ImageHeader {
+  uint32_t M_magic;
+  uint32_t M_version;
+  uint32_t M_size;					// Size of the whole image.
+  uint32_t M_checksum;					// CRC-32 of the whole image, with this field zero.
+  unsigned char M_content_hash[20];			// content_hash() of the parsed text.
+  uint32_t M_header;					// The raw header text.
+  uint32_t M_header_size;
+  uint32_t M_contributors;
+  uint32_t M_entries;
+  uint32_t M_strings_size;
+};
+
+struct ImageContributor {
+  uint32_t M_name;
+  uint32_t M_name_size;
+  uint32_t M_raw;					// The raw block (including full name).
+  uint32_t M_raw_size;
+  uint32_t M_first_entry;				// Index into the ImageEntry array.
+  uint32_t M_entries;
+};
+
+struct ImageEntry {
+  uint32_t M_prefix;					// JIRA project key prefix.
+  uint32_t M_prefix_size;
+  int32_t M_issue_number;
+  uint32_t M_comment;
+  uint32_t M_comment_size;
+};
+
+// Builds the string table, sharing identical JIRA project key prefixes.
+class StringTable
+{
+  private:
+    std::string M_strings;
+    std::map<InternedString, uint32_t> M_prefixes;
+
+  public:
+    template<class String>
+    uint32_t add(String const& str)
+    {
+      uint32_t offset = M_strings.size();
+      M_strings.append(str.data(), str.size());
+      return offset;
+    }
+
+    uint32_t add_prefix(InternedString const& prefix)
+    {
+      std::map<InternedString, uint32_t>::iterator entry = M_prefixes.find(prefix);
+      if (entry != M_prefixes.end())
+	return entry->second;
+      return M_prefixes[prefix] = add(prefix);
+    }
+
+    std::string const& strings(void) const { return M_strings; }
+};
+
+bool in_range(uint32_t offset, uint32_t size, uint32_t limit)
+{
+  return offset <= limit && size <= limit - offset;
+}
+
+// The CRC-32 of the image of size bytes, taking its M_checksum as zero.
+uint32_t checksum(unsigned char const* image, size_t size)
+{
+  ImageHeader header(*reinterpret_cast<ImageHeader const*>(image));
+  header.M_checksum = 0;
+  uLong crc = crc32(0L, Z_NULL, 0);
+  crc = crc32(crc, reinterpret_cast<unsigned char const*>(&header), sizeof(ImageHeader));
+  return crc32(crc, image + sizeof(ImageHeader), size - sizeof(ImageHeader));
+}
+
+} // namespace
+
+// Images are specific to the executable that wrote them, like the results in a ResultCache.
+std::string SnapshotCache::filename(std::string const& hash) const
+{
+  std::string key(executable_identity());
+  key += '\0';
+  key += hash;
+  return M_directory + '/' + to_hex(content_hash(key)) + ".snapshot";
+}
+
+bool SnapshotCache::load(std::string const& hash, ContributionsTxt& contributions_txt) const
+{
+  std::string const name(filename(hash));
+  TraceSpan span("snapshot load", name.c_str());
+  int fd = open(name.c_str(), O_RDONLY);
+  if (fd == -1)
+    return false;
+  struct stat buf;
+  void* addr = MAP_FAILED;
+  if (fstat(fd, &buf) == 0 && (size_t)buf.st_size >= sizeof(ImageHeader))
+    addr = mmap(NULL, buf.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  close(fd);
+  if (addr == MAP_FAILED)
+    return false;
+  size_t const size = buf.st_size;
+  unsigned char const* const image = static_cast<unsigned char const*>(addr);
+  ImageHeader const& header(*reinterpret_cast<ImageHeader const*>(image));
+
+  // Validate everything before touching contributions_txt.
+  size_t const tables_size = sizeof(ImageHeader) + (size_t)header.M_contributors * sizeof(ImageContributor) +
+                             (size_t)header.M_entries * sizeof(ImageEntry);
+  bool valid = header.M_magic == image_magic && header.M_version == image_version && header.M_size == size &&
+               std::memcmp(header.M_content_hash, hash.data(), sizeof(header.M_content_hash)) == 0 &&
+               header.M_contributors <= size / sizeof(ImageContributor) && header.M_entries <= size / sizeof(ImageEntry) &&
+               tables_size <= size && size - tables_size == header.M_strings_size &&
+               checksum(image, size) == header.M_checksum &&
+               in_range(header.M_header, header.M_header_size, header.M_strings_size);
+  ImageContributor const* const contributors = reinterpret_cast<ImageContributor const*>(image + sizeof(ImageHeader));
+  ImageEntry const* const entries = reinterpret_cast<ImageEntry const*>(contributors + header.M_contributors);
+  char const* const strings = reinterpret_cast<char const*>(entries + header.M_entries);
+  for (uint32_t c = 0; valid && c < header.M_contributors; ++c)
+    valid = in_range(contributors[c].M_name, contributors[c].M_name_size, header.M_strings_size) &&
+            in_range(contributors[c].M_raw, contributors[c].M_raw_size, header.M_strings_size) &&
+            in_range(contributors[c].M_first_entry, contributors[c].M_entries, header.M_entries);
+  for (uint32_t e = 0; valid && e < header.M_entries; ++e)
+    valid = in_range(entries[e].M_prefix, entries[e].M_prefix_size, header.M_strings_size) &&
+            in_range(entries[e].M_comment, entries[e].M_comment_size, header.M_strings_size);
+
+  if (valid)
+  {
+    contributions_txt = Header(std::string(strings + header.M_header, header.M_header_size));
+    for (uint32_t c = 0; c < header.M_contributors; ++c)
+    {
+      ImageContributor const& contributor(contributors[c]);
+      Contributions& contributions(contributions_txt.add_contributor(std::string(strings + contributor.M_name, contributor.M_name_size)));
+      contributions.assign_raw_string(strings + contributor.M_raw, contributor.M_raw_size);
+      for (ImageEntry const* entry = entries + contributor.M_first_entry; entry != entries + contributor.M_first_entry + contributor.M_entries; ++entry)
+	contributions.add_entry(ContributionEntry(
+	    JiraProjectKey(std::string(strings + entry->M_prefix, entry->M_prefix_size), entry->M_issue_number),
+	    strings + entry->M_comment, entry->M_comment_size));
+    }
+  }
+  munmap(addr, size);
+  return valid;
+}
+
+void SnapshotCache::store(std::string const& hash, ContributionsTxt const& contributions_txt) const
+{
+  std::string const name(filename(hash));
+  TraceSpan span("snapshot store", name.c_str());
+
+  StringTable strings;
+  std::vector<ImageContributor> contributors;
+  std::vector<ImageEntry> entries;
+  ImageHeader header;
+  std::memset(&header, 0, sizeof(header));
+  header.M_magic = image_magic;
+  header.M_version = image_version;
+  std::memcpy(header.M_content_hash, hash.data(), sizeof(header.M_content_hash));
+  header.M_header_size = contributions_txt.header().as_string().size();
+  header.M_header = strings.add(contributions_txt.header().as_string());
+  contributors.reserve(contributions_txt.contributors().size());
+  for (ContributionsTxt::contributors_map::const_iterator contributor = contributions_txt.contributors().begin();
+       contributor != contributions_txt.contributors().end(); ++contributor)
+  {
+    ImageContributor image_contributor;
+    image_contributor.M_name_size = contributor->first.full_name().size();
+    image_contributor.M_name = strings.add(contributor->first.full_name());
+    image_contributor.M_raw_size = contributor->second.raw_string().size();
+    image_contributor.M_raw = strings.add(contributor->second.raw_string());
+    image_contributor.M_first_entry = entries.size();
+    image_contributor.M_entries = contributor->second.contributions().size();
+    for (Contributions::contributions_type::const_iterator entry = contributor->second.contributions().begin();
+         entry != contributor->second.contributions().end(); ++entry)
+    {
+      ImageEntry image_entry;
+      image_entry.M_prefix_size = entry->jira_project_key().jira_project_key_prefix().size();
+      image_entry.M_prefix = strings.add_prefix(entry->jira_project_key().jira_project_key_prefix());
+      image_entry.M_issue_number = entry->jira_project_key().issue_number();
+      image_entry.M_comment_size = entry->comment().size();
+      image_entry.M_comment = strings.add(entry->comment());
+      entries.push_back(image_entry);
+    }
+    contributors.push_back(image_contributor);
+  }
+  header.M_contributors = contributors.size();
+  header.M_entries = entries.size();
+  header.M_strings_size = strings.strings().size();
+
+  std::string image(reinterpret_cast<char const*>(&header), sizeof(header));
+  if (!contributors.empty())
+    image.append(reinterpret_cast<char const*>(&contributors[0]), contributors.size() * sizeof(ImageContributor));
+  if (!entries.empty())
+    image.append(reinterpret_cast<char const*>(&entries[0]), entries.size() * sizeof(ImageEntry));
+  image += strings.strings();
+  ImageHeader& image_header(*reinterpret_cast<ImageHeader*>(&image[0]));
+  image_header.M_size = image.size();
+  image_header.M_checksum = checksum(reinterpret_cast<unsigned char const*>(image.data()), image.size());
+
+  // Concurrent readers never see a partial image: see write_file.
+  mkdir(M_directory.c_str(), 0777);
+  write_file(name, image, false);
+}
@@ -0,0 +1,56 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file SnapshotCache.h Declaration of class SnapshotCache.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef SNAPSHOTCACHE_H
+#define SNAPSHOTCACHE_H
+
+#include <string>
+
+class ContributionsTxt;
+
+// A directory with binary images of parsed documents, keyed by the content hash of the text
+// and executable_identity().
+//
+// An image holds the header, the contributor names, raw blocks, JIRA keys and comments
+// as fixed size records with offsets into a string table. Loading one is a single mmap
+// and a memcpy per string into the arena of the document, instead of running the grammar.
+//
+// The image also stores its own size, the content hash it was made from, a format version
+// and a CRC-32 of all of it, header included; an image that doesn't match in any way is ignored.
+class SnapshotCache
+{
+  private:
+    std::string M_directory;
+
+  public:
+    explicit SnapshotCache(std::string const& directory) : M_directory(directory) { }
+
+    // Fill the empty document contributions_txt from the image for content hash hash.
+    // Returns false if there is no valid image.
+    bool load(std::string const& hash, ContributionsTxt& contributions_txt) const;
+
+    // Store an image of contributions_txt, the parsed text with content hash hash.
+    // Failure to write is silently ignored: the cache is only an optimization.
+    void store(std::string const& hash, ContributionsTxt const& contributions_txt) const;
+
+  private:
+    std::string filename(std::string const& hash) const;
+};
+
+#endif // SNAPSHOTCACHE_H
@@ -0,0 +1,198 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Statistics.cc Implementation of class Statistics.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <iostream>
+#include <iomanip>
+#include "debug.h"
+#endif
+
+#include "Statistics.h"
+#include "ContributionsTxt.h"
+#include "InternedString.h"
+#include "json.h"
+
+namespace {
+
+double elapsed_ms(clockid_t clock_id, struct timespec const& start)
+{
+  struct timespec now;
+  clock_gettime(clock_id, &now);
+  return (now.tv_sec - start.tv_sec) * 1000.0 + (now.tv_nsec - start.tv_nsec) / 1000000.0;
+}
+
+void print_rules_on(std::ostream& os, char const* title, MergeStatistics const& rules)
+{
+  os << "  " << title << ":\n"
+     << "    skip base:     " << rules.M_skip_base << '\n'
+     << "    take left:     " << rules.M_take_left << '\n'
+     << "    take right:    " << rules.M_take_right << '\n'
+     << "    Case A:        " << rules.M_case_A << '\n'
+     << "    Case B:        " << rules.M_case_B << '\n'
+     << "    Case C:        " << rules.M_case_C << '\n'
+     << "    Case D:        " << rules.M_case_D << '\n'
+     << "    payload merge: " << rules.M_payload_merge << '\n';
+}
+
+void print_rules_json_on(std::ostream& os, MergeStatistics const& rules)
+{
+  os << "{\"skip_base\": " << rules.M_skip_base
+     << ", \"take_left\": " << rules.M_take_left
+     << ", \"take_right\": " << rules.M_take_right
+     << ", \"case_A\": " << rules.M_case_A
+     << ", \"case_B\": " << rules.M_case_B
+     << ", \"case_C\": " << rules.M_case_C
+     << ", \"case_D\": " << rules.M_case_D
+     << ", \"payload_merge\": " << rules.M_payload_merge << '}';
+}
+
+void print_allocations_on(std::ostream& os, std::string const& name, std::string const& target, AllocationCounters const& allocations)
+{
+  os << "  " << std::left << std::setw(14) << name << std::right
+     << std::setw(10) << allocations.M_allocations << std::setw(12) << allocations.M_allocated_bytes
+     << std::setw(10) << allocations.M_deallocations << std::setw(12) << allocations.M_freed_bytes
+     << std::setw(12) << allocations.M_peak_live_bytes;
+  if (!target.empty())
+    os << "  " << target;
+  os << '\n';
+}
+
+void print_allocations_json_on(std::ostream& os, AllocationCounters const& allocations)
+{
+  os << "{\"allocations\": " << allocations.M_allocations
+     << ", \"allocated_bytes\": " << allocations.M_allocated_bytes
+     << ", \"deallocations\": " << allocations.M_deallocations
+     << ", \"freed_bytes\": " << allocations.M_freed_bytes
+     << ", \"peak_live_bytes\": " << allocations.M_peak_live_bytes << '}';
+}
+
+} // namespace
+
+void PhaseTimer::start(void)
+{
+  clock_gettime(CLOCK_MONOTONIC, &M_wall_start);
+  clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &M_cpu_start);
+}
+
+double PhaseTimer::wall_ms(void) const
+{
+  return elapsed_ms(CLOCK_MONOTONIC, M_wall_start);
+}
+
+double PhaseTimer::cpu_ms(void) const
+{
+  return elapsed_ms(CLOCK_PROCESS_CPUTIME_ID, M_cpu_start);
+}
+
+void Statistics::add_phase(std::string const& name, std::string const& target, PhaseTimer const& timer,
+                           AllocationCounters const& allocations)
+{
+  Phase phase;
+  phase.M_wall_ms = timer.wall_ms();
+  phase.M_cpu_ms = timer.cpu_ms();
+  phase.M_allocations = allocations;
+  phase.M_name = name;
+  phase.M_target = target;
+  M_phases.push_back(phase);
+}
+
+void Statistics::add_input(std::string const& name, std::string const& filename, size_t bytes, ContributionsTxt const& contributions_txt)
+{
+  Input input;
+  input.M_name = name;
+  input.M_filename = filename;
+  input.M_bytes = bytes;
+  input.M_contributors = contributions_txt.contributors().size();
+  input.M_entries = 0;
+  for (ContributionsTxt::contributors_map::const_iterator contributor = contributions_txt.contributors().begin();
+       contributor != contributions_txt.contributors().end(); ++contributor)
+    input.M_entries += contributor->second.contributions().size();
+  M_inputs.push_back(input);
+}
+
+void Statistics::print_on(std::ostream& os) const
+{
+  os << "Phases (wall ms / cpu ms):\n";
+  for (std::vector<Phase>::const_iterator phase = M_phases.begin(); phase != M_phases.end(); ++phase)
+  {
+    os << "  " << std::left << std::setw(6) << phase->M_name << std::right
+       << std::fixed << std::setprecision(3) << std::setw(10) << phase->M_wall_ms << std::setw(10) << phase->M_cpu_ms;
+    if (!phase->M_target.empty())
+      os << "  " << phase->M_target;
+    os << '\n';
+  }
+  os << "Inputs (bytes / contributors / entries):\n";
+  for (std::vector<Input>::const_iterator input = M_inputs.begin(); input != M_inputs.end(); ++input)
+  {
+    os << "  " << std::left << std::setw(6) << input->M_name << std::right
+       << std::setw(10) << input->M_bytes << std::setw(8) << input->M_contributors << std::setw(8) << input->M_entries
+       << "  " << input->M_filename << '\n';
+  }
+  os << "Interned strings (count / bytes, shared by all inputs): " << InternedString::count() << " / " << InternedString::bytes() << '\n';
+  os << "Merge rules:\n";
+  print_rules_on(os, "contributors", M_contributor_rules);
+  print_rules_on(os, "entries", M_entry_rules);
+  if (AllocationMeter::enabled)
+  {
+    os << "Allocations (count / bytes / frees / freed bytes / peak live bytes):\n";
+    for (std::vector<Phase>::const_iterator phase = M_phases.begin(); phase != M_phases.end(); ++phase)
+      print_allocations_on(os, phase->M_name, phase->M_target, phase->M_allocations);
+    print_allocations_on(os, "merge payload", "", M_payload_allocations);
+  }
+}
+
+void Statistics::print_json_on(std::ostream& os) const
+{
+  os << "{\"phases\": [";
+  for (std::vector<Phase>::const_iterator phase = M_phases.begin(); phase != M_phases.end(); ++phase)
+  {
+    if (phase != M_phases.begin())
+      os << ", ";
+    os << "{\"name\": " << json_quote(phase->M_name) << ", \"target\": " << json_quote(phase->M_target)
+       << ", \"wall_ms\": " << std::fixed << std::setprecision(3) << phase->M_wall_ms << ", \"cpu_ms\": " << phase->M_cpu_ms;
+    if (AllocationMeter::enabled)
+    {
+      os << ", \"allocations\": ";
+      print_allocations_json_on(os, phase->M_allocations);
+    }
+    os << '}';
+  }
+  os << "], \"inputs\": [";
+  for (std::vector<Input>::const_iterator input = M_inputs.begin(); input != M_inputs.end(); ++input)
+  {
+    if (input != M_inputs.begin())
+      os << ", ";
+    os << "{\"name\": " << json_quote(input->M_name) << ", \"filename\": " << json_quote(input->M_filename)
+       << ", \"bytes\": " << input->M_bytes << ", \"contributors\": " << input->M_contributors
+       << ", \"entries\": " << input->M_entries << '}';
+  }
+  os << "], \"interned_strings\": {\"count\": " << InternedString::count() << ", \"bytes\": " << InternedString::bytes() << '}';
+  os << ", \"merge_rules\": {\"contributors\": ";
+  print_rules_json_on(os, M_contributor_rules);
+  os << ", \"entries\": ";
+  print_rules_json_on(os, M_entry_rules);
+  os << '}';
+  if (AllocationMeter::enabled)
+  {
+    os << ", \"payload_allocations\": ";
+    print_allocations_json_on(os, M_payload_allocations);
+  }
+  os << "}\n";
+}
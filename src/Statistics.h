@@ -0,0 +1,111 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Statistics.h Declaration of class Statistics.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef STATISTICS_H
+#define STATISTICS_H
+
+#include <string>
+#include <vector>
+#include <iosfwd>
+#include <time.h>
+#include "AllocationStatistics.h"
+
+class ContributionsTxt;
+
+// Counting Statistics policy for three_way_merge (see NoMergeStatistics in three_way_merge.h).
+struct MergeStatistics
+{
+  unsigned long M_skip_base;
+  unsigned long M_take_left;
+  unsigned long M_take_right;
+  unsigned long M_case_A;
+  unsigned long M_case_B;
+  unsigned long M_case_C;
+  unsigned long M_case_D;
+  unsigned long M_payload_merge;
+
+  MergeStatistics(void) : M_skip_base(0), M_take_left(0), M_take_right(0),
+      M_case_A(0), M_case_B(0), M_case_C(0), M_case_D(0), M_payload_merge(0) { }
+
+  void skip_base(void) { ++M_skip_base; }
+  void take_left(void) { ++M_take_left; }
+  void take_right(void) { ++M_take_right; }
+  void case_A(void) { ++M_case_A; }
+  void case_B(void) { ++M_case_B; }
+  void case_C(void) { ++M_case_C; }
+  void case_D(void) { ++M_case_D; }
+  void payload_merge(void) { ++M_payload_merge; }
+};
+
+// Measures wall clock and CPU time since construction (or the last call to start()).
+class PhaseTimer
+{
+  private:
+    struct timespec M_wall_start;
+    struct timespec M_cpu_start;
+
+  public:
+    PhaseTimer(void) { start(); }
+
+    void start(void);
+    double wall_ms(void) const;
+    double cpu_ms(void) const;
+};
+
+// Everything that is reported by --stats.
+class Statistics
+{
+  public:
+    struct Phase {
+      std::string M_name;				// "load", "merge" or "print".
+      std::string M_target;				// The file involved, if any.
+      double M_wall_ms;
+      double M_cpu_ms;
+      AllocationCounters M_allocations;		// Only when compiled with ALLOCATION_STATISTICS.
+    };
+
+    struct Input {
+      std::string M_name;				// "base", "left" or "right".
+      std::string M_filename;
+      unsigned long M_bytes;
+      unsigned long M_contributors;
+      unsigned long M_entries;
+    };
+
+  private:
+    std::vector<Phase> M_phases;
+    std::vector<Input> M_inputs;
+    MergeStatistics M_contributor_rules;		// three_way_merge of the contributors.
+    MergeStatistics M_entry_rules;			// three_way_merge of the entries of a single contributor.
+    AllocationCounters M_payload_allocations;		// Allocations done by ContributionsMerger (part of phase "merge").
+
+  public:
+    void add_phase(std::string const& name, std::string const& target, PhaseTimer const& timer,
+                   AllocationCounters const& allocations = AllocationCounters());
+    void add_input(std::string const& name, std::string const& filename, size_t bytes, ContributionsTxt const& contributions_txt);
+
+    MergeStatistics& contributor_rules(void) { return M_contributor_rules; }
+    MergeStatistics& entry_rules(void) { return M_entry_rules; }
+    AllocationCounters& payload_allocations(void) { return M_payload_allocations; }
+
+    void print_on(std::ostream& os) const;
+    void print_json_on(std::ostream& os) const;
+};
+
+#endif // STATISTICS_H
@@ -0,0 +1,112 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Trace.cc Implementation of class Trace.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+#include "debug.h"
+#endif
+
+#include "Trace.h"
+#include "json.h"
+
+bool Trace::S_enabled = false;
+Trace* Trace::S_instance = NULL;
+
+void Trace::start(std::string const& filename)
+{
+  if (S_instance)
+    return;
+  S_instance = new Trace(filename);
+  S_enabled = true;
+  std::atexit(&Trace::write_at_exit);
+}
+
+void Trace::write_at_exit(void)
+{
+  S_enabled = false;
+  S_instance->write();
+}
+
+double Trace::now_us(void)
+{
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return now.tv_sec * 1000000.0 + now.tv_nsec / 1000.0;
+}
+
+long Trace::thread_id(void)
+{
+  return syscall(SYS_gettid);
+}
+
+void Trace::add(Event const& event)
+{
+  boost::mutex::scoped_lock lock(S_instance->M_events_mutex);
+  S_instance->M_events.push_back(event);
+}
+
+void Trace::add(char const* name, std::string const& detail, double start_us)
+{
+  if (start_us < 0.0 || !S_enabled)
+    return;
+  Event event;
+  event.M_name = name;
+  event.M_detail = detail;
+  event.M_start_us = start_us;
+  event.M_duration_us = now_us() - start_us;
+  event.M_tid = thread_id();
+  add(event);
+}
+
+void Trace::write(void) const
+{
+  std::ofstream file(M_filename.c_str());
+  if (!file)
+  {
+    std::cerr << "Cannot write trace to \"" << M_filename << "\".\n";
+    return;
+  }
+  long const pid = getpid();
+  file << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  file << "{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << pid << ", \"tid\": " << pid <<
+      ", \"args\": {\"name\": \"contribmerge\"}}";
+  file << std::fixed << std::setprecision(3);
+  for (std::vector<Event>::const_iterator event = M_events.begin(); event != M_events.end(); ++event)
+  {
+    file << ",\n{\"name\": " << json_quote(event->M_name) << ", \"cat\": \"contribmerge\", \"ph\": \"X\""
+	", \"ts\": " << event->M_start_us << ", \"dur\": " << event->M_duration_us <<
+	", \"pid\": " << pid << ", \"tid\": " << event->M_tid;
+    if (!event->M_detail.empty())
+      file << ", \"args\": {\"detail\": " << json_quote(event->M_detail) << '}';
+    file << '}';
+  }
+  file << "\n]}\n";
+}
+
+void TraceSpan::end(void)
+{
+  Trace::add(M_name, M_detail ? M_detail : "", M_start_us);
+}
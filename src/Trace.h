@@ -0,0 +1,89 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file Trace.h Declaration of class Trace.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <string>
+#include <vector>
+#include <boost/thread/mutex.hpp>
+
+// Collects a timeline of spans and writes it as Chrome/Perfetto trace-event JSON
+// (load the file in chrome://tracing or https://ui.perfetto.dev).
+//
+// Tracing is process-wide and off by default; Trace::start() turns it on and
+// arranges for the file to be written when the process exits.
+class Trace
+{
+  public:
+    struct Event {
+      char const* M_name;				// Static string.
+      std::string M_detail;				// Optional argument, shown as args.detail.
+      double M_start_us;
+      double M_duration_us;
+      long M_tid;
+    };
+
+  private:
+    static bool S_enabled;
+    static Trace* S_instance;
+
+    std::string M_filename;
+    std::vector<Event> M_events;
+    boost::mutex M_events_mutex;
+
+    Trace(std::string const& filename) : M_filename(filename) { }
+    static void write_at_exit(void);
+
+  public:
+    // Start recording; the trace is written to filename at exit.
+    static void start(std::string const& filename);
+    static bool enabled(void) { return S_enabled; }
+
+    // Microseconds since an arbitrary fixed point (CLOCK_MONOTONIC).
+    static double now_us(void);
+    static long thread_id(void);
+
+    static void add(Event const& event);
+    // Add a span from start_us until now, if start_us is not negative (see TraceSpan).
+    static void add(char const* name, std::string const& detail, double start_us);
+    void write(void) const;
+};
+
+// Records the lifetime of the object as a span with the given name.
+// Does nothing (except testing a bool) when tracing is off; a span that
+// began before Trace::start() is not recorded.
+class TraceSpan
+{
+  private:
+    char const* M_name;
+    char const* M_detail;
+    double M_start_us;					// Negative if tracing was off when the span began.
+
+  public:
+    TraceSpan(char const* name) : M_name(name), M_detail(NULL), M_start_us(Trace::enabled() ? Trace::now_us() : -1.0) { }
+    // The detail string must outlive the span.
+    TraceSpan(char const* name, char const* detail) : M_name(name), M_detail(detail), M_start_us(Trace::enabled() ? Trace::now_us() : -1.0) { }
+    ~TraceSpan() { if (M_start_us >= 0.0 && Trace::enabled()) end(); }
+
+  private:
+    void end(void);
+};
+
+#endif // TRACE_H
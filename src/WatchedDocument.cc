@@ -0,0 +1,135 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file WatchedDocument.cc Implementation of class WatchedDocument.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <algorithm>
+#include "debug.h"
+#endif
+
+#include "WatchedDocument.h"
+#include "ColumnarFormat.h"
+#include "Trace.h"
+
+bool WatchedDocument::update(void) throw(ParseError, FormatError, ReadError)
+{
+  std::string buffer;
+  ContributionsTxt::read_file(M_filename, buffer);
+  if (M_document && buffer == M_buffer)
+    return false;
+  TraceSpan span("update", M_filename.c_str());
+  bool const parsed = M_document && parse_changes(buffer);
+  M_scratch.release();
+  if (!parsed)
+    parse_all(buffer);
+  return true;
+}
+
+void WatchedDocument::parse_all(std::string const& buffer) throw(ParseError, FormatError)
+{
+  M_document.reset();
+  M_blocks.clear();
+  M_reparsed = 0;
+  boost::scoped_ptr<ContributionsTxt> document(new ContributionsTxt);
+  M_binary = ColumnarImage::is_columnar(buffer.data(), buffer.size());
+  if (M_binary)
+  {
+    ColumnarImage image(buffer.data(), buffer.size());
+    if (!image.validate())
+      throw FormatError("Corrupt columnar image: " + M_filename);
+    image.to_contributions_txt(*document);
+  }
+  else
+  {
+    document->parse(M_filename, buffer);
+    if (!split_contributor_blocks(buffer, M_header_length, M_blocks) || M_blocks.size() != document->contributors().size())
+      M_blocks.clear();
+  }
+  M_buffer = buffer;
+  M_document.swap(document);
+}
+
+bool WatchedDocument::parse_changes(std::string const& buffer)
+{
+  if (M_binary || M_blocks.empty() || M_reparsed > M_buffer.size())
+    return false;
+  size_t header_length;
+  std::vector<ContributorBlock> blocks;
+  if (!split_contributor_blocks(buffer, header_length, blocks))
+    return false;
+
+  // The bytes that changed are those between the common prefix and the common suffix.
+  size_t const common = std::min(M_buffer.size(), buffer.size());
+  size_t prefix = 0;
+  while (prefix < common && M_buffer[prefix] == buffer[prefix])
+    ++prefix;
+  size_t suffix = 0;
+  while (suffix < common - prefix && M_buffer[M_buffer.size() - 1 - suffix] == buffer[buffer.size() - 1 - suffix])
+    ++suffix;
+  size_t const old_end = M_buffer.size() - suffix;
+  size_t const new_end = buffer.size() - suffix;
+  if (prefix < M_blocks.front().M_offset || prefix < blocks.front().M_offset)
+    return false;					// The header changed.
+
+  // Parse every block that touches the change, behind the (unchanged) header.
+  std::string text(buffer, 0, header_length);
+  text += '\n';
+  size_t touched = 0;
+  for (std::vector<ContributorBlock>::const_iterator block = blocks.begin(); block != blocks.end(); ++block)
+    if (block->M_offset <= new_end && block->M_offset + block->M_length >= prefix)
+    {
+      text.append(buffer, block->M_offset, block->M_length);
+      ++touched;
+    }
+  ContributionsTxt changes(&M_scratch);
+  if (touched)
+  {
+    try
+    {
+      changes.parse(M_filename, text);
+    }
+    catch(ParseError&)
+    {
+      return false;					// Let the full parse report it.
+    }
+    if (changes.contributors().size() != touched)
+      return false;
+  }
+
+  // Replace the old blocks that touch the change with the new ones.
+  for (std::vector<ContributorBlock>::const_iterator block = M_blocks.begin(); block != M_blocks.end(); ++block)
+    if (block->M_offset <= old_end && block->M_offset + block->M_length >= prefix)
+      M_document->erase_contributor(FullName(block->M_full_name));
+  for (ContributionsTxt::contributors_map::const_iterator contributor = changes.contributors().begin();
+       contributor != changes.contributors().end(); ++contributor)
+    M_document->add_contributor(contributor->first.full_name().c_str(), contributor->second);
+
+  // Every block must now correspond to exactly one contributor (there are no duplicates).
+  if (M_document->contributors().size() != blocks.size())
+    return false;
+  for (std::vector<ContributorBlock>::const_iterator block = blocks.begin(); block != blocks.end(); ++block)
+    if (M_document->contributors().find(FullName(block->M_full_name)) == M_document->contributors().end())
+      return false;
+
+  M_reparsed += text.size();
+  M_buffer = buffer;
+  M_header_length = header_length;
+  M_blocks.swap(blocks);
+  return true;
+}
@@ -0,0 +1,71 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file WatchedDocument.h Declaration of class WatchedDocument.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef WATCHEDDOCUMENT_H
+#define WATCHEDDOCUMENT_H
+
+#include <string>
+#include <vector>
+#include <boost/scoped_ptr.hpp>
+#include "ContributionsTxt.h"
+#include "ContributorBlocks.h"
+#include "exceptions.h"
+
+// An input of --watch: a document that is kept in memory and brought up to date
+// whenever its file changes. Only the contributor blocks that overlap the bytes
+// that differ from the previous contents are parsed again, unless the change
+// touches the header, the file is in the columnar binary format or the memory
+// left behind by replaced contributors exceeds the size of the file; then the
+// whole file is parsed.
+class WatchedDocument
+{
+  private:
+    std::string M_filename;
+    std::string M_buffer;				// The contents of M_document.
+    size_t M_header_length;
+    std::vector<ContributorBlock> M_blocks;		// Empty if M_buffer can't be split into blocks.
+    bool M_binary;					// Set if M_buffer is in the columnar binary format.
+    size_t M_reparsed;					// Number of bytes parsed since the last full parse.
+    boost::scoped_ptr<ContributionsTxt> M_document;	// NULL until the file was parsed successfully.
+    Arena M_scratch;					// For the changed contributors, until they are copied into M_document.
+
+  public:
+    WatchedDocument(std::string const& filename) : M_filename(filename), M_header_length(0), M_binary(false), M_reparsed(0) { }
+
+    // Read the file again and update the document. Returns false if the contents didn't change.
+    // After an exception the document is invalid until the next successful update.
+    bool update(void) throw(ParseError, FormatError, ReadError);
+
+    // Accessors.
+    std::string const& filename(void) const { return M_filename; }
+    bool valid(void) const { return M_document.get() != NULL; }
+    bool binary(void) const { return M_binary; }
+    ContributionsTxt const& document(void) const { return *M_document; }
+
+  private:
+    void parse_all(std::string const& buffer) throw(ParseError, FormatError);
+    bool parse_changes(std::string const& buffer);
+
+  private:
+    // Noncopyable.
+    WatchedDocument(WatchedDocument const&);
+    WatchedDocument& operator=(WatchedDocument const&);
+};
+
+#endif // WATCHEDDOCUMENT_H
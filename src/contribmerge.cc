@@ -24,183 +24,824 @@
 #include "debug.h"
 #endif
 
-#include <algorithm>
-#include <cassert>
+#include <cstring>
+#include <sstream>
+#include <set>
 #include <string>
 #include <boost/program_options.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/scoped_ptr.hpp>
 #include "contribmerge.h"
 #include "ContributionsTxt.h"
 #include "exceptions.h"
-#include "three_way_merge.h"
+#include "AsyncIO.h"
+#include "Canonicalizer.h"
+#include "Changeset.h"
+#include "Audit.h"
+#include "ColumnarFormat.h"
+#include "ContentHash.h"
+#include "ContributionsDiff.h"
+#include "GitRepository.h"
+#include "InputWatcher.h"
+#include "InternedString.h"
+#include "merge.h"
+#include "MergeState.h"
+#include "MergeConflict.h"
+#include "Statistics.h"
+#include "Trace.h"
+#include "PerfCounters.h"
+#include "Lint.h"
+#include "QueryIndex.h"
+#include "ResultCache.h"
+#include "SnapshotCache.h"
+#include "AllocationStatistics.h"
+#include "WatchedDocument.h"
 
-struct CommentEqual
+// Merge using the requested statistics (NULL if none) and conflict policy,
+// allocating the result from resource if not NULL.
+template<class ConflictPolicy>
+static ContributionsTxt merge_with(ContributionsTxt const& base, ContributionsTxt const& left, ContributionsTxt const& right,
+    Statistics* statistics, ConflictPolicy& conflict_policy, boost::container::pmr::memory_resource* resource = NULL)
 {
-  bool operator()(ContributionEntry const& ce1, ContributionEntry const& ce2)
+  // Only instantiate the counting policy when it is needed.
+  if (statistics)
+    return merge(base, left, right, statistics->contributor_rules(), statistics->entry_rules(), &statistics->payload_allocations(),
+        conflict_policy, resource);
+  NoMergeStatistics no_statistics;
+  return merge(base, left, right, no_statistics, no_statistics, NULL, conflict_policy, resource);
+}
+
+// Measures one phase of the run for --stats and/or --perf-counters, if requested.
+class PhaseRecorder
+{
+  private:
+    Statistics* M_statistics;
+    PerfReport* M_perf_report;
+    PhaseTimer M_timer;
+    PerfCounters::Sample M_start;
+    AllocationMeter M_allocation_meter;
+
+  public:
+    PhaseRecorder(Statistics* statistics, PerfReport* perf_report) : M_statistics(statistics), M_perf_report(perf_report) { start(); }
+
+    void start(void)
+    {
+      if (M_statistics)
+	M_allocation_meter.start();
+      if (M_perf_report)
+	M_start = M_perf_report->counters().read();
+      M_timer.start();
+    }
+
+    void finish(char const* name, std::string const& target, unsigned long contributors)
+    {
+      if (M_perf_report)
+	M_perf_report->add_phase(name, target, contributors, M_start, M_perf_report->counters().read());
+      if (M_statistics)
+      {
+	AllocationCounters allocations;
+	M_allocation_meter.stop(allocations);
+	M_statistics->add_phase(name, target, M_timer, allocations);
+      }
+    }
+};
+
+// Write the result to os, as text or in the columnar binary format, recorded as phase "print".
+static void print_result(ContributionsTxt const& result, std::ostream& os, std::string const& target, PhaseRecorder& recorder, bool binary)
+{
+  TraceSpan span("write", target.c_str());
+  recorder.start();
+  if (binary)
+    write_columnar(result, os);
+  else
+    result.print_on(os);
+  recorder.finish("print", target, result.contributors().size());
+}
+
+namespace po = boost::program_options;
+
+// Report the exception that is being handled on standard error and return the exit status for it:
+// 1 for a merge failure and 2 for trouble (see DIAGNOSTICS in the README). Exceptions of other
+// types are thrown again. If name is not empty, a parse error is reported as one in name.
+static int report_exception(std::string const& name = std::string())
+{
+  try
   {
-    assert(!(ce1.jira_project_key() < ce2.jira_project_key()) && !(ce2.jira_project_key() < ce1.jira_project_key()));
-    return ce1.comment() == ce2.comment();
+    throw;
   }
-};
+  catch(ParseError& parse_error)
+  {
+    std::cerr << "Parsing " << (name.empty() ? "" : name + " ") << "failed\n" << "Stopped at: \"" << parse_error.rest() << "\"\n";
+  }
+  catch(GitError& git_error)
+  {
+    std::cerr << git_error.what() << '\n';
+  }
+  catch(FormatError& format_error)
+  {
+    std::cerr << format_error.what() << '\n';
+  }
+  catch(ReadError& read_error)
+  {
+    std::cerr << read_error.what() << '\n';
+  }
+  catch(po::error& po_error)
+  {
+    std::cerr << po_error.what() << "; see --help.\n";
+  }
+  catch(MergeFailure&)
+  {
+    std::cerr << "Merge failure\n";
+    return 1;
+  }
+  return 2;
+}
+
+// Read the input name: a <rev>:<path> if git_repository is not NULL and a file name otherwise.
+static void read_input(std::string const& name, GitRepository const* git_repository, std::string& buffer) throw(GitError, ReadError)
+{
+  if (git_repository)
+    git_repository->read_blob(name, buffer);
+  else
+    ContributionsTxt::read_file(name, buffer);
+}
+
+// Read the three inputs: at the same time (see AsyncReader), or one by one from git_repository if not NULL.
+static void read_inputs(std::string const& filename_base, std::string const& filename_left, std::string const& filename_right,
+    GitRepository const* git_repository, std::string& base_buffer, std::string& left_buffer, std::string& right_buffer) throw(GitError, ReadError)
+{
+  if (git_repository)
+  {
+    read_input(filename_base, git_repository, base_buffer);
+    read_input(filename_left, git_repository, left_buffer);
+    read_input(filename_right, git_repository, right_buffer);
+    return;
+  }
+  std::string const filenames[3] = { filename_base, filename_left, filename_right };
+  std::string* const buffers[3] = { &base_buffer, &left_buffer, &right_buffer };
+  AsyncReader reader(filenames, 3);
+  for (int n = 0; n < 3; ++n)
+  {
+    size_t index = reader.next();
+    buffers[index]->swap(reader.buffer(index));
+  }
+}
 
-// We can't do this, so fail -- but lets print an error message that explains what's wrong.
-struct CommentMerger
+// Parse buffer, the contents of name, into the empty document contributions_txt;
+// or load it from snapshot_cache instead, if not NULL and it has it.
+// Returns true if buffer is in the columnar binary format (which is never cached).
+static bool load_document(std::string const& name, std::string const& buffer, SnapshotCache const* snapshot_cache,
+    ContributionsTxt& contributions_txt) throw(ParseError, FormatError)
 {
-  template<typename Iterator1, typename Iterator2, typename Iterator3, typename OutputIterator>
-  void operator()(Iterator1 l, Iterator2 b, Iterator3 r, OutputIterator&) throw(MergeFailure)
+  if (ColumnarImage::is_columnar(buffer.data(), buffer.size()))
+  {
+    ColumnarImage image(buffer.data(), buffer.size());
+    if (!image.validate())
+      throw FormatError("Corrupt columnar image: " + name);
+    image.to_contributions_txt(contributions_txt);
+    return true;
+  }
+  std::string hash;
+  if (snapshot_cache)
   {
-    if (l == Iterator1())
+    hash = content_hash(buffer);
+    if (snapshot_cache->load(hash, contributions_txt))
+      return false;
+  }
+  contributions_txt.parse(name, buffer);
+  if (snapshot_cache)
+    snapshot_cache->store(hash, contributions_txt);
+  return false;
+}
+
+// --to-binary and --from-binary: convert input to output (- for standard output).
+static int convert(std::string const& input, std::string const& output, bool to_binary, bool with_comments,
+    GitRepository const* git_repository, SnapshotCache const* snapshot_cache)
+{
+  try
+  {
+    std::string buffer;
+    read_input(input, git_repository, buffer);
+    ContributionsTxt contributions_txt;
+    load_document(input, buffer, snapshot_cache, contributions_txt);
+    std::ostringstream outfile;
+    std::ostream& os(output == "-" ? std::cout : outfile);
+    if (to_binary)
+      write_columnar(contributions_txt, os, with_comments);
+    else
+      contributions_txt.print_on(os);
+    if (output != "-" && !write_file(output, outfile.str()))
     {
-      std::cerr << "Failure: hit rule: n (-, m) --> MergeFailure.\n";
-      std::cerr << "With n = <ContributionEntry>" << b->jira_project_key() << b->comment() <<
-	  "</ContributionEntry> and m = <ContributionEntry>" << r->jira_project_key() << r->comment() <<
-	  "</ContributionEntry>" << std::endl;
-      throw MergeFailure();
+      std::cerr << "Cannot write \"" << output << "\".\n";
+      return 2;
     }
-    else if (r == Iterator3())
+    return 0;
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
+}
+
+// --check: only determine if left and right merge without conflicts.
+// Returns the exit code: 0 if they do, 1 if not and 2 if an input can't be parsed.
+static int check(std::string const& filename_base, std::string const& filename_left, std::string const& filename_right,
+    GitRepository const* git_repository, SnapshotCache const* snapshot_cache)
+{
+  try
+  {
+    std::string base_buffer, left_buffer, right_buffer;
+    read_inputs(filename_base, filename_left, filename_right, git_repository, base_buffer, left_buffer, right_buffer);
+
+    // Every input must parse, or the merge fails; but equal inputs only need to be parsed once.
+    ContributionsTxt base, left, right;
+    load_document(filename_base, base_buffer, snapshot_cache, base);
+    if (left_buffer != base_buffer)
+      load_document(filename_left, left_buffer, snapshot_cache, left);
+    if (right_buffer != base_buffer && right_buffer != left_buffer)
+      load_document(filename_right, right_buffer, snapshot_cache, right);
+
+    // x (x, y) --> y, x (y, x) --> y and x (y, y) --> y: no need to merge.
+    if (left_buffer == base_buffer || right_buffer == base_buffer || left_buffer == right_buffer)
+      return 0;
+    return mergeable(base, left, right) ? 0 : 1;
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
+}
+
+// --lint: report everything in input that a merge would stumble over or silently change.
+// Returns the exit code: 0 if there is nothing to report, 1 if there is and 2 on errors.
+static int lint(std::string const& input, GitRepository const* git_repository)
+{
+  try
+  {
+    std::string buffer;
+    read_input(input, git_repository, buffer);
+    if (ColumnarImage::is_columnar(buffer.data(), buffer.size()))
     {
-      std::cerr << "Failure: hit rule: n (m, -) --> MergeFailure.\n";
-      std::cerr << "With n = <ContributionEntry>" << b->jira_project_key() << b->comment() <<
-	  "</ContributionEntry> and m = <ContributionEntry>" << l->jira_project_key() << l->comment() <<
-	  "</ContributionEntry>" << std::endl;
-      throw MergeFailure();
+      std::cerr << "\"" << input << "\" is in the columnar binary format; --lint checks text only.\n";
+      return 2;
     }
-    else if (b == Iterator2())
+    Lint lint;
+    lint.check(buffer);
+    lint.print_on(std::cout, input);
+    return lint.findings().empty() ? 0 : 1;
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
+}
+
+// --canonicalize: write input in the form in which contribmerge writes a merge to output (- for standard output).
+static int canonicalize(std::string const& input, std::string const& output, unsigned int jobs,
+    GitRepository const* git_repository)
+{
+  try
+  {
+    std::string buffer;
+    read_input(input, git_repository, buffer);
+    std::string result;
+    if (ColumnarImage::is_columnar(buffer.data(), buffer.size()))
     {
-      std::cerr << "Failure: hit rule: - (n, m) --> MergeFailure.\n";
-      std::cerr << "With n = <ContributionEntry>" << l->jira_project_key() << l->comment() <<
-	  "</ContributionEntry> and m = <ContributionEntry>" << r->jira_project_key() << r->comment() <<
-	  "</ContributionEntry>" << std::endl;
-      throw MergeFailure();
+      ContributionsTxt contributions_txt;
+      load_document(input, buffer, NULL, contributions_txt);
+      std::ostringstream os;
+      Canonicalizer::print_on(os, contributions_txt);
+      result = os.str();
     }
     else
+      Canonicalizer(jobs).canonicalize(input, buffer, result);
+    if (output == "-")
+      std::cout << result;
+    else if (!write_file(output, result))
     {
-      std::cerr << "Failure: hit rule: n (m, k) --> MergeFailure.\n";
-      std::cerr << "With n = <ContributionEntry>" << b->jira_project_key() << b->comment() <<
-	  "</ContributionEntry> and m = <ContributionEntry>" << l->jira_project_key() << l->comment() <<
-	  "</ContributionEntry> and k = <ContributionEntry>" << r->jira_project_key() << r->comment() <<
-	  "</ContributionEntry>" << std::endl;
-      throw MergeFailure();
+      std::cerr << "Cannot write \"" << output << "\".\n";
+      return 2;
     }
+    return 0;
   }
-};
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
+}
+
+// Parse --stats[=<format>] ourselves, otherwise program_options would take the
+// next positional argument as the value of an implicit_value option.
+static std::pair<std::string, std::string> stats_parser(std::string const& arg)
+{
+  if (arg == "--stats")
+    return std::make_pair(std::string("stats"), std::string("text"));
+  if (arg.compare(0, 8, "--stats=") == 0)
+    return std::make_pair(std::string("stats"), arg.substr(8));
+  return std::make_pair(std::string(), std::string());
+}
 
-struct ContributionsEqual
+// Write output, the bytes of a result that is already printed, to where the merge result should go.
+// Returns false if the file could not be written.
+static bool write_result(std::string const& output, po::variables_map const& vm, std::string const& filename_left)
 {
-  bool operator()(Contributor const& c1, Contributor const& c2)
+  if (vm.count("stdout"))
+    std::cout.write(output.data(), output.size());
+  if (vm.count("out") || !vm.count("stdout"))
   {
-    assert(c1.first == c2.first);
-    return c1.second.raw_string() == c2.second.raw_string();
+    std::string const& target(vm.count("out") ? vm["out"].as<std::string>() : filename_left);
+    if (!write_file(target, output))
+    {
+      std::cerr << "Cannot write \"" << target << "\".\n";
+      return false;
+    }
   }
-};
+  return true;
+}
 
-struct ContributionsMerger
+// --watch: merge, and merge again every time an input is saved, until interrupted (SIGINT or SIGTERM).
+// Only the changed parts of an input are parsed again.
+static int watch(std::string const& filename_base, std::string const& filename_left, std::string const& filename_right,
+    po::variables_map const& vm)
 {
-  template<typename Iterator1, typename Iterator2, typename Iterator3, typename OutputIterator>
-  void operator()(Iterator1 l, Iterator2 b, Iterator3 r, OutputIterator& output) throw(MergeFailure)
+  InputWatcher watcher;
+  if (!watcher.add(filename_base) || !watcher.add(filename_left) || !watcher.add(filename_right))
+  {
+    std::cerr << watcher.error() << '\n';
+    return 2;
+  }
+  watcher.stop_on_interrupt();
+  WatchedDocument base(filename_base), left(filename_left), right(filename_right);
+  WatchedDocument* const documents[3] = { &base, &left, &right };
+  Arena arena;						// For the result of each merge; released before the next one.
+  bool first = true;
+  for (;;)
   {
-    if (l == Iterator1())
+    std::set<std::string> changed;
+    if (!first)
     {
-      std::cerr << "Failure: hit rule: n (-, m) --> MergeFailure.\n";
-      std::cerr << "With n = <RAW>" << b->second.raw_string() << "</RAW> and m = <RAW>" << r->second.raw_string() << "</RAW>" << std::endl;
-      throw MergeFailure();
+      changed = watcher.wait();
+      if (changed.empty() && watcher.interrupted())
+	return 0;					// Return normally, so that the --trace is written.
+      if (changed.empty())
+      {
+	std::cerr << watcher.error() << '\n';
+	return 2;
+      }
     }
-    else if (r == Iterator3())
+    bool updated = false;
+    for (int i = 0; i < 3; ++i)
     {
-      std::cerr << "Failure: hit rule: n (m, -) --> MergeFailure.\n";
-      std::cerr << "With n = <RAW>" << b->second.raw_string() << "</RAW> and m = <RAW>" << l->second.raw_string() << "</RAW>" << std::endl;
-      throw MergeFailure();
+      if (!first && changed.find(documents[i]->filename()) == changed.end())
+	continue;
+      try
+      {
+	updated |= documents[i]->update();
+      }
+      catch(std::exception&)
+      {
+	report_exception(documents[i]->filename());
+      }
     }
-    else if (b == Iterator2())
+    first = false;
+    if (!updated || !base.valid() || !left.valid() || !right.valid())
+      continue;
+
+    // The previous result is gone: give back its memory, and that of the strings of replaced contributors.
+    arena.release();
+    InternedString::collect();
+    try
+    {
+      MergeConflicts conflicts;
+      ThrowOnConflict throw_on_conflict;
+      CollectConflicts collect_conflicts(conflicts);
+      ContributionsTxt result(vm.count("collect-conflicts") ?
+	  merge_with(base.document(), left.document(), right.document(), NULL, collect_conflicts, &arena) :
+	  merge_with(base.document(), left.document(), right.document(), NULL, throw_on_conflict, &arena));
+      if (!conflicts.empty())
+      {
+	std::ostringstream report;
+	conflicts.print_on(report);
+	std::cerr << report.str();
+      }
+      bool const binary = vm.count("output-format") ? vm["output-format"].as<std::string>() == "binary" : left.binary();
+      if (binary && !result.conflict_markers().empty())
+      {
+	std::cerr << "The binary format can't hold conflict markers; no result written.\n";
+	continue;
+      }
+      std::ostringstream output;
+      if (binary)
+	write_columnar(result, output);
+      else
+	result.print_on(output);
+      write_result(output.str(), vm, filename_left);
+      std::cout.flush();
+    }
+    catch(std::exception&)
     {
-      assert(l->first == r->first);
-      FormattedContributions left(l->second), right(r->second);
-      FormattedContributions result;
+      report_exception();
+    }
+  }
+}
 
-      std::set_union(left.contributions().begin(), left.contributions().end(),
-		     right.contributions().begin(), right.contributions().end(),
-		     result.get_inserter(),
-		     FormattedContributions::contributions_type::key_compare());
+// contribmerge --audit [<audit options>] <list>
+static int audit_main(int argc, char* argv[])
+{
+  std::string repository(".");
+  std::string list_filename;
+  unsigned int jobs = boost::thread::hardware_concurrency();
+  size_t cache_size = 256;
 
-      *output = Contributor(l->first, result);
-    }
+  po::options_description audit_options("audit options");
+  audit_options.add_options()
+    ("help,h", "Produce help message.")
+    ("git", po::value<std::string>(&repository),
+              "The local git repository to read the blobs from (default: the current directory).")
+    ("jobs,j", po::value<unsigned int>(&jobs),
+              "Number of merges to verify in parallel (default: the number of CPUs).")
+    ("cache-size", po::value<size_t>(&cache_size),
+              "Maximum number of parsed blobs kept in memory (default: 256).")
+    ("trace", po::value<std::string>(),
+              "Write a timeline of the run to the given file, in Chrome trace-event JSON format.")
+  ;
+
+  po::options_description hidden_options;
+  hidden_options.add_options()
+    ("list", po::value<std::string>(&list_filename), "The merges to verify.")
+  ;
+
+  po::options_description cmdline_options;
+  cmdline_options.add(audit_options).add(hidden_options);
+
+  po::positional_options_description p;
+  p.add("list", 1);
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::command_line_parser(argc, argv).options(cmdline_options).positional(p).run(), vm);
+    po::notify(vm);
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
+
+  if (vm.count("help") || list_filename.empty())
+  {
+    std::cout << "Usage: contribmerge --audit [<audit options>] <list>" << std::endl
+              << "Verifies for every line \"<left> <base> <right> <actual>\" of <list> (- for standard input)" << std::endl
+              << "that merging the blobs <left> and <right> with <base> gives exactly <actual>." << std::endl
+              << "Each is a blob name or <rev>:<path>." << std::endl
+              << std::endl;
+    std::cout << audit_options << std::endl;
+    return vm.count("help") ? 1 : 2;
+  }
+  if (cache_size == 0)
+  {
+    std::cerr << "--cache-size must be at least 1.\n";
+    return 2;
+  }
+  if (vm.count("trace"))
+    Trace::start(vm["trace"].as<std::string>());
+
+  try
+  {
+    GitRepository git_repository(repository);
+    Audit audit(git_repository, cache_size);
+    if (list_filename == "-")
+      audit.read_list(std::cin);
     else
     {
-      assert(l->first == r->first);
-      FormattedContributions left(l->second), base(b->second), right(r->second);
-      FormattedContributions result;
+      std::ifstream list(list_filename.c_str());
+      if (!list)
+      {
+	std::cerr << "Cannot open \"" << list_filename << "\".\n";
+	return 2;
+      }
+      audit.read_list(list);
+    }
+    audit.run(jobs ? jobs : 1);
+    std::ostringstream report;
+    unsigned long failures = audit.print_on(report);
+    std::cout << report.str();
+    return failures ? 1 : 0;
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
+}
 
-      three_way_merge(left.contributions().begin(), left.contributions().end(),
-		      base.contributions().begin(), base.contributions().end(),
-		      right.contributions().begin(), right.contributions().end(),
-		      result.get_inserter(),
-		      CommentMerger(),
-		      FormattedContributions::contributions_type::key_compare(),
-		      CommentEqual());
+// Replace buffer, the contents of name, by the text that it would be written as, which can be walked
+// (see ContributionsDiff::is_walkable): for columnar inputs and those that were not written by contribmerge.
+static void make_walkable(std::string const& name, std::string& buffer) throw(ParseError, FormatError)
+{
+  ContributionsTxt contributions_txt;
+  load_document(name, buffer, NULL, contributions_txt);
+  std::ostringstream text;
+  contributions_txt.print_on(text);
+  buffer = text.str();
+  if (!ContributionsDiff::is_walkable(buffer))
+    throw FormatError("Cannot compare the contributors of " + name);
+}
 
-      *output = Contributor(b->first, result);
-    }
-    ++output;
+// Read input for diff into buffer, as text that can be walked.
+static void read_walkable_input(std::string const& name, GitRepository const* git_repository, std::string& buffer)
+    throw(GitError, ReadError, ParseError, FormatError)
+{
+  read_input(name, git_repository, buffer);
+  if (!ContributionsDiff::is_walkable(buffer))
+    make_walkable(name, buffer);
+}
+
+// contribmerge --diff [<diff options>] <old> <new>
+static int diff_main(int argc, char* argv[])
+{
+  std::string repository;
+  std::string output_format("text");
+  std::string filename_old, filename_new;
+
+  po::options_description diff_options("diff options");
+  diff_options.add_options()
+    ("help,h", "Produce help message.")
+    ("git", po::value<std::string>(&repository),
+              "Read <old> and <new> as blobs (or <rev>:<path>) from the given local git repository.")
+    ("output-format", po::value<std::string>(&output_format),
+              "Print the differences as 'text' (the default) or 'json'.")
+    ("trace", po::value<std::string>(),
+              "Write a timeline of the run to the given file, in Chrome trace-event JSON format.")
+  ;
+
+  po::options_description hidden_options;
+  hidden_options.add_options()
+    ("old", po::value<std::string>(&filename_old), "The old contributions.txt.")
+    ("new", po::value<std::string>(&filename_new), "The new contributions.txt.")
+  ;
+
+  po::options_description cmdline_options;
+  cmdline_options.add(diff_options).add(hidden_options);
+
+  po::positional_options_description p;
+  p.add("old", 1).add("new", 1);
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::command_line_parser(argc, argv).options(cmdline_options).positional(p).run(), vm);
+    po::notify(vm);
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
   }
-};
 
-// Below we use the following notation:
-//
-// x (y, z) --> r
-//
-// where x is part of the base, y is part of left and z is part of right: base (left, right) --> result.
-//
-// If a different symbol is used in the same formula, then that means that that part was changed.
-// 
-// Left and right are always exchangable. If x (y, z) --> r, then x (z, y) --> r. The latter may be omitted.
-// 
-// In all cases, x (x, x) --> x,  [if neither side changes anything, nothing is changed]
-//               x (x, y) --> y   [if only one side changes something, that is used]
-//           and x (y, y) --> y   [if both sides make the same change, who are we to argue]
-// These rules are considered trivial and may be omitted in the comments.
-//
-// When some part is non-existent we use the character '-'.
-//
-ContributionsTxt merge(ContributionsTxt const& base, ContributionsTxt const& left, ContributionsTxt const& right) throw(MergeFailure)
+  if (vm.count("help") || filename_new.empty())
+  {
+    std::cout << "Usage: contribmerge --diff [<diff options>] <old> <new>" << std::endl
+              << "Prints the contributors and entries that were added, removed or changed from <old> to <new>." << std::endl
+              << "Exits with 0 if there are no differences, 1 if there are and 2 on errors." << std::endl
+              << std::endl;
+    std::cout << diff_options << std::endl;
+    return vm.count("help") ? 1 : 2;
+  }
+  if (output_format != "text" && output_format != "json")
+  {
+    std::cerr << "--output-format must be 'text' or 'json'.\n";
+    return 2;
+  }
+  if (vm.count("trace"))
+    Trace::start(vm["trace"].as<std::string>());
+
+  try
+  {
+    boost::scoped_ptr<GitRepository> git_repository;
+    if (!repository.empty())
+      git_repository.reset(new GitRepository(repository));
+    std::string old_buffer, new_buffer;
+    read_walkable_input(filename_old, git_repository.get(), old_buffer);
+    read_walkable_input(filename_new, git_repository.get(), new_buffer);
+    ContributionsDiff diff(std::cout, output_format == "json" ? ContributionsDiff::json : ContributionsDiff::text);
+    return diff.run(old_buffer, new_buffer) ? 1 : 0;
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
+}
+
+// contribmerge --apply [<apply options>] <changeset> <target>
+static int apply_main(int argc, char* argv[])
 {
-  // Merge the header.
-  //
-  // The header only follows the trivial rules, plus
-  // h1 (h2, h3) --> MergeFailure [if both sides make different changes, fail]
-  //
-  Header header(base);				// Default in case h (h, h) --> h
-  if (header != left && header != right)
-  {
-    if (left != right)
-      throw MergeFailure();			// h1 (h2, h3) --> MergeFailure
-    header = left;				// h1 (h2, h2) --> h2
-  }
-  else if (header != left)
-    header = left;				// h1 (h2, h1) --> h2
-  else if (header != right)
-    header = right;				// h1 (h1, h2) --> h2
-
-  ContributionsTxt result(header);
-
-  three_way_merge(left.contributors().begin(), left.contributors().end(),
-		  base.contributors().begin(), base.contributors().end(),
-		  right.contributors().begin(), right.contributors().end(),
-		  result.get_inserter(), ContributionsMerger(),
-		  ContributionsTxt::contributors_map::key_compare(),
-		  ContributionsEqual());
-
-  return result;
+  std::string filename_changeset, filename_target;
+
+  po::options_description apply_options("apply options");
+  apply_options.add_options()
+    ("help,h", "Produce help message.")
+    ("stdout,p", "Send the result to standard output instead of writing it to <target>.")
+    ("out,o", po::value<std::string>(), "Write the result to the given file instead of to <target>.")
+    ("trace", po::value<std::string>(),
+              "Write a timeline of the run to the given file, in Chrome trace-event JSON format.")
+  ;
+
+  po::options_description hidden_options;
+  hidden_options.add_options()
+    ("changeset", po::value<std::string>(&filename_changeset), "The changes to apply.")
+    ("target", po::value<std::string>(&filename_target), "The contributions.txt to change.")
+  ;
+
+  po::options_description cmdline_options;
+  cmdline_options.add(apply_options).add(hidden_options);
+
+  po::positional_options_description p;
+  p.add("changeset", 1).add("target", 1);
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::command_line_parser(argc, argv).options(cmdline_options).positional(p).run(), vm);
+    po::notify(vm);
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
+
+  if (vm.count("help") || filename_target.empty())
+  {
+    std::cout << "Usage: contribmerge --apply [<apply options>] <changeset> <target>" << std::endl
+              << "Applies <changeset> (- for standard input), in the format that contribmerge --diff prints, to <target>." << std::endl
+              << "Only the contributors that change are parsed and written again; all other lines are copied." << std::endl
+              << std::endl;
+    std::cout << apply_options << std::endl;
+    return vm.count("help") ? 1 : 2;
+  }
+  if (vm.count("trace"))
+    Trace::start(vm["trace"].as<std::string>());
+
+  try
+  {
+    // Read the changeset and the target at the same time.
+    std::string changeset_buffer, target_buffer;
+    if (filename_changeset == "-")
+    {
+      std::ostringstream contents;
+      contents << std::cin.rdbuf();
+      changeset_buffer = contents.str();
+      ContributionsTxt::read_file(filename_target, target_buffer);
+    }
+    else
+    {
+      std::string const filenames[2] = { filename_changeset, filename_target };
+      std::string* const buffers[2] = { &changeset_buffer, &target_buffer };
+      AsyncReader reader(filenames, 2);
+      for (int n = 0; n < 2; ++n)
+      {
+	size_t index = reader.next();
+	buffers[index]->swap(reader.buffer(index));
+      }
+    }
+    Changeset changeset;
+    changeset.read(changeset_buffer);
+    std::string result;
+    if (!changeset.apply(target_buffer, result))
+    {
+      // Not written by contribmerge: apply the changes to the text that it would be written as.
+      make_walkable(filename_target, target_buffer);
+      result.clear();
+      changeset.apply(target_buffer, result);
+    }
+    return write_result(result, vm, filename_target) ? 0 : 2;
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
 }
 
-namespace po = boost::program_options;
+// contribmerge --query [<query options>] <file> [<key>...]
+static int query_main(int argc, char* argv[])
+{
+  std::string filename;
+  std::string index_filename;
+  std::vector<std::string> keys;
+  std::vector<std::string> names;
 
-int main(int argc, char* argv[])
+  po::options_description query_options("query options");
+  query_options.add_options()
+    ("help,h", "Produce help message.")
+    ("name", po::value<std::vector<std::string> >(&names)->composing(),
+              "Print the contributor with this full name, ignoring case. May be repeated.")
+    ("index", po::value<std::string>(&index_filename),
+              "The index file to use, which is created or updated when needed (default: <file>.index).")
+    ("trace", po::value<std::string>(),
+              "Write a timeline of the run to the given file, in Chrome trace-event JSON format.")
+  ;
+
+  po::options_description hidden_options;
+  hidden_options.add_options()
+    ("file", po::value<std::string>(&filename), "The contributions.txt to query.")
+    ("key", po::value<std::vector<std::string> >(&keys), "The JIRA keys to look up.")
+  ;
+
+  po::options_description cmdline_options;
+  cmdline_options.add(query_options).add(hidden_options);
+
+  po::positional_options_description p;
+  p.add("file", 1).add("key", -1);
+
+  po::variables_map vm;
+  try
+  {
+    po::store(po::command_line_parser(argc, argv).options(cmdline_options).positional(p).run(), vm);
+    po::notify(vm);
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
+
+  if (vm.count("help") || filename.empty() || (keys.empty() && names.empty()))
+  {
+    std::cout << "Usage: contribmerge --query [<query options>] <file> [<key>...]" << std::endl
+              << "Prints \"<full name><tab><entry>\" for every entry of <file> with one of the JIRA keys <key>," << std::endl
+              << "which is a key (VWR-24487), a prefix (STORM) or an inclusive range of those (VWR-100..VWR-200)." << std::endl
+              << "Exits with 0 if anything was found, 1 if not and 2 on errors." << std::endl
+              << std::endl;
+    std::cout << query_options << std::endl;
+    return vm.count("help") ? 1 : 2;
+  }
+  if (index_filename.empty())
+    index_filename = filename + ".index";
+  if (vm.count("trace"))
+    Trace::start(vm["trace"].as<std::string>());
+
+  try
+  {
+    QueryIndex index;
+    index.open(filename, index_filename);
+    std::ostringstream result;
+    unsigned long found = 0;
+    for (std::vector<std::string>::const_iterator key = keys.begin(); key != keys.end(); ++key)
+      found += index.print_keys(*key, result);
+    for (std::vector<std::string>::const_iterator name = names.begin(); name != names.end(); ++name)
+      found += index.print_name(*name, result);
+    std::cout << result.str();
+    return found ? 0 : 1;
+  }
+  catch(std::exception&)
+  {
+    return report_exception();
+  }
+}
+
+// --version.
+static int print_version(void)
 {
-  Debug(debug::init());
+#ifdef PACKAGE_STRING //! \TODO Remove ifdef once config.h is generated by CMake, too.
+  std::cout << PACKAGE_STRING << std::endl;
+#else
+  std::cout << "contribmerge (version unknown)" << std::endl;
+#endif
+  return 1;
+}
 
-  std::string filename_base;
-  std::string filename_left;
-  std::string filename_right;
+// Parse the usual command line of a merge driver, [-p] [-o <file>] <left> <base> <right>,
+// into vm without constructing the option descriptions of program_options (which is a
+// noticeable part of the run time of a small merge). Returns false for any other command
+// line, which is then left to parse_command_line.
+static bool parse_common_command_line(int argc, char* argv[], po::variables_map& vm,
+    std::string& filename_left, std::string& filename_base, std::string& filename_right)
+{
+  char const* positional[3];
+  int number_of_positional = 0;
+  for (int i = 1; i < argc; ++i)
+  {
+    char const* arg = argv[i];
+    if ((std::strcmp(arg, "-p") == 0 || std::strcmp(arg, "--stdout") == 0) && !vm.count("stdout"))
+      vm.insert(std::make_pair(std::string("stdout"), po::variable_value(boost::any(), false)));
+    else if ((std::strcmp(arg, "-o") == 0 || std::strcmp(arg, "--out") == 0) && !vm.count("out") &&
+             i + 1 < argc && argv[i + 1][0] != '-')
+      vm.insert(std::make_pair(std::string("out"), po::variable_value(boost::any(std::string(argv[++i])), false)));
+    else if (arg[0] == '-' || number_of_positional == 3)
+      return false;
+    else
+      positional[number_of_positional++] = arg;
+  }
+  if (number_of_positional != 3)
+    return false;
+  filename_left = positional[0];
+  filename_base = positional[1];
+  filename_right = positional[2];
+  return true;
+}
 
+// Parse the command line with program_options into vm. Returns false if --help
+// was given, after printing the help message.
+static bool parse_command_line(int argc, char* argv[], po::variables_map& vm,
+    std::string& filename_left, std::string& filename_base, std::string& filename_right)
+{
   po::options_description generic_options("generic options");
   generic_options.add_options()
     ("help,h", "Produce help message.")
@@ -216,6 +857,64 @@ int main(int argc, char* argv[])
               "there in case of a successful merge. If both, -p and -o "
               "are specified, the result will be sent to both, "
               "standard output and the specified file.")
+    ("git", po::value<std::string>(),
+              "Read <left>, <base> and <right>, given as <rev>:<path>, directly from the "
+              "local git repository at the given path. Requires -p or -o.")
+    ("snapshot-cache", po::value<std::string>(),
+              "Directory with binary images of parsed inputs, keyed by content hash. "
+              "Inputs found there are not parsed again; new ones are added.")
+    ("output-format", po::value<std::string>(),
+              "Write the result as \"text\" or in the columnar \"binary\" format. "
+              "The default is the format of <left>. Inputs can be in either format.")
+    ("result-cache", po::value<std::string>(),
+              "Directory with the results of earlier merges, keyed by the content hashes of the "
+              "inputs, the version of contribmerge and the options that affect the result. A merge "
+              "found there is not done again. Ignored with --stats and --perf-counters.")
+    ("result-cache-size", po::value<unsigned long>()->default_value(64),
+              "Maximum size of the result cache in MiB; the least recently used results are removed.")
+    ("merge-state", po::value<std::string>(),
+              "File with the state of the previous merge. If only <left> changed since then, "
+              "only the contributors whose lines in <left> changed are merged again. "
+              "The state is (re)written after every merge without conflicts.")
+    ("watch", "Keep the inputs in memory and merge again every time one of them is saved, "
+              "until interrupted. Only the contributors that changed are parsed again. "
+              "Requires -p or -o.")
+    ("check", "Only determine if the merge would succeed: nothing is written and the exit code "
+              "is 0 if <left> and <right> merge without conflicts and 1 otherwise.")
+    ("collect-conflicts", "Do not stop at the first conflict: report all of them on standard error "
+              "and write the result with conflict markers around each conflicting contributor. "
+              "The exit code is 1 if there were conflicts.")
+    ("stats", po::value<std::string>()->implicit_value("text"),
+              "Print timing, input sizes and merge rule counters to standard error "
+              "after the merge. Use --stats=json for machine readable output.")
+    ("perf-counters", "Print cycles, instructions, IPC, cache misses and branch mispredictions "
+              "of each phase to standard error (Linux perf_event_open).")
+    ("trace", po::value<std::string>(),
+              "Write a timeline of the run to the given file, in Chrome trace-event "
+              "JSON format (for chrome://tracing or ui.perfetto.dev).")
+  ;
+
+  po::options_description convert_options("convert options");
+  convert_options.add_options()
+    ("to-binary", "Convert <input> (text or binary) to the columnar binary format in <output> (- for standard output).")
+    ("from-binary", "Convert <input> (binary or text) to text in <output> (- for standard output).")
+    ("strip-comments", "Leave the comments out of the binary format; the entries are then normalized (sorted by JIRA key).")
+  ;
+
+  po::options_description lint_options("lint options");
+  lint_options.add_options()
+    ("lint", "Check <input> for order violations, duplicate contributors and JIRA keys, unknown JIRA "
+             "project key prefixes, trailing whitespace and a missing final newline; print each finding "
+             "as <input>:<line>:<column>: <message>. The exit code is 1 if there were findings.")
+  ;
+
+  po::options_description canonicalize_options("canonicalize options");
+  canonicalize_options.add_options()
+    ("canonicalize", "Write <input> to <output> (- for standard output) as contribmerge writes a merge: "
+                     "whitespace normalized, contributors and their entries sorted, and only the first "
+                     "of duplicate contributors and duplicate JIRA keys of a contributor.")
+    ("jobs,j", po::value<unsigned int>(),
+              "Number of threads for --canonicalize (default: the number of CPUs).")
   ;
 
   // Separate descriptions for positional options, so they don't show up in help.
@@ -227,7 +926,8 @@ int main(int argc, char* argv[])
   ;
 
   po::options_description cmdline_options;
-  cmdline_options.add(generic_options).add(merge_options).add(hidden_options);
+  cmdline_options.add(generic_options).add(merge_options).add(convert_options).add(lint_options).add(canonicalize_options)
+                 .add(hidden_options);
 
   /* Don't forget to manually update the --help message when changing
    * the list of positional options! */
@@ -240,71 +940,358 @@ int main(int argc, char* argv[])
    .add("base", 1)
    .add("right", 1);
 
-  po::variables_map vm;
   po::store(po::command_line_parser(argc, argv).options(cmdline_options)
-                                               .positional(p).run(),
+                                               .positional(p).extra_parser(stats_parser).run(),
             vm);
   po::notify(vm);
 
   if (vm.count("help"))
   {
     std::cout << "Usage: contribmerge (<generic options> | [<merge options>] <left> <base> <right>)" << std::endl
+              << "       contribmerge (--to-binary | --from-binary) [--strip-comments] <input> <output>" << std::endl
+              << "       contribmerge --lint [--git <repository>] <input>" << std::endl
+              << "       contribmerge --canonicalize [-j <jobs>] <input> <output>" << std::endl
+              << "       contribmerge --audit [<audit options>] <list>" << std::endl
+              << "       contribmerge --diff [<diff options>] <old> <new>" << std::endl
+              << "       contribmerge --apply [<apply options>] <changeset> <target>" << std::endl
+              << "       contribmerge --query [<query options>] <file> [<key>...]" << std::endl
               << "Incorporates all changes that lead from <base> to <right> into <left>." << std::endl
               << std::endl;
     std::cout << generic_options << std::endl
-              << merge_options << std::endl;
-    return 1;
+              << merge_options << std::endl
+              << convert_options << std::endl
+              << lint_options << std::endl
+              << canonicalize_options << std::endl;
+    return false;
+  }
+  return true;
+}
+
+int main(int argc, char* argv[])
+{
+  Debug(debug::init());
+
+  // Subcommands. These are spelled as options, so that a merge of inputs that happen to be
+  // called audit, diff, apply or query (as a merge driver, for example) is still a merge.
+  if (argc > 1 && std::strcmp(argv[1], "--audit") == 0)
+    return audit_main(argc - 1, argv + 1);
+  if (argc > 1 && std::strcmp(argv[1], "--diff") == 0)
+    return diff_main(argc - 1, argv + 1);
+  if (argc > 1 && std::strcmp(argv[1], "--apply") == 0)
+    return apply_main(argc - 1, argv + 1);
+  if (argc > 1 && std::strcmp(argv[1], "--query") == 0)
+    return query_main(argc - 1, argv + 1);
+
+  if (argc == 2 && (std::strcmp(argv[1], "--version") == 0 || std::strcmp(argv[1], "-V") == 0))
+    return print_version();
+
+  std::string filename_base;
+  std::string filename_left;
+  std::string filename_right;
+  po::variables_map vm;
+  if (!parse_common_command_line(argc, argv, vm, filename_left, filename_base, filename_right))
+  {
+    vm.clear();
+    try
+    {
+      if (!parse_command_line(argc, argv, vm, filename_left, filename_base, filename_right))
+	return 1;
+    }
+    catch(std::exception&)
+    {
+      return report_exception();
+    }
   }
 
   if (vm.count("version"))
+    return print_version();
+
+  bool stats_json = false;
+  if (vm.count("stats"))
   {
-#ifdef PACKAGE_STRING //! \TODO Remove ifdef once config.h is generated by CMake, too.
-    std::cout << PACKAGE_STRING << std::endl;
-#else
-    std::cout << "contribmerge (version unknown)" << std::endl;
-#endif
-    return 1;
+    std::string const& format(vm["stats"].as<std::string>());
+    if (format == "json")
+      stats_json = true;
+    else if (format != "text")
+    {
+      std::cerr << "Unknown --stats format \"" << format << "\"; use --stats or --stats=json.\n";
+      return 2;
+    }
+  }
+  if (vm.count("trace"))
+    Trace::start(vm["trace"].as<std::string>());
+
+  boost::scoped_ptr<GitRepository> git_repository;
+  if (vm.count("git"))
+  {
+    if (!vm.count("stdout") && !vm.count("out") && !vm.count("check") && !vm.count("to-binary") && !vm.count("from-binary") &&
+        !vm.count("lint") && !vm.count("canonicalize"))
+    {
+      std::cerr << "Use -p or -o with --git: <left> is not a file that can be overwritten.\n";
+      return 2;
+    }
+    try
+    {
+      git_repository.reset(new GitRepository(vm["git"].as<std::string>()));
+    }
+    catch(std::exception&)
+    {
+      return report_exception();
+    }
+  }
+
+  boost::scoped_ptr<SnapshotCache> snapshot_cache;
+  if (vm.count("snapshot-cache"))
+    snapshot_cache.reset(new SnapshotCache(vm["snapshot-cache"].as<std::string>()));
+
+  if (vm.count("lint"))
+  {
+    if (filename_left.empty() || !filename_base.empty())
+    {
+      std::cerr << "Usage: contribmerge --lint [--git <repository>] <input>\n";
+      return 2;
+    }
+    return lint(filename_left, git_repository.get());
+  }
+
+  if (vm.count("canonicalize"))
+  {
+    if (filename_base.empty() || !filename_right.empty())
+    {
+      std::cerr << "Usage: contribmerge --canonicalize [-j <jobs>] <input> <output>\n";
+      return 2;
+    }
+    return canonicalize(filename_left, filename_base,
+        vm.count("jobs") ? vm["jobs"].as<unsigned int>() : boost::thread::hardware_concurrency(), git_repository.get());
+  }
+
+  if (vm.count("to-binary") || vm.count("from-binary"))
+  {
+    // The two positional arguments are <input> and <output>.
+    if (filename_base.empty() || !filename_right.empty() || (vm.count("to-binary") && vm.count("from-binary")))
+    {
+      std::cerr << "Usage: contribmerge (--to-binary | --from-binary) [--strip-comments] <input> <output>\n";
+      return 2;
+    }
+    return convert(filename_left, filename_base, vm.count("to-binary"), !vm.count("strip-comments"),
+        git_repository.get(), snapshot_cache.get());
+  }
+
+  if (vm.count("output-format") && vm["output-format"].as<std::string>() != "text" && vm["output-format"].as<std::string>() != "binary")
+  {
+    std::cerr << "Unknown --output-format \"" << vm["output-format"].as<std::string>() << "\"; use text or binary.\n";
+    return 2;
+  }
+
+  if (vm.count("watch"))
+  {
+    if (git_repository || (!vm.count("stdout") && !vm.count("out")) ||
+        (vm.count("out") && (vm["out"].as<std::string>() == filename_base ||
+                             vm["out"].as<std::string>() == filename_left ||
+                             vm["out"].as<std::string>() == filename_right)))
+    {
+      std::cerr << "--watch requires -p or -o (not naming an input) and can't be used with --git.\n";
+      return 2;
+    }
+    return watch(filename_base, filename_left, filename_right, vm);
   }
 
+  if (vm.count("check"))
+    return check(filename_base, filename_left, filename_right, git_repository.get(), snapshot_cache.get());
+
+  Statistics statistics;
+  Statistics* const collect_statistics = vm.count("stats") ? &statistics : NULL;
+  boost::scoped_ptr<PerfCounters> perf_counters;
+  boost::scoped_ptr<PerfReport> perf_report;
+  if (vm.count("perf-counters"))
+  {
+    perf_counters.reset(new PerfCounters);
+    perf_report.reset(new PerfReport(*perf_counters));
+  }
+
+  // The result cache and the merge state would make the statistics meaningless.
+  boost::scoped_ptr<ResultCache> result_cache;
+  if (vm.count("result-cache") && !collect_statistics && !perf_report)
+    result_cache.reset(new ResultCache(vm["result-cache"].as<std::string>(),
+        static_cast<unsigned long long>(vm["result-cache-size"].as<unsigned long>()) << 20));
+  std::string merge_state_filename;
+  if (vm.count("merge-state") && !collect_statistics && !perf_report &&
+      !(vm.count("output-format") && vm["output-format"].as<std::string>() == "binary"))
+    merge_state_filename = vm["merge-state"].as<std::string>();
+  bool const read_inputs_first = result_cache || !merge_state_filename.empty();
+  std::string options(vm.count("collect-conflicts") ? "collect-conflicts " : "");
+  options += "output-format=" + (vm.count("output-format") ? vm["output-format"].as<std::string>() : std::string("left"));
+
+  MergeConflicts conflicts;
+  ThrowOnConflict throw_on_conflict;
+  std::string result_key;
   try
   {
-    ContributionsTxt base(filename_base);
-    ContributionsTxt left(filename_left);
-    ContributionsTxt right(filename_right);
+    std::string base_buffer, left_buffer, right_buffer;
+    if (read_inputs_first)
+      read_inputs(filename_base, filename_left, filename_right, git_repository.get(), base_buffer, left_buffer, right_buffer);
+    if (result_cache)
+    {
+      // All inputs are needed for the key; look it up before parsing anything.
+      result_key = ResultCache::key(options, base_buffer, left_buffer, right_buffer);
+      ResultCache::Result cached;
+      if (result_cache->load(result_key, cached))
+      {
+	std::cerr << cached.M_diagnostics;
+	if (cached.M_has_output && !write_result(cached.M_output, vm, filename_left))
+	  return 2;
+	return cached.M_status;
+      }
+    }
+    std::string merge_state_key;
+    if (!merge_state_filename.empty() && !ColumnarImage::is_columnar(base_buffer.data(), base_buffer.size()) &&
+        !ColumnarImage::is_columnar(left_buffer.data(), left_buffer.size()) &&
+        !ColumnarImage::is_columnar(right_buffer.data(), right_buffer.size()))
+    {
+      // Only merge the contributors that changed in <left> since the previous merge, if possible.
+      merge_state_key = MergeState::key(options, base_buffer, right_buffer);
+      MergeState merge_state;
+      std::string output;
+      if (merge_state.load(merge_state_filename, merge_state_key) && merge_state.remerge(base_buffer, left_buffer, right_buffer, output))
+      {
+	merge_state.store(merge_state_filename);
+	if (result_cache)
+	{
+	  ResultCache::Result fresh;
+	  fresh.M_status = 0;
+	  fresh.M_has_output = true;
+	  fresh.M_output = output;
+	  result_cache->store(result_key, fresh);
+	}
+	return write_result(output, vm, filename_left) ? 0 : 2;
+      }
+    }
 
-    ContributionsTxt result = merge(base, left, right);
+    // Parse each input as soon as it is read, while the others are still being read.
+    PhaseRecorder recorder(collect_statistics, perf_report.get());
+    std::string const filenames[3] = { filename_base, filename_left, filename_right };
+    std::string* const buffers[3] = { &base_buffer, &left_buffer, &right_buffer };
+    ContributionsTxt base, left, right;
+    ContributionsTxt* const documents[3] = { &base, &left, &right };
+    bool binary_input[3];
+    boost::scoped_ptr<AsyncReader> reader;
+    if (!read_inputs_first && !git_repository)
+      reader.reset(new AsyncReader(filenames, 3));
+    for (size_t n = 0; n < 3; ++n)
+    {
+      size_t index = n;
+      if (reader)
+      {
+	index = reader->next();
+	buffers[index]->swap(reader->buffer(index));
+      }
+      recorder.start();
+      if (!read_inputs_first && !reader)
+	read_input(filenames[index], git_repository.get(), *buffers[index]);
+      binary_input[index] = load_document(filenames[index], *buffers[index], snapshot_cache.get(), *documents[index]);
+      recorder.finish("load", filenames[index], documents[index]->contributors().size());
+    }
+    bool const left_binary = binary_input[1];
+    if (collect_statistics)
+    {
+      char const* const roles[3] = { "base", "left", "right" };
+      for (size_t index = 0; index < 3; ++index)
+	statistics.add_input(roles[index], filenames[index], buffers[index]->size(), *documents[index]);
+    }
+
+    recorder.start();
+    CollectConflicts collect_conflicts(conflicts);
+    ContributionsTxt result(vm.count("collect-conflicts") ?
+        merge_with(base, left, right, collect_statistics, collect_conflicts) :
+        merge_with(base, left, right, collect_statistics, throw_on_conflict));
+    recorder.finish("merge", "", result.contributors().size());
+
+    std::string report;
+    if (!conflicts.empty())
+    {
+      std::ostringstream os;
+      conflicts.print_on(os);
+      report = os.str();
+      std::cerr << report;
+    }
 
-    if (vm.count("stdout")) // User requested output to standard output.
+    bool const binary = vm.count("output-format") ? vm["output-format"].as<std::string>() == "binary" : left_binary;
+    if (binary && !result.conflict_markers().empty())
     {
-      result.print_on(std::cout);
+      std::cerr << "The binary format can't hold conflict markers; no result written.\n";
+      exit(1);
     }
 
-    if (vm.count("out")) // User requested output to specified file.
+    if (read_inputs_first)
     {
-      // This might be additional to output to standard output above.
-      std::ofstream outfile(vm["out"].as<std::string>().c_str());
-      result.print_on(outfile);
-      outfile.close();
+      std::ostringstream os;
+      print_result(result, os, "memory", recorder, binary);
+      std::string const output(os.str());
+      if (result_cache)
+      {
+	ResultCache::Result fresh;
+	fresh.M_status = conflicts.empty() ? 0 : 1;
+	fresh.M_has_output = true;
+	fresh.M_output = output;
+	fresh.M_diagnostics = report;
+	result_cache->store(result_key, fresh);
+      }
+      MergeState merge_state;
+      if (!merge_state_key.empty() && !binary && conflicts.empty() &&
+          merge_state.assign(merge_state_key, base_buffer, left_buffer, right_buffer, base, left, right, result, output))
+	merge_state.store(merge_state_filename);
+      if (!write_result(output, vm, filename_left))
+	exit(2);
     }
-    else if (!vm.count("stdout")) // User didn't specify output target.
+    else
     {
-      // Output to file <left> by default.
-      std::ofstream outfile(filename_left.c_str());
-      result.print_on(outfile);
-      outfile.close();
+      if (vm.count("stdout")) // User requested output to standard output.
+      {
+	print_result(result, std::cout, "-", recorder, binary);
+      }
+
+      // User requested output to specified file (this might be additional to output to
+      // standard output above), or didn't specify an output target: output to file <left> by default.
+      if (vm.count("out") || !vm.count("stdout"))
+      {
+	std::string const& target(vm.count("out") ? vm["out"].as<std::string>() : filename_left);
+	std::ostringstream output;
+	print_result(result, output, target, recorder, binary);
+	if (!write_file(target, output.str()))
+	{
+	  std::cerr << "Cannot write \"" << target << "\".\n";
+	  exit(2);
+	}
+      }
     }
   }
-  catch(ParseError& parse_error)
+  catch(MergeFailure&)
   {
-    std::cerr << "Parsing failed\n" << "Stopped at: \"" << parse_error.rest() << "\"\n";
-    exit(1);
+    if (result_cache && !result_key.empty())
+    {
+      ResultCache::Result failed;
+      failed.M_status = 1;
+      failed.M_has_output = false;
+      failed.M_diagnostics = throw_on_conflict.M_report + "Merge failure\n";
+      result_cache->store(result_key, failed);
+    }
+    exit(report_exception());
   }
-  catch(MergeFailure& parse_error)
+  catch(std::exception&)
   {
-    std::cerr << "Merge failure\n";
-    exit(1);
+    exit(report_exception());
+  }
+
+  if (collect_statistics)
+  {
+    if (stats_json)
+      statistics.print_json_on(std::cerr);
+    else
+      statistics.print_on(std::cerr);
   }
+  if (perf_report)
+    perf_report->print_on(std::cerr);
 
-  return 0;
+  return conflicts.empty() ? 0 : 1;
 }
 
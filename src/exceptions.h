@@ -48,6 +48,48 @@ class MergeFailure : public std::exception
     virtual ~MergeFailure() throw() { }
 };
 
+class GitError : public std::exception
+{
+  public:
+    // Constructor.
+    GitError(std::string const& message) : M_message(message) { }
+    // Destructor.
+    virtual ~GitError() throw() { }
+
+    virtual char const* what(void) const throw() { return M_message.c_str(); }
+
+  private:
+    std::string M_message;
+};
+
+class FormatError : public std::exception
+{
+  public:
+    // Constructor.
+    FormatError(std::string const& message) : M_message(message) { }
+    // Destructor.
+    virtual ~FormatError() throw() { }
+
+    virtual char const* what(void) const throw() { return M_message.c_str(); }
+
+  private:
+    std::string M_message;
+};
+
+class ReadError : public std::exception
+{
+  public:
+    // Constructor.
+    ReadError(std::string const& message) : M_message(message) { }
+    // Destructor.
+    virtual ~ReadError() throw() { }
+
+    virtual char const* what(void) const throw() { return M_message.c_str(); }
+
+  private:
+    std::string M_message;
+};
+
 template<class InIt>
 ParseError::ParseError(InputRange<InIt> const& bounded_input_range)
 {
@@ -30,20 +30,20 @@
 
 namespace phoenix_utility {
 
-// Phoenix function converting the attribute type of raw[] (iterator_range<>) into a std::string.
-struct raw_to_string_impl
+// Phoenix function storing the attribute of raw[] (iterator_range<>) as the raw string of a Contributions,
+// directly in the memory resource of its payload.
+struct assign_raw_string_impl
 {
-  template<typename T1>
-  struct result { typedef std::string type; };
+  typedef void result_type;
 
   template<typename Iterator>
-  std::string operator()(boost::iterator_range<Iterator> const& r) const
+  void operator()(Contributions& contributions, boost::iterator_range<Iterator> const& r) const
   {
-    return std::string(r.begin(), r.end());
+    contributions.assign_raw_string(r.begin(), r.end());
   }
 };
 
-boost::phoenix::function<raw_to_string_impl> const raw_to_string = raw_to_string_impl();
+boost::phoenix::function<assign_raw_string_impl> const assign_raw_string = assign_raw_string_impl();
 
 // Phoenix function converting the std::string into a Header.
 struct string_to_header_impl
@@ -85,12 +85,13 @@ namespace grammar
 	using qi::string;
 	using qi::_val;
 	using qi::_1;
+	using qi::_a;
+	using qi::_b;
+	using qi::_r1;
 	using phoenix::bind;
 	using phoenix::construct;
 	using phoenix::insert;
-	using phoenix::push_back;
-	using phoenix::ref;
-	using phoenix_utility::raw_to_string;
+	using phoenix_utility::assign_raw_string;
 	using phoenix_utility::string_to_header;
 
 	// The first name of a contributor.
@@ -207,7 +208,7 @@ namespace grammar
 	;
 
 	// A space trimmed comment.
-	// Attribute: std::string.
+	// Attribute: ArenaString.
 	comment =
 	    // The !newline causes trailing white space not to be included,
 	    // and to terminate at the end of a line.
@@ -228,16 +229,22 @@ namespace grammar
 	// As full name + a vector of contribution entries, and the raw input
 	// string that was used for that. This is not directly / cleanly
 	// supported by spirit::qi. So instead we use semantic actions and phoenix.
-	// Attribute: Contributions.
+	// The full name (_a) and the contributions (_b) are locals of the rule,
+	// so that the grammar has no state and can be used by several threads at once.
+	// The contributor is added to the inherited attribute (ContributionsTxt&);
+	// _b is built in the memory resource of that document, so adding it doesn't copy it.
+	// This rule has no attribute.
 	contributor =
 	  raw[
 
-	    contributor_full_name			[ref(full_name) = _1]
+	    eps						[bind(&Contributions::reset, _b, bind(&ContributionsTxt::allocator, _r1))]
+	 >> contributor_full_name			[_a = _1]
 	 >> newline
-	 >> *contribution_entry				[push_back(bind(&Contributions::M_contributions, _val), _1)]
+	 >> *contribution_entry				[bind(&Contributions::add_entry, _b, _1)]
 
 	  // Store the raw data that we just gobbled up.
-	  ][bind(&Contributions::M_raw_string, _val) = raw_to_string(_1)]
+	  ][assign_raw_string(_b, _1),
+	    bind(&ContributionsTxt::add_contributor, _r1, _a, _b)]
 	;
 
 	// As an exception, the header line preserves trailing whitespace.
@@ -259,7 +266,7 @@ namespace grammar
 	contributions_txt =
 	    header					[bind(&ContributionsTxt::M_header, _val)  = string_to_header(_1)]
 	 >> empty_line
-	 >> +contributor				[insert(bind(&ContributionsTxt::M_contributors, _val), construct<std::pair<std::string, Contributions> >(ref(full_name), _1))]
+	 >> +contributor(_val)
 	 >> *empty_line
 	;
       }
@@ -275,13 +282,10 @@ namespace grammar
       qi::rule<Iterator, std::string()> header;
       qi::rule<Iterator, std::string()> jira_project_key_prefix;
       qi::rule<Iterator, JiraProjectKey()> jira_project_key;
-      qi::rule<Iterator, std::string()> comment;
+      qi::rule<Iterator, ArenaString()> comment;
       qi::rule<Iterator, ContributionEntry()> contribution_entry;
-      qi::rule<Iterator, Contributions()> contributor;
+      qi::rule<Iterator, void(ContributionsTxt&), qi::locals<std::string, Contributions> > contributor;
       qi::rule<Iterator, ContributionsTxt()> contributions_txt;
-
-    private:
-      std::string full_name;
   };
 
 } // namespace grammar
@@ -0,0 +1,64 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file json.cc Implementation of JSON output helpers.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <cstdio>
+#include "debug.h"
+#endif
+
+#include "json.h"
+
+std::string json_quote(std::string const& s)
+{
+  std::string result("\"");
+  for (std::string::const_iterator iter = s.begin(); iter != s.end(); ++iter)
+  {
+    unsigned char c = *iter;
+    switch (c)
+    {
+      case '"':
+	result += "\\\"";
+	break;
+      case '\\':
+	result += "\\\\";
+	break;
+      case '\n':
+	result += "\\n";
+	break;
+      case '\r':
+	result += "\\r";
+	break;
+      case '\t':
+	result += "\\t";
+	break;
+      default:
+	if (c < 0x20)
+	{
+	  char buf[8];
+	  std::snprintf(buf, sizeof(buf), "\\u%04x", c);
+	  result += buf;
+	}
+	else
+	  result += c;
+    }
+  }
+  result += '"';
+  return result;
+}
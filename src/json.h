@@ -1,6 +1,6 @@
 // contribmerge -- A three-way merge utility for doc/contributions.txt
 //
-//! @file FormattedContributions.cc Implementation of class FormattedContributions.
+//! @file json.h Declaration of JSON output helpers.
 //
 // Copyright (C) 2011, Aleric Inglewood
 // 
@@ -17,17 +17,12 @@
 // You should have received a copy of the GNU General Public License
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
-#ifndef USE_PCH
-#include "sys.h"
-#include <algorithm>
-#include "debug.h"
-#endif
+#ifndef JSON_H
+#define JSON_H
 
-#include "FormattedContributions.h"
-#include "Inserter.h"
+#include <string>
 
-FormattedContributions::FormattedContributions(std::vector<ContributionEntry> const& vec)
-{
-  Inserter<contributions_type> insert_into_contributions(M_contributions);
-  for_each(vec.begin(), vec.end(), insert_into_contributions);
-}
+// Return s as a double-quoted JSON string literal.
+std::string json_quote(std::string const& s);
+
+#endif // JSON_H
@@ -0,0 +1,85 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file merge.cc Non-template parts of the merge of doc/contributions.txt files.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef USE_PCH
+#include "sys.h"
+#include <iostream>
+#include <sstream>
+#include "debug.h"
+#endif
+
+#include "merge.h"
+
+void ThrowOnConflict::conflict(MergeConflict const& conflict) throw(MergeFailure)
+{
+  // Write the whole report at once; std::cerr is unbuffered.
+  std::ostringstream report;
+  conflict.print_on(report);
+  M_report = report.str();
+  std::cerr << M_report;
+  throw MergeFailure();
+}
+
+std::string conflict_markers(std::string const& left, std::string const& base, std::string const& right)
+{
+  std::string markers("<<<<<<< left\n");
+  if (left != "-")
+    markers += left;
+  markers += "||||||| base\n";
+  if (base != "-")
+    markers += base;
+  markers += "=======\n";
+  if (right != "-")
+    markers += right;
+  markers += ">>>>>>> right\n";
+  return markers;
+}
+
+ContributionsTxt merge(ContributionsTxt const& base, ContributionsTxt const& left, ContributionsTxt const& right) throw(MergeFailure)
+{
+  NoMergeStatistics no_statistics;
+  ThrowOnConflict throw_on_conflict;
+  return merge(base, left, right, no_statistics, no_statistics, NULL, throw_on_conflict);
+}
+
+bool mergeable(ContributionsTxt const& base, ContributionsTxt const& left, ContributionsTxt const& right)
+{
+  // h1 (h2, h3) --> MergeFailure
+  if (base.header() != left.header() && base.header() != right.header() && left.header() != right.header())
+    return false;
+
+  TraceSpan span("check contributors");
+  NoMergeStatistics no_statistics;
+  try
+  {
+    three_way_merge(left.contributors().begin(), left.contributors().end(),
+		    base.contributors().begin(), base.contributors().end(),
+		    right.contributors().begin(), right.contributors().end(),
+		    DiscardIterator(),
+		    ContributionsChecker(),
+		    ContributionsTxt::contributors_map::key_compare(),
+		    ContributionsEqual(),
+		    no_statistics);
+  }
+  catch (MergeFailure&)
+  {
+    return false;
+  }
+  return true;
+}
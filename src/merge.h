@@ -0,0 +1,334 @@
+// contribmerge -- A three-way merge utility for doc/contributions.txt
+//
+//! @file merge.h The merge of doc/contributions.txt files.
+//
+// Copyright (C) 2011, Aleric Inglewood
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 2 of the License, or
+// (at your option) any later version.
+// 
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+// 
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+#ifndef MERGE_H
+#define MERGE_H
+
+#include <algorithm>
+#include <cassert>
+#include <sstream>
+#include <string>
+#include "ContributionsTxt.h"
+#include "exceptions.h"
+#include "three_way_merge.h"
+#include "DiscardIterator.h"
+#include "MergeConflict.h"
+#include "AllocationStatistics.h"
+#include "Trace.h"
+#include "ostream_operators.h"
+
+// Below we use the following notation:
+//
+// x (y, z) --> r
+//
+// where x is part of the base, y is part of left and z is part of right: base (left, right) --> result.
+//
+// If a different symbol is used in the same formula, then that means that that part was changed.
+// 
+// Left and right are always exchangable. If x (y, z) --> r, then x (z, y) --> r. The latter may be omitted.
+// 
+// In all cases, x (x, x) --> x,  [if neither side changes anything, nothing is changed]
+//               x (x, y) --> y   [if only one side changes something, that is used]
+//           and x (y, y) --> y   [if both sides make the same change, who are we to argue]
+// These rules are considered trivial and may be omitted in the comments.
+//
+// When some part is non-existent we use the character '-'.
+
+// ConflictPolicy that reports the conflict on std::cerr and throws MergeFailure.
+struct ThrowOnConflict
+{
+  std::string M_report;				// The report of the conflict that was thrown.
+
+  void conflict(MergeConflict const& conflict) throw(MergeFailure);
+};
+
+// ConflictPolicy that records every conflict and lets the merge continue.
+// The result then contains conflict markers for every conflicting contributor.
+struct CollectConflicts
+{
+  MergeConflicts& M_conflicts;
+
+  CollectConflicts(MergeConflicts& conflicts) : M_conflicts(conflicts) { }
+  void conflict(MergeConflict const& conflict) { M_conflicts.add(conflict); }
+};
+
+// The text of a contribution entry, or "-" when it doesn't exist.
+template<typename Iterator>
+std::string entry_text(Iterator entry)
+{
+  if (entry == Iterator())
+    return "-";
+  std::ostringstream text;
+  text << *entry;
+  return text.str();
+}
+
+// The raw text of a contributor, or "-" when it doesn't exist.
+template<typename Iterator>
+std::string raw_text(Iterator contributor)
+{
+  if (contributor == Iterator())
+    return "-";
+  ArenaString const& raw(contributor->second.raw_string());
+  return std::string(raw.data(), raw.size());
+}
+
+// diff3 style conflict markers around the raw left, base and right text.
+std::string conflict_markers(std::string const& left, std::string const& base, std::string const& right);
+
+struct CommentEqual
+{
+  bool operator()(ContributionEntry const& ce1, ContributionEntry const& ce2)
+  {
+    assert(!(ce1.jira_project_key() < ce2.jira_project_key()) && !(ce2.jira_project_key() < ce1.jira_project_key()));
+    return ce1.comment() == ce2.comment();
+  }
+};
+
+// We can't do this, so hand the conflict to the ConflictPolicy and remember that the contributor conflicts.
+template<class ConflictPolicy>
+struct CommentMerger
+{
+  ConflictPolicy& M_conflict_policy;
+  std::string const& M_contributor;
+  bool& M_conflicted;
+
+  CommentMerger(ConflictPolicy& conflict_policy, std::string const& contributor, bool& conflicted) :
+      M_conflict_policy(conflict_policy), M_contributor(contributor), M_conflicted(conflicted) { }
+
+  template<typename Iterator1, typename Iterator2, typename Iterator3, typename OutputIterator>
+  void operator()(Iterator1 l, Iterator2 b, Iterator3 r, OutputIterator&) throw(MergeFailure)
+  {
+    MergeConflict conflict;
+    conflict.M_contributor = M_contributor;
+    if (l == Iterator1())
+      conflict.M_rule = "n (-, m)";
+    else if (r == Iterator3())
+      conflict.M_rule = "n (m, -)";
+    else if (b == Iterator2())
+      conflict.M_rule = "- (n, m)";
+    else
+      conflict.M_rule = "n (m, k)";
+    conflict.M_base = entry_text(b);
+    conflict.M_left = entry_text(l);
+    conflict.M_right = entry_text(r);
+    M_conflicted = true;
+    M_conflict_policy.conflict(conflict);
+  }
+};
+
+struct ContributionsEqual
+{
+  bool operator()(Contributor const& c1, Contributor const& c2)
+  {
+    assert(c1.first == c2.first);
+    return c1.second.shares_payload_with(c2.second) || c1.second.raw_string() == c2.second.raw_string();
+  }
+};
+
+// EntryStatistics is the three_way_merge Statistics policy used for merging the entries of a single contributor.
+template<class EntryStatistics, class ConflictPolicy>
+struct ContributionsMerger
+{
+  EntryStatistics& M_entry_statistics;
+  AllocationCounters* M_payload_allocations;		// Allocations done by this functor are added to this, if not NULL.
+  ConflictPolicy& M_conflict_policy;
+  ContributionsTxt& M_result;				// Receives the conflict markers.
+
+  ContributionsMerger(EntryStatistics& entry_statistics, AllocationCounters* payload_allocations,
+                      ConflictPolicy& conflict_policy, ContributionsTxt& result) :
+      M_entry_statistics(entry_statistics), M_payload_allocations(payload_allocations),
+      M_conflict_policy(conflict_policy), M_result(result) { }
+
+  template<typename Iterator1, typename Iterator2, typename Iterator3, typename OutputIterator>
+  void operator()(Iterator1 l, Iterator2 b, Iterator3 r, OutputIterator& output) throw(MergeFailure)
+  {
+    if (l == Iterator1() || r == Iterator3())
+    {
+      // One side removed the contributor while the other side changed it.
+      MergeConflict conflict;
+      conflict.M_contributor = b->first.full_name().c_str();
+      conflict.M_rule = l == Iterator1() ? "n (-, m)" : "n (m, -)";
+      conflict.M_base = raw_text(b);
+      conflict.M_left = raw_text(l);
+      conflict.M_right = raw_text(r);
+      M_conflict_policy.conflict(conflict);
+      add_conflict(l, b, r, output);
+      return;
+    }
+    else if (b == Iterator2())
+    {
+      assert(l->first == r->first);
+      TraceSpan span("merge payload", l->first.full_name().c_str());
+      AllocationScope allocation_scope(M_payload_allocations);
+      FormattedContributions left(l->second), right(r->second);
+      FormattedContributions result;
+
+      std::set_union(left.contributions().begin(), left.contributions().end(),
+		     right.contributions().begin(), right.contributions().end(),
+		     result.get_inserter(),
+		     FormattedContributions::contributions_type::key_compare());
+
+      *output = Contributor(l->first, Contributions(result, M_result.allocator()));
+    }
+    else
+    {
+      assert(l->first == r->first);
+      TraceSpan span("merge payload", b->first.full_name().c_str());
+      AllocationScope allocation_scope(M_payload_allocations);
+      FormattedContributions left(l->second), base(b->second), right(r->second);
+      FormattedContributions result;
+      std::string const full_name(b->first.full_name().c_str());
+      bool conflicted = false;
+
+      three_way_merge(left.contributions().begin(), left.contributions().end(),
+		      base.contributions().begin(), base.contributions().end(),
+		      right.contributions().begin(), right.contributions().end(),
+		      result.get_inserter(),
+		      CommentMerger<ConflictPolicy>(M_conflict_policy, full_name, conflicted),
+		      FormattedContributions::contributions_type::key_compare(),
+		      CommentEqual(),
+		      M_entry_statistics);
+
+      if (conflicted)
+      {
+	add_conflict(l, b, r, output);
+	return;
+      }
+      *output = Contributor(b->first, Contributions(result, M_result.allocator()));
+    }
+    ++output;
+  }
+
+  // Only reached with a ConflictPolicy that doesn't throw: keep the base contributor
+  // in the result as place holder, which is printed as conflict markers.
+  template<typename Iterator1, typename Iterator2, typename Iterator3, typename OutputIterator>
+  void add_conflict(Iterator1 l, Iterator2 b, Iterator3 r, OutputIterator& output)
+  {
+    M_result.add_conflict_markers(b->first.full_name().c_str(), conflict_markers(raw_text(l), raw_text(b), raw_text(r)));
+    *output = *b;
+    ++output;
+  }
+};
+
+// Merge left and right, being both derived from base.
+//
+// RuleStatistics is the three_way_merge Statistics policy (see three_way_merge.h);
+// contributor_statistics counts the rules applied to contributors and entry_statistics
+// those applied to the entries of contributors that needed their payload merged.
+// The allocations done while merging payloads are added to payload_allocations, if not NULL.
+//
+// Every conflict is passed to conflict_policy (ThrowOnConflict or CollectConflicts).
+//
+// The result is allocated from resource if not NULL (see ContributionsTxt), for example
+// an Arena that a loop releases after each merge.
+//
+template<class RuleStatistics, class ConflictPolicy>
+ContributionsTxt merge(ContributionsTxt const& base, ContributionsTxt const& left, ContributionsTxt const& right,
+    RuleStatistics& contributor_statistics, RuleStatistics& entry_statistics, AllocationCounters* payload_allocations,
+    ConflictPolicy& conflict_policy, boost::container::pmr::memory_resource* resource = NULL) throw(MergeFailure)
+{
+  // Merge the header.
+  //
+  // The header only follows the trivial rules, plus
+  // h1 (h2, h3) --> MergeFailure [if both sides make different changes, fail]
+  //
+  Header header(base);				// Default in case h (h, h) --> h
+  {
+    TraceSpan span("merge header");
+    if (header != left && header != right)
+    {
+      if (left != right)
+      {
+	// h1 (h2, h3) --> MergeFailure
+	MergeConflict conflict;
+	conflict.M_rule = "h1 (h2, h3)";
+	conflict.M_base = base.header().as_string();
+	conflict.M_left = left.header().as_string();
+	conflict.M_right = right.header().as_string();
+	conflict_policy.conflict(conflict);
+	header = Header(conflict_markers(conflict.M_left, conflict.M_base, conflict.M_right));
+      }
+      else
+	header = left;				// h1 (h2, h2) --> h2
+    }
+    else if (header != left)
+      header = left;				// h1 (h2, h1) --> h2
+    else if (header != right)
+      header = right;				// h1 (h1, h2) --> h2
+  }
+
+  // Unchanged contributors are shared with the input they were taken from.
+  ContributionsTxt result(header, resource);
+  result.share_arenas(base);
+  result.share_arenas(left);
+  result.share_arenas(right);
+
+  TraceSpan span("merge contributors");
+  three_way_merge(left.contributors().begin(), left.contributors().end(),
+		  base.contributors().begin(), base.contributors().end(),
+		  right.contributors().begin(), right.contributors().end(),
+		  result.get_inserter(),
+		  ContributionsMerger<RuleStatistics, ConflictPolicy>(entry_statistics, payload_allocations, conflict_policy, result),
+		  ContributionsTxt::contributors_map::key_compare(),
+		  ContributionsEqual(),
+		  contributor_statistics);
+
+  return result;
+}
+
+// Any call is a conflict.
+struct ThrowMergeFailure
+{
+  template<typename Iterator1, typename Iterator2, typename Iterator3, typename OutputIterator>
+  void operator()(Iterator1, Iterator2, Iterator3, OutputIterator&) throw(MergeFailure) { throw MergeFailure(); }
+};
+
+// Checks if the payloads of a contributor can be merged, without constructing anything.
+// Throws MergeFailure at the first conflict.
+struct ContributionsChecker
+{
+  template<typename Iterator1, typename Iterator2, typename Iterator3, typename OutputIterator>
+  void operator()(Iterator1 l, Iterator2 b, Iterator3 r, OutputIterator&) throw(MergeFailure)
+  {
+    if (l == Iterator1() || r == Iterator3())
+      throw MergeFailure();			// n (-, m) --> MergeFailure
+    if (b == Iterator2())
+      return;					// - (n, m) --> n + m never fails.
+    FormattedContributions left(l->second), base(b->second), right(r->second);
+    NoMergeStatistics no_statistics;
+    three_way_merge(left.contributions().begin(), left.contributions().end(),
+		    base.contributions().begin(), base.contributions().end(),
+		    right.contributions().begin(), right.contributions().end(),
+		    DiscardIterator(),
+		    ThrowMergeFailure(),
+		    FormattedContributions::contributions_type::key_compare(),
+		    CommentEqual(),
+		    no_statistics);
+  }
+};
+
+// Return true if left and right merge without conflicts.
+// Unlike merge() this doesn't construct a result and it stops at the first conflict.
+bool mergeable(ContributionsTxt const& base, ContributionsTxt const& left, ContributionsTxt const& right);
+
+// Merge without statistics, throwing MergeFailure on the first conflict.
+ContributionsTxt merge(ContributionsTxt const& base, ContributionsTxt const& left, ContributionsTxt const& right) throw(MergeFailure);
+
+#endif // MERGE_H
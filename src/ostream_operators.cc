@@ -31,6 +31,12 @@
 // ostream operator<<'s
 //
 
+std::ostream& operator<<(std::ostream& os, InternedString const& str)
+{
+  os.write(str.data(), str.size());
+  return os;
+}
+
 std::ostream& operator<<(std::ostream& os, JiraProjectKey const& key)
 {
   os << key.jira_project_key_prefix();
@@ -50,7 +56,7 @@ std::ostream& operator<<(std::ostream& os, ContributionEntry const& entry)
 std::ostream& operator<<(std::ostream& os, Contributions const& contributions)
 {
   //os << "<RAW>" << contributions.raw_string() << "</RAW>\n";
-  for (std::vector<ContributionEntry>::const_iterator contribution = contributions.contributions().begin(); contribution != contributions.contributions().end(); ++contribution)
+  for (Contributions::contributions_type::const_iterator contribution = contributions.contributions().begin(); contribution != contributions.contributions().end(); ++contribution)
   {
     os << '\t' << *contribution << "\n";
   }
@@ -72,8 +78,15 @@ std::ostream& operator<<(std::ostream& os, Header const& header)
 std::ostream& operator<<(std::ostream& os, ContributionsTxt const& contributions_txt)
 {
   os << contributions_txt.header() << '\n';
-  for (std::map<FullName, Contributions>::const_iterator contributor = contributions_txt.contributors().begin(); contributor != contributions_txt.contributors().end(); ++contributor)
+  for (ContributionsTxt::contributors_map::const_iterator contributor = contributions_txt.contributors().begin(); contributor != contributions_txt.contributors().end(); ++contributor)
   {
+    ContributionsTxt::conflict_markers_map::const_iterator markers;
+    if (!contributions_txt.conflict_markers().empty() &&
+        (markers = contributions_txt.conflict_markers().find(contributor->first.full_name().c_str())) != contributions_txt.conflict_markers().end())
+    {
+      os << markers->second;
+      continue;
+    }
     os << contributor->first << '\n';
     os << contributor->second;
   }
@@ -24,6 +24,7 @@
 #include <iosfwd>		// Needed for std::ostream
 #endif
 
+class InternedString;
 class JiraProjectKey;
 class ContributionEntry;
 class Contributions;
@@ -31,6 +32,7 @@ class FullName;
 class ContributionsTxt;
 typedef std::pair<FullName const, Contributions> Contributor;
 
+std::ostream& operator<<(std::ostream& os, InternedString const& str);
 std::ostream& operator<<(std::ostream& os, JiraProjectKey const& key);
 std::ostream& operator<<(std::ostream& os, ContributionEntry const& entry);
 std::ostream& operator<<(std::ostream& os, FullName const& full_name);
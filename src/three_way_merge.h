@@ -63,14 +63,31 @@
 // n (m, n) --> m
 // n (m, m) --> m
 // n (m, k) --> merge payload
+//
+// The Statistics policy is notified of every ordering/case branch that is taken.
+// The default policy, NoMergeStatistics, does nothing and is optimized away completely.
+
+struct NoMergeStatistics
+{
+  void skip_base(void) { }		// n (-, -) --> -
+  void take_left(void) { }		// - (n, -) --> n
+  void take_right(void) { }		// - (-, n) --> n
+  void case_A(void) { }
+  void case_B(void) { }
+  void case_C(void) { }
+  void case_D(void) { }
+  void payload_merge(void) { }		// The PayloadMerger functor is called.
+};
 
 template<typename InputIterator1, typename InputIterator2, typename InputIterator3,
-         typename OutputIterator, typename PayloadMerger, typename Compare, typename PayloadEqual>
+         typename OutputIterator, typename PayloadMerger, typename Compare, typename PayloadEqual,
+         typename Statistics>
 OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
                                InputIterator2 b, InputIterator2 be,
                                InputIterator3 r, InputIterator3 re,
                                OutputIterator result, PayloadMerger payload_merger,
-                               Compare comp, PayloadEqual payload_equal)
+                               Compare comp, PayloadEqual payload_equal,
+                               Statistics& statistics)
 {
   // At any point there can be 13 ways that the smallest remaining elements are ordered:
   //
@@ -114,6 +131,7 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
         // *b < *l = *r        ++b                 n (-, -) --> -
         //
         // Skip it.
+        statistics.skip_base();
         ++b;
         continue;
       }
@@ -123,6 +141,7 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
         // *r < *b < *l        Use *r++            - (-, n) --> n
         //
         // Use it.
+        statistics.take_right();
         *result = *r++;
         ++result;
         continue;
@@ -131,10 +150,12 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
       //   *b = *r < *l        Case B, ++b, ++r
       //
       // Case B
+      statistics.case_B();
 
       //if (b->second.raw_string() != r->second.raw_string())
       if (!payload_equal(*b, *r))
       {
+        statistics.payload_merge();
         payload_merger(InputIterator1(), b, r, result);
       }
 
@@ -172,6 +193,7 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
         // *l < *b = *r        Use *l++            - (n, -) --> n
         //
         // Use it.
+        statistics.take_left();
         *result = *l++;
         ++result;
         continue;
@@ -180,9 +202,11 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
       //   *b = *l < *r        Case C, ++b, ++l
       //
       // Case C
+      statistics.case_C();
 
       if (!payload_equal(*b, *l))
       {
+        statistics.payload_merge();
         payload_merger(l, b, InputIterator3(), result);
       }
 
@@ -206,6 +230,7 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
       //   *r < *b = *l        Use *r++            - (-, n) --> n
       //
       // Use it.
+      statistics.take_right();
       *result = *r++;
       ++result;
       continue;
@@ -222,6 +247,7 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
       //
       // Case A
       //
+      statistics.case_A();
       if (payload_equal(*r, *l))
       {
         // - (n, n) --> n
@@ -231,6 +257,7 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
       else
       {
         // - (n, m) --> merge payload
+        statistics.payload_merge();
         payload_merger(l, InputIterator2(), r, result);
       }
 
@@ -247,6 +274,7 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
     // n (m, n) --> m
     // n (m, m) --> m
     // n (m, l) --> merge payload
+    statistics.case_D();
 
     if (payload_equal(*b, *r))
     {
@@ -271,6 +299,7 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
     else
     {
       // n (m, k) --> merge payload
+      statistics.payload_merge();
       payload_merger(l, b, r, result);
     }
 
@@ -282,4 +311,16 @@ OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
   return result;
 }
 
+template<typename InputIterator1, typename InputIterator2, typename InputIterator3,
+         typename OutputIterator, typename PayloadMerger, typename Compare, typename PayloadEqual>
+inline OutputIterator three_way_merge(InputIterator1 l, InputIterator1 le,
+                                      InputIterator2 b, InputIterator2 be,
+                                      InputIterator3 r, InputIterator3 re,
+                                      OutputIterator result, PayloadMerger payload_merger,
+                                      Compare comp, PayloadEqual payload_equal)
+{
+  NoMergeStatistics no_statistics;
+  return three_way_merge(l, le, b, be, r, re, result, payload_merger, comp, payload_equal, no_statistics);
+}
+
 #endif // THREE_WAY_MERGE_H
@@ -0,0 +1,128 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file audit_test.py Test driver for contribmerge --audit
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: audit_test.py <contribmerge> <left> <base> <right>
+#
+# Commits <left>, <base>, <right> and the result of merging them to a new git repository,
+# together with two files derived from <base> that conflict. Then audits a list with a
+# merge that matches (by <rev>:<path> and again by blob name), one whose recorded result
+# is wrong, one that conflicts and one with a blob that does not exist, and compares the
+# report with what it should be. Every unique input must be parsed once (the recorded
+# results are compared as text).
+
+import os
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+left, base, right = sys.argv[2:5]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read().decode('utf-8')
+    finally:
+        f.close()
+
+def write(name, data):
+    f = open(name, 'wb')
+    try:
+        f.write(data.encode('utf-8'))
+    finally:
+        f.close()
+
+environment = dict(os.environ)
+environment.update({ 'GIT_AUTHOR_NAME': 'Test', 'GIT_AUTHOR_EMAIL': 'test@example.com',
+                     'GIT_COMMITTER_NAME': 'Test', 'GIT_COMMITTER_EMAIL': 'test@example.com',
+                     'GIT_CONFIG_NOSYSTEM': '1' })
+
+def git(arguments):
+    process = subprocess.Popen(['git'] + arguments, cwd=repository, env=environment, stdout=subprocess.PIPE)
+    output = process.communicate()[0]
+    if process.returncode != 0:
+        print("git " + " ".join(arguments) + " exited with " + str(process.returncode))
+        sys.exit(1)
+    return output.decode('ascii')
+
+def audit(arguments, specs):
+    list_filename = os.path.join(directory, 'list')
+    write(list_filename, '# left base right actual\n\n' + ''.join([' '.join(line) + '\n' for line in specs]))
+    arguments = [contribmerge, '--audit', '--git', repository] + arguments + [list_filename]
+    process = subprocess.Popen(arguments, stdout=subprocess.PIPE)
+    output = process.communicate()[0].decode('utf-8')
+    return arguments, process.returncode, output
+
+directory = tempfile.mkdtemp()
+environment['HOME'] = directory # no ~/.gitconfig
+try:
+    repository = os.path.join(directory, 'repository')
+    os.makedirs(repository)
+    git(['init', '-q'])
+    for name, filename in (('left.txt', left), ('base.txt', base), ('right.txt', right)):
+        shutil.copyfile(filename, os.path.join(repository, name))
+    if subprocess.call([contribmerge, '-o', os.path.join(repository, 'result.txt'), left, base, right]) != 0:
+        print("Merging " + " ".join([left, base, right]) + " failed")
+        sys.exit(1)
+    text = read(base)
+    if '\tVWR-1460\n' not in text:
+        print(base + " has no entry VWR-1460")
+        sys.exit(1)
+    write(os.path.join(repository, 'conflict_left.txt'), text.replace('\tVWR-1460\n', '\tVWR-1460 (left note)\n'))
+    write(os.path.join(repository, 'conflict_right.txt'), text.replace('\tVWR-1460\n', '\tVWR-1460 (right note)\n'))
+    git(['add', '.'])
+    git(['commit', '-q', '-m', 'audit'])
+    blob = dict([(name, git(['rev-parse', 'HEAD:' + name]).strip())
+                 for name in ('left.txt', 'base.txt', 'right.txt', 'result.txt', 'conflict_left.txt', 'conflict_right.txt')])
+
+    matching = ['HEAD:left.txt', 'HEAD:base.txt', 'HEAD:right.txt', 'HEAD:result.txt']
+    by_blob_name = [blob['left.txt'], blob['base.txt'], blob['right.txt'], blob['result.txt']]
+    wrong = ['HEAD:left.txt', 'HEAD:base.txt', 'HEAD:right.txt', 'HEAD:left.txt']
+    conflicting = ['HEAD:conflict_left.txt', 'HEAD:base.txt', 'HEAD:conflict_right.txt', 'HEAD:result.txt']
+    missing = ['HEAD:missing.txt', 'HEAD:base.txt', 'HEAD:right.txt', 'HEAD:result.txt']
+
+    # The list starts with a comment and an empty line, so the first merge is on line 3.
+    expected = ('line 5: mismatch\n' + ''.join(['  ' + role + ': ' + spec + '\n' for role, spec in zip(('left', 'base', 'right', 'actual'), wrong)]) +
+                'line 6: conflict\n' + ''.join(['  ' + role + ': ' + spec + '\n' for role, spec in zip(('left', 'base', 'right', 'actual'), conflicting)]) +
+                'line 7: error: ')
+    unique_inputs = len(set([blob[name] for name in ('left.txt', 'base.txt', 'right.txt', 'conflict_left.txt', 'conflict_right.txt')]))
+    for jobs in ('1', '4'):
+        for cache_size in ('256', '2'):
+            arguments, exit_code, output = audit(['-j', jobs, '--cache-size', cache_size], [matching, by_blob_name, wrong, conflicting, missing])
+            lines = output.splitlines(True)
+            if exit_code != 1 or not output.startswith(expected) or len(lines) != 13 or \
+                    lines[-2] != '5 merges: 2 ok, 1 mismatches, 1 conflicts, 1 errors.\n':
+                print(" ".join(arguments) + " exited with " + str(exit_code) + " and printed:\n" + output)
+                sys.exit(1)
+            parsed = int(lines[-1].split()[0])
+            if cache_size == '256' and parsed != unique_inputs:
+                print(" ".join(arguments) + " parsed " + str(parsed) + " blobs instead of " + str(unique_inputs))
+                sys.exit(1)
+
+    arguments, exit_code, output = audit([], [matching, by_blob_name])
+    if exit_code != 0 or not output.startswith('2 merges: 2 ok, 0 mismatches, 0 conflicts, 0 errors.\n'):
+        print(" ".join(arguments) + " exited with " + str(exit_code) + " and printed:\n" + output)
+        sys.exit(1)
+finally:
+    shutil.rmtree(directory)
+
+print("contribmerge --audit reports the merges that do not match")
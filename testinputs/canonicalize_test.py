@@ -0,0 +1,103 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file canonicalize_test.py Test driver for --canonicalize
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: canonicalize_test.py <contribmerge> <input> <expected output>
+#
+# Checks that contribmerge --canonicalize writes <expected output> for <input>,
+# that canonicalizing its own output changes nothing, and that the output doesn't
+# depend on the number of threads: also not for an input with enough contributors
+# to be split in several chunks, made of many renamed and shuffled copies of <input>.
+
+import os
+import random
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+input_name, expected_name = sys.argv[2:4]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read()
+    finally:
+        f.close()
+
+def write(name, data):
+    f = open(name, 'wb')
+    try:
+        f.write(data)
+    finally:
+        f.close()
+
+def canonicalize(input, jobs):
+    output = os.path.join(directory, 'output%d' % canonicalize.count)
+    canonicalize.count += 1
+    arguments = ['--canonicalize', '-j', str(jobs), input, output]
+    exit_code = subprocess.call([contribmerge] + arguments)
+    if exit_code != 0:
+        print("contribmerge " + " ".join(arguments) + " exited with " + str(exit_code))
+        sys.exit(1)
+    return output
+canonicalize.count = 0
+
+def check(input, expected):
+    one = canonicalize(input, 1)
+    if expected is not None and read(one) != expected:
+        print("The canonical form of " + input + " is not the expected one")
+        sys.exit(1)
+    if read(canonicalize(input, 4)) != read(one):
+        print("The canonical form of " + input + " depends on the number of threads")
+        sys.exit(1)
+    if read(canonicalize(one, 4)) != read(one):
+        print("Canonicalizing the canonical form of " + input + " changes it")
+        sys.exit(1)
+
+# Enough copies of the contributors of text, with a different last name per copy,
+# for several chunks (of at least 1024 contributors each), in a random order.
+def many_copies(text):
+    header_end = text.index(b'\n\n') + 2
+    blocks = []
+    for line in text[header_end:].splitlines(True):
+        if line[:1] in (b'\t', b' '):
+            blocks[-1].append(line)
+        else:
+            blocks.append([line])
+    copies = []
+    for copy in range(4096 // len(blocks) + 1):
+        suffix = b''.join([bytes(bytearray([ord('a') + int(digit)])) for digit in str(copy)])
+        for block in blocks:
+            copies.append([block[0].rstrip(b' \t\r\n') + suffix + b'\n'] + block[1:])
+    random.Random(1).shuffle(copies)
+    return text[:header_end] + b''.join([b''.join(block) for block in copies])
+
+directory = tempfile.mkdtemp()
+try:
+    check(input_name, read(expected_name))
+    many = os.path.join(directory, 'many')
+    write(many, many_copies(read(input_name)))
+    check(many, None)
+finally:
+    shutil.rmtree(directory)
+
+print("--canonicalize writes the expected, stable output")
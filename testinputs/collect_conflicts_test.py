@@ -0,0 +1,139 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file collect_conflicts_test.py Test driver for --collect-conflicts
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: collect_conflicts_test.py <contribmerge> <base>
+#
+# Makes a <left> and a <right> from <base> that both change the same entry of two
+# contributors, each in their own way, and that also make a change that does not
+# conflict. With --collect-conflicts both conflicts must be reported, the exit code
+# must be 1 and the result must have conflict markers around the two contributors:
+# taking the left (right) side of every conflict must give what merging <left>
+# (<right>) with only the changes of the other side that do not conflict gives.
+# Without --collect-conflicts the merge stops at the first conflict and writes nothing.
+
+import os
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+base = sys.argv[2]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read().decode('utf-8')
+    finally:
+        f.close()
+
+def write(name, data):
+    f = open(name, 'wb')
+    try:
+        f.write(data.encode('utf-8'))
+    finally:
+        f.close()
+
+def change(text, old, new):
+    if old not in text:
+        print(base + " does not contain " + repr(old))
+        sys.exit(1)
+    return text.replace(old, new, 1)
+
+def make(name, edits):
+    text = read(base)
+    for old, new in edits:
+        text = change(text, old, new)
+    filename = os.path.join(directory, name)
+    write(filename, text)
+    return filename
+
+def merge(arguments):
+    output = os.path.join(directory, 'output')
+    if os.path.exists(output):
+        os.remove(output)
+    process = subprocess.Popen([contribmerge] + arguments + ['-o', output], stderr=subprocess.PIPE)
+    errors = process.communicate()[1].decode('utf-8')
+    result = read(output) if os.path.exists(output) else None
+    return process.returncode, result, errors
+
+def fail(arguments, message):
+    print("contribmerge " + " ".join(arguments) + ": " + message)
+    sys.exit(1)
+
+# Keep one side of every conflict: lines between "<<<<<<< left" and "||||||| base" for the
+# left side, between "=======" and ">>>>>>> right" for the right side.
+def resolve(text, side):
+    result = []
+    section = None
+    for line in text.splitlines(True):
+        if line == '<<<<<<< left\n':
+            section = 'left'
+        elif line == '||||||| base\n':
+            section = 'base'
+        elif line == '=======\n':
+            section = 'right'
+        elif line == '>>>>>>> right\n':
+            section = None
+        elif section is None or section == side:
+            result.append(line)
+    return ''.join(result)
+
+conflicting_left = [('\tVWR-1460\n', '\tVWR-1460 (left note)\n'),
+                    ('\tVWR-8780 (Russian localization)\n', '\tVWR-8780 (Russian translation)\n')]
+conflicting_right = [('\tVWR-1460\n', '\tVWR-1460 (right note)\n'),
+                     ('\tVWR-8780 (Russian localization)\n', '\tVWR-8780 (Russian l10n)\n')]
+other_left = [('\tSTORM-163\n', '\tSTORM-163\n\tSTORM-1000\n')]
+other_right = [('\tSTORM-288\n', '\tSTORM-288\n\tSTORM-1001\n')]
+
+directory = tempfile.mkdtemp()
+try:
+    left = make('left', conflicting_left + other_left)
+    right = make('right', conflicting_right + other_right)
+    left_without_conflicts = make('left_without_conflicts', other_left)
+    right_without_conflicts = make('right_without_conflicts', other_right)
+
+    arguments = ['--collect-conflicts', left, base, right]
+    exit_code, result, errors = merge(arguments)
+    if exit_code != 1 or result is None:
+        fail(arguments, "exited with " + str(exit_code) + (" and did not write a result" if result is None else ""))
+    for contributor in ('Able Whitman', 'Ian Kas'):
+        if 'Conflict in contributor "' + contributor + '"' not in errors:
+            fail(arguments, "did not report the conflict in " + contributor + ":\n" + errors)
+    if not errors.endswith('2 conflicts.\n'):
+        fail(arguments, "did not report 2 conflicts:\n" + errors)
+    if result.count('<<<<<<< left\n') != 2:
+        fail(arguments, "did not put markers around exactly two contributors:\n" + result)
+    for side, expected_arguments in (('left', [left, base, right_without_conflicts]), ('right', [left_without_conflicts, base, right])):
+        expected_exit_code, expected, expected_errors = merge(expected_arguments)
+        if expected_exit_code != 0:
+            fail(expected_arguments, "exited with " + str(expected_exit_code) + ":\n" + expected_errors)
+        if resolve(result, side) != expected:
+            fail(arguments, "wrote a result whose " + side + " side is not what " + " ".join(expected_arguments) + " writes")
+
+    arguments = [left, base, right]
+    exit_code, result, errors = merge(arguments)
+    if exit_code != 1 or result is not None or 'Merge failure' not in errors:
+        fail(arguments, "exited with " + str(exit_code) + (" and wrote a result" if result is not None else "") + ":\n" + errors)
+finally:
+    shutil.rmtree(directory)
+
+print("--collect-conflicts reports every conflict and writes a result with conflict markers")
@@ -0,0 +1,88 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file columnar_round_trip_test.py Test driver for converting to and from the columnar binary format
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: columnar_round_trip_test.py <contribmerge> <left> <base> <right>
+#
+# Checks that the columnar binary format loses nothing: every input converted to
+# binary and back gives the same text as converting the input itself, converting
+# the image to binary again gives the same image, and merging with binary inputs gives the
+# same result as merging the text inputs.
+
+import os
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+inputs = sys.argv[2:5]
+
+def run(arguments, output=None):
+    exit_code = subprocess.call([contribmerge] + arguments, stdout=output)
+    if exit_code != 0:
+        print("contribmerge " + " ".join(arguments) + " exited with " + str(exit_code))
+        sys.exit(1)
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read()
+    finally:
+        f.close()
+
+def merge(left, base, right):
+    name = os.path.join(directory, 'merged')
+    f = open(name, 'wb')
+    try:
+        run(['-p', '--output-format', 'text', left, base, right], f)
+    finally:
+        f.close()
+    return read(name)
+
+directory = tempfile.mkdtemp()
+try:
+    binaries = []
+    for n, text in enumerate(inputs):
+        normalized = os.path.join(directory, 'normalized%d' % n)
+        binary = os.path.join(directory, 'binary%d' % n)
+        round_trip = os.path.join(directory, 'round_trip%d' % n)
+        binary_again = os.path.join(directory, 'binary_again%d' % n)
+        run(['--from-binary', text, normalized])
+        run(['--to-binary', text, binary])
+        run(['--from-binary', binary, round_trip])
+        run(['--to-binary', binary, binary_again])
+        if read(round_trip) != read(normalized):
+            print("text -> binary -> text of " + text + " differs from text -> text")
+            sys.exit(1)
+        if read(binary_again) != read(binary):
+            print("binary -> binary of " + text + " differs from the first image")
+            sys.exit(1)
+        binaries.append(binary)
+    expected = merge(inputs[0], inputs[1], inputs[2])
+    if merge(binaries[0], inputs[1], inputs[2]) != expected or \
+       merge(inputs[0], binaries[1], binaries[2]) != expected or \
+       merge(binaries[0], binaries[1], binaries[2]) != expected:
+        print("Merging binary inputs differs from merging the text inputs")
+        sys.exit(1)
+finally:
+    shutil.rmtree(directory)
+
+print("The columnar format round trips")
@@ -0,0 +1,77 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file diff_apply_test.py Test driver for applying the output of diff
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: diff_apply_test.py <contribmerge> <old> <new>
+#
+# Runs "contribmerge --diff <old> <new> | contribmerge --apply - <old>" and checks that
+# the result is semantically equal to <new>: that both have the same contributors
+# in their canonical form (see --canonicalize), as neither the order of entries nor
+# the header is part of a diff.
+
+import os
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+old, new = sys.argv[2:4]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read()
+    finally:
+        f.close()
+
+def contributors(name):
+    text = read(name)
+    # The header ends at the first empty line.
+    return text[text.index(b'\n\n'):]
+
+def run(arguments):
+    exit_code = subprocess.call([contribmerge] + arguments)
+    if exit_code != 0:
+        print("contribmerge " + " ".join(arguments) + " exited with " + str(exit_code))
+        sys.exit(1)
+
+directory = tempfile.mkdtemp()
+try:
+    result = os.path.join(directory, 'result')
+    diff = subprocess.Popen([contribmerge, '--diff', old, new], stdout=subprocess.PIPE)
+    apply = subprocess.Popen([contribmerge, '--apply', '-o', result, '-', old], stdin=diff.stdout)
+    diff.stdout.close()
+    apply_exit_code = apply.wait()
+    diff_exit_code = diff.wait()
+    if diff_exit_code not in (0, 1) or apply_exit_code != 0:
+        print("diff exited with " + str(diff_exit_code) + " and apply with " + str(apply_exit_code))
+        sys.exit(1)
+    canonical_result = os.path.join(directory, 'canonical_result')
+    canonical_new = os.path.join(directory, 'canonical_new')
+    run(['--canonicalize', result, canonical_result])
+    run(['--canonicalize', new, canonical_new])
+    if contributors(canonical_result) != contributors(canonical_new):
+        print("Applying the diff of " + old + " and " + new + " to " + old + " does not give " + new)
+        sys.exit(1)
+finally:
+    shutil.rmtree(directory)
+
+print("Applying the diff gives the new document")
@@ -0,0 +1,35 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file exit_status_test.py Test driver that checks the exit status of a command
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: exit_status_test.py <expected exit status> <command> [<arguments>...]
+#
+# Runs the command and fails if it doesn't exit with the expected status
+# (a crash never passes, unlike with WILL_FAIL).
+
+import sys
+import subprocess
+
+expected = int(sys.argv[1])
+exit_code = subprocess.call(sys.argv[2:])
+if exit_code != expected:
+    print("Exit status %d, expected %d! :-(" % (exit_code, expected))
+    sys.exit(1)
+print("Exit status %d as expected. :-)" % exit_code)
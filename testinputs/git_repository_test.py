@@ -0,0 +1,144 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file git_repository_test.py Test driver for reading the inputs from a git repository with --git
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: git_repository_test.py <contribmerge> <left> <base> <right>
+#
+# Commits <base> and <left> as doc/contributions.txt to a new git repository, packs
+# them (git repack writes OFS_DELTA objects) and then commits <right>, which is left
+# as loose objects. Merging <rev>:<path> specs with --git must write what merging the files
+# does, whether the blobs come from the pack or are loose. A pack index with a fanout
+# table that decreases, and a loose object whose header declares the wrong size, must
+# be reported as trouble (exit code 2).
+
+import os
+import shutil
+import struct
+import sys
+import subprocess
+import tempfile
+import zlib
+
+contribmerge = sys.argv[1]
+left, base, right = sys.argv[2:5]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read()
+    finally:
+        f.close()
+
+def write(name, data):
+    f = open(name, 'wb')
+    try:
+        f.write(data)
+    finally:
+        f.close()
+
+environment = dict(os.environ)
+environment.update({ 'GIT_AUTHOR_NAME': 'Test', 'GIT_AUTHOR_EMAIL': 'test@example.com',
+                     'GIT_COMMITTER_NAME': 'Test', 'GIT_COMMITTER_EMAIL': 'test@example.com',
+                     'GIT_CONFIG_NOSYSTEM': '1' })
+
+def git(arguments):
+    process = subprocess.Popen(['git'] + arguments, cwd=repository, env=environment, stdout=subprocess.PIPE)
+    output = process.communicate()[0]
+    if process.returncode != 0:
+        print("git " + " ".join(arguments) + " exited with " + str(process.returncode))
+        sys.exit(1)
+    return output.decode('ascii')
+
+def commit(name):
+    shutil.copyfile(name, os.path.join(repository, 'doc', 'contributions.txt'))
+    git(['add', 'doc/contributions.txt'])
+    git(['commit', '-q', '-m', os.path.basename(name)])
+
+def merge(arguments):
+    output = os.path.join(directory, 'output')
+    if os.path.exists(output):
+        os.remove(output)
+    process = subprocess.Popen([contribmerge] + arguments + ['-o', output], stderr=subprocess.PIPE)
+    errors = process.communicate()[1].decode('ascii', 'replace')
+    result = read(output) if os.path.exists(output) else None
+    return process.returncode, result, errors
+
+def expect_same(specs, files):
+    arguments = ['--git', repository] + specs
+    got = merge(arguments)
+    expected = merge(files)
+    if got[:2] != expected[:2]:
+        print("contribmerge " + " ".join(arguments) + " exited with " + str(got[0]) +
+              " and did not write what merging " + " ".join(files) + " writes (exit code " + str(expected[0]) + ")")
+        sys.exit(1)
+
+def expect_trouble(specs, message, what):
+    arguments = ['--git', repository] + specs
+    exit_code, result, errors = merge(arguments)
+    if exit_code != 2 or message not in errors:
+        print("contribmerge " + " ".join(arguments) + " exited with " + str(exit_code) + " after " + what +
+              "; expected 2 and \"" + message + "\" on standard error, got: " + errors)
+        sys.exit(1)
+
+directory = tempfile.mkdtemp()
+environment['HOME'] = directory # no ~/.gitconfig
+try:
+    repository = os.path.join(directory, 'repository')
+    os.makedirs(os.path.join(repository, 'doc'))
+    git(['-c', 'init.defaultBranch=master', 'init', '-q'])
+    commit(base)
+    commit(left)
+    git(['repack', '-a', '-d', '-q'])
+    packs = [os.path.join(repository, '.git', 'objects', 'pack', name)
+             for name in os.listdir(os.path.join(repository, '.git', 'objects', 'pack')) if name.endswith('.idx')]
+    # Lines of verify-pack for deltified objects have the delta depth and the SHA-1 of the base.
+    if len(packs) != 1 or not [line for line in git(['verify-pack', '-v', packs[0]]).splitlines() if len(line.split()) == 7]:
+        print("git repack did not write a pack with deltas")
+        sys.exit(1)
+    commit(right)
+    blob = git(['rev-parse', 'HEAD:doc/contributions.txt']).strip()
+    loose = os.path.join(repository, '.git', 'objects', blob[:2], blob[2:])
+    if not os.path.exists(loose):
+        print("The blob of the last commit was not written as a loose object")
+        sys.exit(1)
+
+    # Packed and loose, by branch name, ~, ^ and SHA-1.
+    expect_same(['HEAD~1:doc/contributions.txt', 'HEAD~2:doc/contributions.txt', 'HEAD:doc/contributions.txt'], [left, base, right])
+    expect_same(['master^:doc/contributions.txt', 'master^^:doc/contributions.txt', blob], [left, base, right])
+    expect_same([blob, 'HEAD~2:doc/contributions.txt', 'HEAD^1:doc/contributions.txt'], [right, base, left])
+
+    # A loose blob whose header says it is one byte longer than it is.
+    contents = read(right)
+    os.chmod(loose, 0o644)
+    write(loose, zlib.compress(('blob ' + str(len(contents) + 1)).encode('ascii') + b'\0' + contents))
+    expect_trouble(['HEAD~1:doc/contributions.txt', 'HEAD~2:doc/contributions.txt', 'HEAD:doc/contributions.txt'],
+                   "Corrupt loose object " + blob, "the size in the header of a loose object was changed")
+
+    # A fanout table whose entry for 0x00 is larger than the number of objects in the pack.
+    index = read(packs[0])
+    count = struct.unpack('>I', index[8 + 255 * 4:8 + 256 * 4])[0]
+    os.chmod(packs[0], 0o644)
+    write(packs[0], index[:8] + struct.pack('>I', count + 1) + index[12:])
+    expect_trouble(['HEAD~1:doc/contributions.txt', 'HEAD~2:doc/contributions.txt', 'HEAD:doc/contributions.txt'],
+                   "Object not found", "the fanout table of the pack index was damaged")
+finally:
+    shutil.rmtree(directory)
+
+print("contribmerge --git reads packed and loose objects, and rejects damaged ones")
@@ -0,0 +1,52 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file lint_test.py Test driver for --lint
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: lint_test.py <contribmerge> <input> <expected output>
+#
+# Runs contribmerge --lint on <input>, from the directory of <input> so that the
+# findings name it without a path, and compares what it prints with <expected output>.
+# The exit status must be 1 if there are findings and 0 if there are none.
+
+import os
+import sys
+import subprocess
+
+contribmerge = os.path.abspath(sys.argv[1])
+directory, name = os.path.split(os.path.abspath(sys.argv[2]))
+
+f = open(sys.argv[3], 'rb')
+try:
+    expected = f.read()
+finally:
+    f.close()
+
+p = subprocess.Popen([contribmerge, '--lint', name], cwd=directory, stdout=subprocess.PIPE)
+output = p.communicate()[0]
+exit_code = p.returncode
+if exit_code != (1 if expected else 0):
+    print("contribmerge --lint " + name + " exited with " + str(exit_code))
+    sys.exit(1)
+if output != expected:
+    print("contribmerge --lint " + name + " printed:")
+    sys.stdout.write(output.decode('latin-1'))
+    sys.exit(1)
+
+print("contribmerge --lint reports what was expected")
@@ -0,0 +1,80 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file merge_state_test.py Test driver for merging again from a --merge-state file
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: merge_state_test.py <contribmerge> <left> <base> <right> <new left>
+#
+# Merges <left>, <base> and <right> with a --merge-state file, then merges
+# again with <left> replaced by <new left>. That second merge must be done
+# from the merge state (its trace has a "remerge" span) and its result must
+# be byte for byte the same as that of a full merge of <new left>.
+
+import json
+import os
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+left, base, right, new_left = sys.argv[2:6]
+
+def merge(arguments):
+    exit_code = subprocess.call([contribmerge] + arguments)
+    if exit_code != 0:
+        print("contribmerge " + " ".join(arguments) + " exited with " + str(exit_code))
+        sys.exit(1)
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read()
+    finally:
+        f.close()
+
+def spans(trace):
+    f = open(trace)
+    try:
+        return [event['name'] for event in json.load(f)['traceEvents']]
+    finally:
+        f.close()
+
+directory = tempfile.mkdtemp()
+try:
+    state = os.path.join(directory, 'state')
+    trace = os.path.join(directory, 'trace')
+    output = os.path.join(directory, 'output')
+    expected = os.path.join(directory, 'expected')
+    merge(['--merge-state', state, '-o', output, left, base, right])
+    if not os.path.exists(state):
+        print("The first merge wrote no merge state")
+        sys.exit(1)
+    merge(['--merge-state', state, '--trace', trace, '-o', output, new_left, base, right])
+    if 'remerge' not in spans(trace):
+        print("The second merge did not use the merge state")
+        sys.exit(1)
+    merge(['-o', expected, new_left, base, right])
+    if read(output) != read(expected):
+        print("Merging from the merge state differs from a full merge")
+        sys.exit(1)
+finally:
+    shutil.rmtree(directory)
+
+print("Merging from the merge state gives the result of a full merge")
@@ -0,0 +1,68 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file mode_names_test.py Test driver for merging inputs named like the modes of contribmerge
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: mode_names_test.py <contribmerge> <left> <base> <right>
+#
+# Copies the inputs to files called query, diff and audit and merges those, as a merge
+# driver would: with -p, and once more in place with <left> called apply. Both must
+# write what merging the original files writes; none of these names may start one of
+# the other modes of contribmerge.
+
+import os
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+left, base, right = [os.path.abspath(name) for name in sys.argv[2:5]]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read()
+    finally:
+        f.close()
+
+def merge(arguments):
+    process = subprocess.Popen([contribmerge] + arguments, cwd=directory, stdout=subprocess.PIPE)
+    output = process.communicate()[0]
+    if process.returncode != 0:
+        print("contribmerge " + " ".join(arguments) + " exited with " + str(process.returncode))
+        sys.exit(1)
+    return output
+
+directory = tempfile.mkdtemp()
+try:
+    expected = merge(['-p', left, base, right])
+    for name, filename in (('query', left), ('diff', base), ('audit', right), ('apply', left)):
+        shutil.copyfile(filename, os.path.join(directory, name))
+    if merge(['query', 'diff', 'audit', '-p']) != expected:
+        print("contribmerge query diff audit -p did not write the merge of " + " ".join([left, base, right]))
+        sys.exit(1)
+    merge(['apply', 'diff', 'audit'])
+    if read(os.path.join(directory, 'apply')) != expected:
+        print("contribmerge apply diff audit did not write the merge of " + " ".join([left, base, right]) + " to apply")
+        sys.exit(1)
+finally:
+    shutil.rmtree(directory)
+
+print("Inputs named like the modes of contribmerge are merged")
@@ -0,0 +1,108 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file parser_test.py Test driver for the parser shared between threads
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: parser_test.py <contribmerge>
+#
+# The one ContributionsParser of contribmerge is shared by all threads. This makes an
+# input in which the name of every contributor says what its entries are, with enough
+# contributors for --canonicalize to parse it in several chunks at once, and checks
+# that every contributor in the output still has exactly its own entries: the full
+# name being parsed by one thread must never end up with the entries of another.
+
+import os
+import random
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read().decode('ascii')
+    finally:
+        f.close()
+
+def write(name, data):
+    f = open(name, 'wb')
+    try:
+        f.write(data.encode('ascii'))
+    finally:
+        f.close()
+
+count = 16384
+header = 'Header of the test input.\n\n'
+
+# Contributor n has the entries VWR-<3n>, VWR-<3n+1> (with a comment) and STORM-<n>;
+# n starts at 1, because a key without a number (or 0) is a project name only.
+# its name is n spelled out in letters.
+def name(n):
+    return 'Resident ' + ''.join([chr(ord('a') + int(digit)) for digit in '%05d' % n]).capitalize()
+
+def entries(n):
+    return ['VWR-%d' % (3 * n), 'VWR-%d (comment %d)' % (3 * n + 1, n), 'STORM-%d' % n]
+
+def block(n):
+    lines = entries(n)
+    random.Random(n).shuffle(lines)
+    return name(n) + '\n' + ''.join(['\t' + line + '\n' for line in lines])
+
+directory = tempfile.mkdtemp()
+try:
+    order = list(range(1, count + 1))
+    random.Random(1).shuffle(order)
+    input = os.path.join(directory, 'input')
+    write(input, header + ''.join([block(n) for n in order]))
+    by_name = dict([(name(n), n) for n in order])
+
+    for jobs in ('8', '3'):
+        output = os.path.join(directory, 'output')
+        arguments = ['--canonicalize', '-j', jobs, input, output]
+        exit_code = subprocess.call([contribmerge] + arguments)
+        if exit_code != 0:
+            print("contribmerge " + " ".join(arguments) + " exited with " + str(exit_code))
+            sys.exit(1)
+        text = read(output)
+        if not text.startswith(header):
+            print("contribmerge " + " ".join(arguments) + " did not keep the header")
+            sys.exit(1)
+        seen = set()
+        blocks = []
+        for line in text[len(header):].splitlines():
+            if line.startswith('\t'):
+                blocks[-1][1].append(line[1:])
+            elif line:
+                blocks.append((line, []))
+        for contributor, lines in blocks:
+            n = by_name.get(contributor)
+            if n is None or n in seen or sorted(lines) != sorted(entries(n)):
+                print("contribmerge " + " ".join(arguments) + " wrote the contributor " + contributor + " with " + ", ".join(lines))
+                sys.exit(1)
+            seen.add(n)
+        if len(seen) != count:
+            print("contribmerge " + " ".join(arguments) + " wrote " + str(len(seen)) + " of the " + str(count) + " contributors")
+            sys.exit(1)
+finally:
+    shutil.rmtree(directory)
+
+print("The shared parser gives every contributor its own entries")
@@ -0,0 +1,132 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file query_test.py Test driver for contribmerge --query
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: query_test.py <contribmerge> <file>
+#
+# Queries a copy of <file> for a JIRA key, a prefix, a range, a contributor and for
+# keys and a contributor that are not there, and compares the output with what is
+# found by reading <file> directly. Then the copy is changed, which makes its index
+# stale, and the changed entries must be found (and the old ones not) without
+# removing the index first.
+
+import os
+import re
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+original = sys.argv[2]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read().decode('utf-8')
+    finally:
+        f.close()
+
+def write(name, data):
+    f = open(name, 'wb')
+    try:
+        f.write(data.encode('utf-8'))
+    finally:
+        f.close()
+
+key_re = re.compile(r'([A-Z]+)-([0-9]+)')
+
+# Return the (name, entry, prefix, number) of every entry of the contributors in text,
+# which follow the first empty line. Entries are the indented lines; prefix and number
+# are None for those without a JIRA key.
+def entries(text):
+    result = []
+    name = None
+    for line in text.split('\n')[text.split('\n').index('') + 1:]:
+        entry = line.lstrip()
+        if entry != line:
+            match = key_re.match(entry)
+            if match:
+                result.append((name, entry, match.group(1), int(match.group(2))))
+            else:
+                result.append((name, entry, None, None))
+        elif line:
+            name = line
+    return result
+
+def query(options, keys):
+    process = subprocess.Popen([contribmerge, '--query'] + options + [filename] + keys, stdout=subprocess.PIPE)
+    output = process.communicate()[0].decode('utf-8')
+    return process.returncode, output
+
+def fail(arguments, message):
+    print("contribmerge --query " + filename + " " + " ".join(arguments) + ": " + message)
+    sys.exit(1)
+
+def expect_keys(key, wanted):
+    exit_code, output = query([], [key])
+    lines = output.splitlines()
+    expected = [name + '\t' + entry for name, entry, prefix, number in entries(read(filename)) if prefix and wanted(prefix, number)]
+    if exit_code != (0 if expected else 1):
+        fail([key], "exited with " + str(exit_code))
+    if sorted(lines) != sorted(expected):
+        fail([key], "printed\n" + output + "instead of\n" + "\n".join(expected))
+    numbers = [int(key_re.search(line.split('\t')[1]).group(2)) for line in lines]
+    if numbers != sorted(numbers):
+        fail([key], "did not print the entries sorted by key")
+
+def expect_name(name, found):
+    exit_code, output = query(['--name', name], [])
+    lines = output.splitlines()
+    expected = []
+    if found:
+        expected = [found] + ['\t' + entry for contributor, entry, prefix, number in entries(read(filename)) if contributor == found]
+    # The entries are printed sorted by key.
+    if exit_code != (0 if found else 1) or lines[:1] != expected[:1] or sorted(lines) != sorted(expected):
+        fail(['--name', name], "exited with " + str(exit_code) + " and printed\n" + output + "instead of\n" + "\n".join(expected))
+
+directory = tempfile.mkdtemp()
+try:
+    filename = os.path.join(directory, 'contributions.txt')
+    shutil.copyfile(original, filename)
+
+    expect_keys('VWR-650', lambda prefix, number: prefix == 'VWR' and number == 650)
+    if not os.path.exists(filename + '.index'):
+        fail(['VWR-650'], "did not create " + filename + ".index")
+    expect_keys('STORM', lambda prefix, number: prefix == 'STORM')
+    expect_keys('VWR-100..VWR-200', lambda prefix, number: prefix == 'VWR' and 100 <= number <= 200)
+    expect_keys('VWR-24487', lambda prefix, number: False)
+    expect_keys('NOSUCHPREFIX', lambda prefix, number: False)
+    expect_name('aleric INGLEWOOD', 'Aleric Inglewood')
+    expect_name('Nobody Atall', None)
+
+    # Renumber VWR-650 to VWR-24487 and add an entry to the last contributor; the index is now stale.
+    text = read(filename)
+    if '\tVWR-650\n' not in text:
+        fail([], "has no entry VWR-650")
+    write(filename, text.replace('\tVWR-650\n', '\tVWR-24487\n').rstrip('\n') + '\n\tSTORM-99999\n')
+    expect_keys('VWR-650', lambda prefix, number: False)
+    expect_keys('VWR-24487', lambda prefix, number: prefix == 'VWR' and number == 24487)
+    expect_keys('STORM', lambda prefix, number: prefix == 'STORM')
+    expect_keys('VWR-100..VWR-200', lambda prefix, number: prefix == 'VWR' and 100 <= number <= 200)
+finally:
+    shutil.rmtree(directory)
+
+print("contribmerge --query finds what is in the file, also after it changed")
@@ -0,0 +1,82 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file result_cache_test.py Test driver for the --result-cache of merges
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: result_cache_test.py <contribmerge> <left> <base> <right>
+#
+# Merges the inputs three times with the same --result-cache directory: the first
+# merge misses and parses the inputs, the second one is a hit and parses nothing,
+# and the third one, with an option that affects the result, misses again.
+# Every merge must write what a merge without the result cache writes.
+
+import json
+import os
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+left, base, right = sys.argv[2:5]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read()
+    finally:
+        f.close()
+
+def spans(trace):
+    f = open(trace)
+    try:
+        return [event['name'] for event in json.load(f)['traceEvents']]
+    finally:
+        f.close()
+
+def run(arguments):
+    exit_code = subprocess.call([contribmerge] + arguments)
+    if exit_code != 0:
+        print("contribmerge " + " ".join(arguments) + " exited with " + str(exit_code))
+        sys.exit(1)
+
+def merge(options, hit):
+    output = os.path.join(directory, 'output')
+    trace = os.path.join(directory, 'trace')
+    arguments = ['--result-cache', cache, '--trace', trace, '-o', output] + options + [left, base, right]
+    run(arguments)
+    if ('parse' not in spans(trace)) != hit:
+        print("contribmerge " + " ".join(arguments) + (" missed the result cache" if hit else " hit the result cache"))
+        sys.exit(1)
+    if read(output) != read(expected):
+        print("contribmerge " + " ".join(arguments) + " did not write the expected result")
+        sys.exit(1)
+
+directory = tempfile.mkdtemp()
+try:
+    cache = os.path.join(directory, 'cache')
+    expected = os.path.join(directory, 'expected')
+    run(['-o', expected, left, base, right])
+    merge([], False)
+    merge([], True)
+    merge(['--collect-conflicts'], False)
+finally:
+    shutil.rmtree(directory)
+
+print("The result cache hits and misses as expected")
@@ -0,0 +1,115 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file snapshot_cache_test.py Test driver for the --snapshot-cache of parsed inputs
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: snapshot_cache_test.py <contribmerge> <left> <base> <right>
+#
+# Merges the inputs with the same --snapshot-cache directory: the first merge parses
+# the inputs and stores their images, the second one loads them and parses nothing.
+# Then every image is damaged in turn (a header field, a byte of its contents, its
+# length), after which the merge must parse the inputs again.
+# Every merge must write what a merge without the snapshot cache writes.
+
+import json
+import os
+import shutil
+import struct
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+left, base, right = sys.argv[2:5]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read()
+    finally:
+        f.close()
+
+def write(name, data):
+    f = open(name, 'wb')
+    try:
+        f.write(data)
+    finally:
+        f.close()
+
+def spans(trace):
+    f = open(trace)
+    try:
+        return [event['name'] for event in json.load(f)['traceEvents']]
+    finally:
+        f.close()
+
+def run(arguments):
+    exit_code = subprocess.call([contribmerge] + arguments)
+    if exit_code != 0:
+        print("contribmerge " + " ".join(arguments) + " exited with " + str(exit_code))
+        sys.exit(1)
+
+def merge(hit, what):
+    output = os.path.join(directory, 'output')
+    trace = os.path.join(directory, 'trace')
+    arguments = ['--snapshot-cache', cache, '--trace', trace, '-o', output, left, base, right]
+    run(arguments)
+    if ('parse' not in spans(trace)) != hit:
+        print("contribmerge " + " ".join(arguments) + (" parsed " if hit else " did not parse ") + what)
+        sys.exit(1)
+    if read(output) != read(expected):
+        print("contribmerge " + " ".join(arguments) + " did not write the expected result after " + what)
+        sys.exit(1)
+
+def damage(change, what):
+    images = [os.path.join(cache, name) for name in os.listdir(cache) if name.endswith('.snapshot')]
+    if not images:
+        print("No images in " + cache)
+        sys.exit(1)
+    for image in images:
+        data = read(image)
+        write(image, change(data))
+        merge(False, what)
+        merge(True, "the image was stored again")
+
+# The ImageHeader starts with M_magic, M_version, M_size, M_checksum, M_content_hash[20], M_header and M_header_size.
+def shorter_header(data):
+    header_size = struct.unpack('=I', data[40:44])[0]
+    return data[:40] + struct.pack('=I', header_size // 2) + data[44:]
+
+def flipped_byte(data):
+    return data[:-1] + struct.pack('=B', (struct.unpack('=B', data[-1:])[0] ^ 1))
+
+def truncated(data):
+    return data[:len(data) // 2]
+
+directory = tempfile.mkdtemp()
+try:
+    cache = os.path.join(directory, 'cache')
+    expected = os.path.join(directory, 'expected')
+    run(['-o', expected, left, base, right])
+    merge(False, "the first time")
+    merge(True, "the stored images")
+    damage(shorter_header, "a header field was changed")
+    damage(flipped_byte, "a byte was changed")
+    damage(truncated, "the image was truncated")
+finally:
+    shutil.rmtree(directory)
+
+print("The snapshot cache falls back to parsing damaged images")
@@ -0,0 +1,53 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file startup_benchmark.py Startup time benchmark
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: startup_benchmark.py <contribmerge> <budget in microseconds>
+#
+# Measures the median time of 'contribmerge --version', minus that of starting
+# 'true' (the cost of starting any process from here), and fails if it exceeds the budget.
+
+import os
+import sys
+import time
+import subprocess
+
+contribmerge_command = sys.argv[1]
+budget_us = float(sys.argv[2])
+runs = 200
+
+devnull = open(os.devnull, 'w')
+
+def median_us(command):
+    times = []
+    for run in range(runs):
+        start = time.time()
+        subprocess.call(command, stdout=devnull)
+        times.append((time.time() - start) * 1e6)
+    times.sort()
+    return times[runs // 2]
+
+baseline_us = median_us(['true'])
+version_us = median_us([contribmerge_command, '--version'])
+startup_us = version_us - baseline_us
+
+sys.stdout.write("contribmerge --version: %.0f us (%.0f us over starting 'true'); budget: %.0f us\n" % (version_us, startup_us, budget_us))
+if startup_us > budget_us:
+    sys.exit(1)
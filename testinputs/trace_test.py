@@ -0,0 +1,68 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file trace_test.py Test driver for --trace
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: trace_test.py <contribmerge> <left> <base> <right>
+#
+# Merges the inputs with --trace and checks that the file is valid trace-event JSON
+# with, for every input, one "open", one "read" and one "parse" span (with the name
+# of the input as detail) and a "write" span for the result.
+
+import json
+import os
+import shutil
+import sys
+import subprocess
+import tempfile
+
+contribmerge = sys.argv[1]
+inputs = sys.argv[2:5]
+
+directory = tempfile.mkdtemp()
+try:
+    trace = os.path.join(directory, 'trace')
+    output = os.path.join(directory, 'output')
+    arguments = ['--trace', trace, '-o', output] + inputs
+    exit_code = subprocess.call([contribmerge] + arguments)
+    if exit_code != 0:
+        print("contribmerge " + " ".join(arguments) + " exited with " + str(exit_code))
+        sys.exit(1)
+    f = open(trace)
+    try:
+        events = json.load(f)['traceEvents']
+    finally:
+        f.close()
+    spans = [(event['name'], event.get('args', {}).get('detail', '')) for event in events if event['ph'] == 'X']
+    for event in events:
+        if event['ph'] == 'X' and (event['dur'] < 0 or event['ts'] <= 0):
+            print("contribmerge " + " ".join(arguments) + " wrote a span without a start or with a negative duration: " + repr(event))
+            sys.exit(1)
+    for name in ['open', 'read', 'parse']:
+        for input in inputs:
+            if spans.count((name, input)) != 1:
+                print("contribmerge " + " ".join(arguments) + " did not write one \"" + name + "\" span for " + input + ": " + repr(spans))
+                sys.exit(1)
+    if ('write', output) not in spans:
+        print("contribmerge " + " ".join(arguments) + " did not write a \"write\" span for " + output + ": " + repr(spans))
+        sys.exit(1)
+finally:
+    shutil.rmtree(directory)
+
+print("--trace writes a span for reading, parsing and writing each file")
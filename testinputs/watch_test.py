@@ -0,0 +1,145 @@
+#!/usr/bin/env python
+
+# contribmerge -- A three-way merge utility for doc/contributions.txt
+#
+#! @file watch_test.py Test driver for --watch
+#
+# Copyright (C) 2011, Aleric Inglewood
+# 
+# This program is free software: you can redistribute it and/or modify
+# it under the terms of the GNU General Public License as published by
+# the Free Software Foundation, either version 2 of the License, or
+# (at your option) any later version.
+# 
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+# 
+# You should have received a copy of the GNU General Public License
+# along with this program.  If not, see <http://www.gnu.org/licenses/>.
+
+# Usage: watch_test.py <contribmerge> <base>
+#
+# Runs contribmerge --watch on copies of <base> and changes them: <left> in place,
+# <right> by writing a new file and renaming it over the old one (the way editors
+# save), <left> so that it can't be parsed and then back. After every save the
+# result must become what merging the files from scratch writes, and the parse
+# error must be reported. Then the watch is interrupted with SIGINT, after which it
+# must exit with 0 and write its --trace.
+
+import json
+import os
+import shutil
+import signal
+import sys
+import subprocess
+import tempfile
+import time
+
+contribmerge = sys.argv[1]
+original = sys.argv[2]
+
+def read(name):
+    f = open(name, 'rb')
+    try:
+        return f.read()
+    finally:
+        f.close()
+
+def write(name, data):
+    f = open(name, 'wb')
+    try:
+        f.write(data)
+    finally:
+        f.close()
+
+def change(name, old, new):
+    data = read(name)
+    if old not in data:
+        print(name + " does not contain " + repr(old))
+        sys.exit(1)
+    return data.replace(old, new, 1)
+
+def expect_result(what):
+    process = subprocess.Popen([contribmerge, '-p', left, base, right], stdout=subprocess.PIPE)
+    expected = process.communicate()[0]
+    if process.returncode != 0:
+        print("contribmerge -p " + " ".join([left, base, right]) + " exited with " + str(process.returncode))
+        sys.exit(1)
+    deadline = time.time() + 20
+    while not os.path.exists(output) or read(output) != expected:
+        if watch.poll() is not None:
+            print("contribmerge --watch exited with " + str(watch.returncode) + " after " + what)
+            sys.exit(1)
+        if time.time() > deadline:
+            print("contribmerge --watch did not write the merge of the inputs after " + what)
+            sys.exit(1)
+        time.sleep(0.05)
+
+def expect_error(message, what):
+    deadline = time.time() + 20
+    while message not in read(errors_filename):
+        if time.time() > deadline:
+            print("contribmerge --watch did not report \"" + message.decode('ascii') + "\" after " + what)
+            sys.exit(1)
+        time.sleep(0.05)
+
+directory = tempfile.mkdtemp()
+watch = None
+try:
+    left, base, right = [os.path.join(directory, name) for name in ('left.txt', 'base.txt', 'right.txt')]
+    output = os.path.join(directory, 'output.txt')
+    errors_filename = os.path.join(directory, 'errors.txt')
+    trace = os.path.join(directory, 'trace')
+    shutil.copyfile(original, base)
+    write(left, change(base, b'\tSTORM-163\n', b'\tSTORM-163\n\tSTORM-1000\n'))
+    write(right, change(base, b'\tSTORM-288\n', b'\tSTORM-288\n\tSTORM-1001\n'))
+
+    errors = open(errors_filename, 'wb')
+    watch = subprocess.Popen([contribmerge, '--watch', '--trace', trace, '-o', output, left, base, right], stderr=errors)
+    expect_result("starting")
+
+    # Saved in place.
+    write(left, change(left, b'\tVWR-1460\n', b'\tVWR-1460\n\tVWR-1461\n'))
+    expect_result("a change of <left>")
+
+    # Saved as a new file that replaces the old one.
+    write(right + '.new', change(right, b'\tVWR-650\n', b'\tVWR-651\n'))
+    os.rename(right + '.new', right)
+    expect_result("<right> was replaced")
+
+    # A parse error is reported, and the next save is merged again.
+    good = read(left)
+    write(left, change(left, b'\tVWR-1461\n', b'\t\x01\n'))
+    expect_error(b'Parsing ' + left.encode('utf-8') + b' failed', "<left> was broken")
+    write(left, change(left, b'\t\x01\n', b'\tVWR-1462\n'))
+    expect_result("<left> was repaired")
+
+    watch.send_signal(signal.SIGINT)
+    deadline = time.time() + 20
+    while watch.poll() is None:
+        if time.time() > deadline:
+            print("contribmerge --watch did not stop after SIGINT")
+            sys.exit(1)
+        time.sleep(0.05)
+    exit_code = watch.returncode
+    watch = None
+    if exit_code != 0:
+        print("contribmerge --watch exited with " + str(exit_code) + " after SIGINT")
+        sys.exit(1)
+    f = open(trace)
+    try:
+        spans = [event['name'] for event in json.load(f)['traceEvents']]
+    finally:
+        f.close()
+    if 'parse' not in spans:
+        print("contribmerge --watch did not write its trace after SIGINT")
+        sys.exit(1)
+finally:
+    if watch is not None:
+        watch.kill()
+        watch.wait()
+    shutil.rmtree(directory)
+
+print("contribmerge --watch merges again after every save")